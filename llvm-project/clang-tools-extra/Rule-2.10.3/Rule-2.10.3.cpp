@@ -5,7 +5,9 @@
 #include "llvm/Support/CommandLine.h"
 #include "clang/ASTMatchers/ASTMatchers.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
-#include <vector>
+#include "llvm/ADT/DenseMap.h"
+#include "MisraRule.h"
+#include "ViolationRecorder.h"
 
 using namespace clang;
 using namespace clang::ast_matchers;
@@ -13,6 +15,8 @@ using namespace clang::tooling;
 using namespace llvm;
 using namespace std;
 
+namespace {
+
 // create matcher for typedef declaration and variable declaration
 DeclarationMatcher TypedefMatcher = typedefDecl().bind("typedef");
 DeclarationMatcher VariableMatcher = varDecl().bind("variable");
@@ -24,22 +28,25 @@ DeclarationMatcher AnyOfMatcher = anyOf(TypedefMatcher, VariableMatcher);
 StatementMatcher DeclMatcher = declStmt(
   has(AnyOfMatcher)).bind("declstmt");
 
-// create vectors to store variable and typedef declarations
-vector<string> varDeclarations;
-vector<string> typedefDeclarations;
-
 // create a class to handle the matches found by the matchers
 class UniqueIdent : public MatchFinder::MatchCallback {
 public :
+  // Name of the rule in the --profile summary of misra-check
+  StringRef getID() const override { return "2.10.3"; }
+
+  // the names are only compared within one translation unit, so forget the
+  // names of the previous one
+  virtual void onStartOfTranslationUnit() override {
+    varDeclarations.clear();
+    typedefDeclarations.clear();
+  }
+
   // override the run method to handle the match results
   virtual void run(const MatchFinder::MatchResult &Result) override {
+    // Keep the context for the report at the end of the translation unit
+    Context = Result.Context;
     // get the declaration statement containing the match
     const DeclStmt *var = Result.Nodes.getNodeAs<DeclStmt>("declstmt");
-    // get the diagnostic engine for reporting errors/warnings
-    DiagnosticsEngine &DE = Result.Context->getDiagnostics();
-    // create a custom diagnostic message for the rule violation
-    const unsigned ID = DE.getCustomDiagID(clang::DiagnosticsEngine::Error,
-      "MISRA C++ Rule 2.10.3 Violation! A typedef name shall be a unique identifier.");
 
     if (Result.SourceManager->isInSystemHeader(var->getBeginLoc())) {
       // Declaration is in a system header, ignore it
@@ -50,44 +57,89 @@ public :
     for (const Decl *D : var->decls()) {
       // check if the declaration is a typedef
       if (const TypedefDecl *ED = dyn_cast<TypedefDecl>(D)) {
-        // get the name of the typedef
-        string typeDefName = ED->getNameAsString();
-
-        // check if the typedef name has already been declared
-        for(auto itr: typedefDeclarations) {
-          if(typeDefName == itr)
-          DE.Report(ED->getLocation(), ID);
-        }
-
-        // check if the typedef name conflicts with a variable name
-        for(auto itr: varDeclarations) {
-          if(typeDefName == itr)
-          DE.Report(ED->getLocation(), ID);
-        }
-
-        // add the typedef name to the list of declarations
-        typedefDeclarations.push_back(typeDefName);
+        // get the interned name of the typedef
+        const IdentifierInfo *typeDefName = ED->getIdentifier();
+        if (!typeDefName)
+          continue;
+
+        // report once for every typedef and every variable declared before
+        // with the same name
+        unsigned count = lookup(typedefDeclarations, typeDefName) +
+                         lookup(varDeclarations, typeDefName);
+        for (unsigned i = 0; i < count; ++i)
+          Violations.add(ED->getLocation());
+
+        // add the typedef name to the table of declarations
+        ++typedefDeclarations[typeDefName];
       }
     
       // check if the declaration is a variable
       else if(const VarDecl * VD = dyn_cast<VarDecl>(D)) {
-        // get the name of the variable
-        string varName = VD->getNameAsString();
+        // get the interned name of the variable, structured bindings have none
+        const IdentifierInfo *varName = VD->getIdentifier();
+        if (!varName)
+          continue;
         // get the location of the variable
         SourceLocation loc = VD->getLocation();
 
         // check if the variable name conflicts with a typedef name
-        for(auto itr: typedefDeclarations) {
-          if(varName == itr)
-          DE.Report(loc, ID);
-        }
-        // add the variable name to the list of declarations
-        varDeclarations.push_back(varName);
+        unsigned count = lookup(typedefDeclarations, varName);
+        for (unsigned i = 0; i < count; ++i)
+          Violations.add(loc);
+
+        // add the variable name to the table of declarations
+        ++varDeclarations[varName];
       }
     }
   }
+
+  // Report the violations found in the translation unit
+  virtual void onEndOfTranslationUnit() override {
+    if (Context)
+      Violations.report(Context->getDiagnostics(),
+                        Context->getSourceManager());
+    Context = nullptr;
+  }
+
+private :
+  // number of declarations of each name in the current translation unit.
+  // Identifiers are interned by the ASTContext, so the pointer is the key and
+  // no name is ever copied.
+  typedef DenseMap<const IdentifierInfo *, unsigned> NameTable;
+
+  static unsigned lookup(const NameTable &table, const IdentifierInfo *name) {
+    auto itr = table.find(name);
+    return itr == table.end() ? 0 : itr->second;
+  }
+
+  NameTable varDeclarations;
+  NameTable typedefDeclarations;
+
+  // Context of the matches, for the report
+  ASTContext *Context = nullptr;
+  misra::ViolationRecorder Violations{
+      "MISRA C++ Rule 2.10.3 Violation! A typedef name shall be a unique "
+      "identifier."};
+};
+
+// The rule as registered in the misra-check driver
+class Rule2_10_3 : public misra::ASTRule {
+public:
+  void registerMatchers(MatchFinder &Finder) override {
+    Finder.addMatcher(DeclMatcher, &ident);
+  }
+
+private:
+  UniqueIdent ident;
 };
 
+} // namespace
+
+std::unique_ptr<misra::ASTRule> misra::createRule2_10_3() {
+  return std::make_unique<Rule2_10_3>();
+}
+
+#ifndef MISRA_CHECK_DRIVER
 // Apply a custom category to all command-line options so that they are the
 // only ones displayed.
 static llvm::cl::OptionCategory MyToolCategory("my-tool options");
@@ -111,12 +163,13 @@ int main(int argc, const char **argv) {
   ClangTool Tool(OptionsParser.getCompilations(),
                  OptionsParser.getSourcePathList());
 
-  UniqueIdent ident;
+  auto Rule = misra::createRule2_10_3();
   MatchFinder Finder;
-  Finder.addMatcher(DeclMatcher, &ident);
+  Rule->registerMatchers(Finder);
 
   return Tool.run(newFrontendActionFactory(&Finder).get());
 }
+#endif // MISRA_CHECK_DRIVER
 
                                         // DOCUMENTATION //
 /*
@@ -132,8 +185,10 @@ Next, the code defines a StatementMatcher named DeclMatcher that matches any dec
 The code then defines a class called UniqueIdent that inherits from MatchFinder::MatchCallback. 
 This class defines a run method that is called by the MatchFinder when it finds a match for the DeclMatcher. 
 In this method, the code checks whether the matched declaration is a typedef or a var. 
-If it is a typedef, the code checks whether the name of the typedef is unique by comparing it with all the previous typedef and var declarations. 
+If it is a typedef, the code checks whether the name of the typedef is unique by looking it up in the tables of the previous typedef and var declarations. 
 If it is not unique,the code reports an error using Clang's diagnostics engine.
+The tables are DenseMaps from the IdentifierInfo of a name to the number of declarations with that name, so each lookup takes constant time and no string is copied.
+The names seen so far are members of UniqueIdent and are cleared in onStartOfTranslationUnit, so every translation unit is checked on its own.
 
 The main function of the code sets up the Clang tool by creating a CommonOptionsParser object, which parses the command-line options, and a ClangTool object, which represents the compilation process. 
 It then creates a MatchFinder object and adds the DeclMatcher and UniqueIdent objects to it. 
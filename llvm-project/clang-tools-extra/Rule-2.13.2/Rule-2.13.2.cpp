@@ -5,6 +5,10 @@
 #include "llvm/Support/raw_ostream.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "llvm/Support/CommandLine.h"
+#include "MisraRule.h"
+#include "ViolationRecorder.h"
+#include "TokenPattern.h"
+#include "TokenRuleAction.h"
 
 using namespace clang;
 using namespace clang::tooling;
@@ -13,40 +17,41 @@ using namespace std;
 using namespace clang::tooling;
 using namespace llvm;
 
-// Define a class OctalLiteralFinder which inherits from PreprocessorFrontendAction
-class OctalLiteralFinder : public clang::PreprocessorFrontendAction {
+namespace {
+
+// Define a class OctalLiteralFinder which looks for octal literals in the
+// tokens of the input
+class OctalLiteralFinder : public misra::TokenRule,
+                           public misra::TokenPatternCallback {
 public:
-  // Override the ExecuteAction() method
-  virtual void ExecuteAction() {
-    // Get the preprocessor, diagnostics, and source manager from the compiler instance
-    auto& pp = getCompilerInstance().getPreprocessor();
-    auto& diags = getCompilerInstance().getDiagnostics();
-    auto& sm = pp.getSourceManager();
-
-    // Tokenize the input source file
-    pp.EnterMainSourceFile();
-    clang::Token tok;
-
-    // Loop over all the tokens in the input source file
-    while (true) {
-      pp.Lex(tok);
-      if (tok.is(clang::tok::eof))
-        break;
-
-      // Check if the token is a literal with a length of at least 2 and starts with '0'
-      if (tok.isLiteral() && tok.getLiteralData() != nullptr &&
-          tok.getLength() >= 2 && tok.getLiteralData()[0] == '0' &&
-          (tok.getKind() == clang::tok::numeric_constant ||
-           tok.getKind() == clang::tok::char_constant)) {
-        // Found an octal literal, report a diagnostic for MISRA C++ Rule 2.13.2 violation
-        auto loc = sm.getSpellingLoc(tok.getLocation());
-        auto line = sm.getSpellingLineNumber(loc);
-        diags.Report(loc, diags.getCustomDiagID(clang::DiagnosticsEngine::Error, "MISRA C++ Rule 2.13.2 Violation! octal constant on line %0")) << line;
-      }
-    }
+  // Look for a literal with a length of at least 2 that starts with '0'
+  void registerPatterns(misra::TokenPatternSet &patterns) override {
+    patterns.addPattern(misra::token_patterns::zeroPrefixedLiteral(), this);
+  }
+
+  // Called for every octal literal of the preprocessed input source file
+  void run(const clang::Token &tok, clang::Preprocessor &pp) override {
+    // Found an octal literal, record a MISRA C++ Rule 2.13.2 violation
+    Violations.add(pp.getSourceManager().getSpellingLoc(tok.getLocation()));
+  }
+
+  // Report the violations found in the translation unit
+  void endTranslationUnit(clang::Preprocessor &pp) override {
+    Violations.report(pp.getDiagnostics(), pp.getSourceManager());
   }
+
+private:
+  misra::ViolationRecorder Violations{
+      "MISRA C++ Rule 2.13.2 Violation! octal constant on line %0"};
 };
 
+} // namespace
+
+std::unique_ptr<misra::TokenRule> misra::createRule2_13_2() {
+  return std::make_unique<OctalLiteralFinder>();
+}
+
+#ifndef MISRA_CHECK_DRIVER
 // Define a command line option category for the tool
 static llvm::cl::OptionCategory MyToolCategory("my-tool options");
 
@@ -63,19 +68,21 @@ int main(int argc, const char** argv) {
   ClangTool Tool(OptionsParser.getCompilations(),
                  OptionsParser.getSourcePathList());
 
-  // Run the OctalLiteralFinder action on the input source file(s)
-  return Tool.run(newFrontendActionFactory<OctalLiteralFinder>().get());
+  // Run the OctalLiteralFinder rule on the input source file(s)
+  auto Rule = misra::createRule2_13_2();
+  return Tool.run(misra::newTokenRuleActionFactory(Rule.get()).get());
 }
+#endif // MISRA_CHECK_DRIVER
                                 // DOCUMENTATION //
 
 /*
 The given code is a C++ program that uses the Clang tooling library to build a custom tool for source code analysis and manipulation. The tool finds octal literals in the input source file(s) and reports a diagnostic for a MISRA C++ Rule 2.13.2 violation. 
 
-The program consists of two main classes: `OctalLiteralFinder` and `Main`. The `OctalLiteralFinder` class is a subclass of `PreprocessorFrontendAction`, which provides an interface to perform actions before and after preprocessing. The `Main` class is the entry point of the program, which defines the `main` function and sets up the command line options using `CommonOptionsParser`.
+The program consists of two main classes: `OctalLiteralFinder` and `Main`. The `OctalLiteralFinder` class is a subclass of `misra::TokenRule`, which is the interface for rules that look at the preprocessed tokens. The tokens are produced by `misra::TokenRuleAction`, which lexes each input file once and hands every token to all the token rules that are run together. The `Main` class is the entry point of the program, which defines the `main` function and sets up the command line options using `CommonOptionsParser`.
 
-The `OctalLiteralFinder` class overrides the `ExecuteAction()` method, which is called by the Clang tooling framework to execute the action. The method first gets the preprocessor, diagnostics, and source manager from the compiler instance. Then, it tokenizes the input source file and loops over all the tokens in the input source file. For each token, it checks if the token is a literal with a length of at least 2 and starts with '0'. If a token satisfies these conditions, it reports a diagnostic for a MISRA C++ Rule 2.13.2 violation using the source manager and diagnostics.
+The `OctalLiteralFinder` class overrides the `registerPatterns()` method, which adds the token pattern `zeroPrefixedLiteral()` to the `misra::TokenPatternSet` of the shared lex loop: a literal with a length of at least 2 that starts with '0'. The set runs the patterns of all the token rules together, and calls the `run()` method of the class, a `misra::TokenPatternCallback`, for every token that matches. The method records a MISRA C++ Rule 2.13.2 violation at the spelling location of the token. The `endTranslationUnit()` method then reports all the recorded violations, with their line numbers, through the diagnostics engine.
 
-The `Main` class defines a command line option category for the tool using the `OptionCategory` class from the `llvm::cl` namespace. It uses `CommonOptionsParser` to parse the command line options, which include the input source file(s) and other tool options. Then, it creates a `ClangTool` instance and runs the `OctalLiteralFinder` action on the input source file(s).
+The `Main` class defines a command line option category for the tool using the `OptionCategory` class from the `llvm::cl` namespace. It uses `CommonOptionsParser` to parse the command line options, which include the input source file(s) and other tool options. Then, it creates a `ClangTool` instance and runs the `OctalLiteralFinder` rule on the input source file(s) with a `misra::TokenRuleAction`.
 
 In summary, the program demonstrates how to use the Clang tooling library to build custom tools for source code analysis and manipulation. Specifically, it shows how to create a tool that finds octal literals in the input source file(s) and reports a diagnostic for a MISRA C++ Rule 2.13.2 violation.
 */
\ No newline at end of file
@@ -5,57 +5,60 @@
 #include "llvm/Support/raw_ostream.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "llvm/Support/CommandLine.h"
+#include "MisraRule.h"
+#include "ViolationRecorder.h"
+#include "TokenPattern.h"
+#include "TokenRuleAction.h"
 
 using namespace clang;
 using namespace clang::tooling;
 using namespace llvm;
 using namespace std;
 
-// This class is a frontend action that will be run on the preprocessor stage.
-class OctalLiteralFinder : public clang::PreprocessorFrontendAction {
+namespace {
+
+// This class looks for octal literals of unsigned type in the tokens of the
+// input after the preprocessor stage.
+class OctalLiteralFinder : public misra::TokenRule,
+                           public misra::TokenPatternCallback {
 public:
-  virtual void ExecuteAction() {
-    // Get the preprocessor, diagnostics engine, and source manager.
-    auto& pp = getCompilerInstance().getPreprocessor();
-    auto& diags = getCompilerInstance().getDiagnostics();
-    auto& sm = pp.getSourceManager();
-
-    // Tokenize the input source file
-    pp.EnterMainSourceFile();
-    clang::Token tok;
-    bool uns_flg=false;
-    bool oct_flg=false;
-    // Process each token in the input source file.
-    while (true) {
-      pp.Lex(tok);
-      if (tok.is(clang::tok::eof))
-        break;
-        
-      // If we find an "unsigned" keyword, set the flag to true.
-      if (tok.is(clang::tok::kw_unsigned)) {
-        errs() << "Found unsigned keyword!\n";
-        uns_flg=true;
-      }
-      
-      // If we find a literal token that starts with '0' and has at least 2 characters,
-      // and is either a numeric or character constant token, we may have found an octal literal.
-      if (tok.isLiteral() && tok.getLiteralData() != nullptr &&
-          tok.getLength() >= 2 && tok.getLiteralData()[0] == '0' &&
-          (tok.getKind() == clang::tok::numeric_constant ||
-           tok.getKind() == clang::tok::char_constant)) {
-        // Found an octal literal
-        auto loc = sm.getSpellingLoc(tok.getLocation());
-        auto line = sm.getSpellingLineNumber(loc);
-        // Check if the octal literal violates MISRA C++ Rule 2.13.3, which requires
-        // that all octal or hexadecimal integer literals of unsigned type have a 'U' suffix.
-        if(uns_flg && (tok.getLiteralData()[0] == 'x' || tok.getLiteralData()[0] == 'X' ||  tok.getLiteralData()[tok.getLength()-1] != 'U'))
-          diags.Report(loc, diags.getCustomDiagID(clang::DiagnosticsEngine::Error, "MISRA C++ Rule 2.13.3 Violation! A U  suffix shall be applied to all octal or hexadecimal integer literals of unsigned type ")) << line;
-        uns_flg=false;
-      }
-    }
+  // MISRA C++ Rule 2.13.3 requires that all octal or hexadecimal integer
+  // literals of unsigned type have a 'U' suffix. Look for an "unsigned"
+  // keyword followed by a literal that starts with '0' and has at least 2
+  // characters, without another such literal in between, whose last
+  // character is not 'U'.
+  void registerPatterns(misra::TokenPatternSet &patterns) override {
+    using namespace misra::token_patterns;
+    patterns.addPattern(
+        sequence({kind(clang::tok::kw_unsigned),
+                  zeroOrMore(unless(zeroPrefixedLiteral())),
+                  allOf(zeroPrefixedLiteral(), unless(literalEndsWith('U')))}),
+        this);
+  }
+
+  // Called for every octal literal of unsigned type without a 'U' suffix
+  void run(const clang::Token &tok, clang::Preprocessor &pp) override {
+    Violations.add(pp.getSourceManager().getSpellingLoc(tok.getLocation()));
+  }
+
+  // Report the violations found in the translation unit
+  void endTranslationUnit(clang::Preprocessor &pp) override {
+    Violations.report(pp.getDiagnostics(), pp.getSourceManager());
   }
+
+private:
+  misra::ViolationRecorder Violations{
+      "MISRA C++ Rule 2.13.3 Violation! A U  suffix shall be applied to all "
+      "octal or hexadecimal integer literals of unsigned type "};
 };
 
+} // namespace
+
+std::unique_ptr<misra::TokenRule> misra::createRule2_13_3() {
+  return std::make_unique<OctalLiteralFinder>();
+}
+
+#ifndef MISRA_CHECK_DRIVER
 // Define an option category for the tool.
 static llvm::cl::OptionCategory MyToolCategory("my-tool options");
 
@@ -71,20 +74,22 @@ int main(int argc, const char** argv) {
   ClangTool Tool(OptionsParser.getCompilations(),
                  OptionsParser.getSourcePathList());
 
-  return Tool.run(newFrontendActionFactory<OctalLiteralFinder>().get());
-  // Run the frontend action defined by OctalLiteralFinder on the input source file.
+  // Run the OctalLiteralFinder rule on the input source file.
+  auto Rule = misra::createRule2_13_3();
+  return Tool.run(misra::newTokenRuleActionFactory(Rule.get()).get());
 
 }
+#endif // MISRA_CHECK_DRIVER
 
                               //DOCUMENTATION
 /*
 The given code is a C++ program that uses the Clang C++ compiler infrastructure to find octal literals in a source file and check if they violate MISRA C++ Rule 2.13.3. The program takes a C++ source file as input and reports any octal literals that violate the MISRA C++ Rule 2.13.3. 
 
-The program uses the Clang Tooling API to create a custom frontend action, `OctalLiteralFinder`, which inherits from the `PreprocessorFrontendAction` class. The `OctalLiteralFinder` class overrides the `ExecuteAction()` method, which is called when the frontend action is executed. 
+The program defines a token rule, `OctalLiteralFinder`, which inherits from the `misra::TokenRule` class. The `OctalLiteralFinder` class overrides the `registerPatterns()` method, which adds a token pattern to the `misra::TokenPatternSet` of the shared lex loop of `misra::TokenRuleAction`. The set runs the patterns of all the token rules together in one automaton, so the rule keeps no state of its own between the tokens. 
 
-In the `ExecuteAction()` method, the program retrieves the preprocessor, diagnostics engine, and source manager from the compiler instance. The input source file is tokenized using the preprocessor, and each token is processed to find octal literals. The program checks if a literal token starts with '0' and has at least 2 characters and is either a numeric or character constant token, indicating it may be an octal literal. If it is an octal literal, the program checks if it violates MISRA C++ Rule 2.13.3, which requires that all octal or hexadecimal integer literals of unsigned type have a 'U' suffix. If a violation is found, the program reports an error using the diagnostics engine. 
+The pattern is `sequence({kind(tok::kw_unsigned), zeroOrMore(unless(zeroPrefixedLiteral())), allOf(zeroPrefixedLiteral(), unless(literalEndsWith('U')))})`: an "unsigned" keyword, then any tokens but an octal literal, then a literal that starts with '0' and has at least 2 characters, is either a numeric or character constant token, and does not end with 'U'. Such a literal violates MISRA C++ Rule 2.13.3, which requires that all octal or hexadecimal integer literals of unsigned type have a 'U' suffix. For each one the set calls the `run()` method, which records its location in a `misra::ViolationRecorder`, which reports all the violations as errors through the diagnostics engine in `endTranslationUnit()`. 
 
-The program defines an option category for the tool and uses the `CommonOptionsParser` class to parse command line arguments and options. It creates a `ClangTool` object and runs the frontend action defined by `OctalLiteralFinder` on the input source file.
+The program defines an option category for the tool and uses the `CommonOptionsParser` class to parse command line arguments and options. It creates a `ClangTool` object and runs the `OctalLiteralFinder` rule on the input source file through `misra::newTokenRuleActionFactory`.
 
 Overall, the program provides a way to enforce a specific coding rule by finding violations in the source code and reporting them to the user.
 */
\ No newline at end of file
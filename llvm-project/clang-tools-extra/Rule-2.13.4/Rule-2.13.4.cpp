@@ -5,52 +5,52 @@
 #include "llvm/Support/raw_ostream.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "llvm/Support/CommandLine.h"
+#include "MisraRule.h"
+#include "ViolationRecorder.h"
+#include "TokenPattern.h"
+#include "TokenRuleAction.h"
 
 using namespace clang;
 using namespace clang::tooling;
 using namespace llvm;
 using namespace std;
 
-// Define a class OctalLiteralFinder that derives from the PreprocessorFrontendAction class
-class OctalLiteralFinder : public clang::PreprocessorFrontendAction {
+namespace {
+
+// Define a class OctalLiteralFinder that looks for literals with a lower case
+// suffix in the tokens of the input
+class OctalLiteralFinder : public misra::TokenRule,
+                           public misra::TokenPatternCallback {
 public:
-  virtual void ExecuteAction() {
-    auto& pp = getCompilerInstance().getPreprocessor();
-    auto& diags = getCompilerInstance().getDiagnostics();
-    auto& sm = pp.getSourceManager();
-
-    // Tokenize the input source file
-    pp.EnterMainSourceFile();
-    clang::Token tok;
-    while (true) {
-      pp.Lex(tok);
-      if (tok.is(clang::tok::eof))
-        break;
-        
-      // If the token is a literal and its kind is numeric_constant or char_constant, check if it's an octal literal
-      if (tok.isLiteral() && tok.getLiteralData() != nullptr &&
-          (tok.getKind() == clang::tok::numeric_constant ||
-           tok.getKind() == clang::tok::char_constant)) {
-        // Found an octal literal
-    auto loc = sm.getSpellingLoc(tok.getLocation());
-    auto line = sm.getSpellingLineNumber(loc);
-    bool char_flg=check_char(tok.getLiteralData()[tok.getLength()-1]);
-    // Check if the last character of the literal is a lowercase letter
-    if(char_flg)
-    diags.Report(loc, diags.getCustomDiagID(clang::DiagnosticsEngine::Error, "MISRA C++ Rule 2.13.4 Literal suffixes shall be upper case.")) << line;
-      }
-    }
+  // Look for a numeric or character literal whose last character is a
+  // lowercase letter
+  void registerPatterns(misra::TokenPatternSet &patterns) override {
+    patterns.addPattern(misra::token_patterns::literalEndsWithLowerCase(),
+                        this);
   }
 
-  // A helper function that checks if a character is a lowercase letter
-  bool check_char(char ch){
-     if (std::isalpha(ch) && (islower(ch))) { 
-      return true;
+  // Called for every literal with a lower case suffix
+  void run(const clang::Token &tok, clang::Preprocessor &pp) override {
+    Violations.add(pp.getSourceManager().getSpellingLoc(tok.getLocation()));
   }
-    return false;
+
+  // Report the violations found in the translation unit
+  void endTranslationUnit(clang::Preprocessor &pp) override {
+    Violations.report(pp.getDiagnostics(), pp.getSourceManager());
   }
+
+private:
+  misra::ViolationRecorder Violations{
+      "MISRA C++ Rule 2.13.4 Literal suffixes shall be upper case."};
 };
 
+} // namespace
+
+std::unique_ptr<misra::TokenRule> misra::createRule2_13_4() {
+  return std::make_unique<OctalLiteralFinder>();
+}
+
+#ifndef MISRA_CHECK_DRIVER
 static llvm::cl::OptionCategory MyToolCategory("my-tool options");
 
 int main(int argc, const char** argv) {
@@ -64,9 +64,11 @@ int main(int argc, const char** argv) {
   ClangTool Tool(OptionsParser.getCompilations(),
                  OptionsParser.getSourcePathList());
 
-  // Run the OctalLiteralFinder action on the source code
-  return Tool.run(newFrontendActionFactory<OctalLiteralFinder>().get());
+  // Run the OctalLiteralFinder rule on the source code
+  auto Rule = misra::createRule2_13_4();
+  return Tool.run(misra::newTokenRuleActionFactory(Rule.get()).get());
 }
+#endif // MISRA_CHECK_DRIVER
                                   //DOCUMENTATION
 /*
 The code you provided is a C++ program that uses the Clang tooling library to find octal literals in a source file and check if their suffixes are in upper case, in accordance with the MISRA C++ Rule 2.13.4.
@@ -80,20 +82,18 @@ The program includes several header files from the Clang tooling library and LLV
 The program uses several namespaces from the Clang and LLVM libraries to avoid naming conflicts.
 
 3. OctalLiteralFinder class
-The OctalLiteralFinder class derives from the PreprocessorFrontendAction class. This means that it will be executed by the Clang tooling library as part of the preprocessor phase of compiling a C++ source file.
-
-4. ExecuteAction() function
-This function is called by the Clang tooling library when the OctalLiteralFinder class is executed. It retrieves the preprocessor, diagnostics, and source manager objects from the CompilerInstance class, which is a member of the PreprocessorFrontendAction class
+The OctalLiteralFinder class derives from the misra::TokenRule class. This means that it is given the tokens of the preprocessed C++ source file by misra::TokenRuleAction, which lexes the file once for all the token rules.
 
-The function then tokenizes the input source file using the preprocessor's Lex() function, which returns the next token in the source file. If the token is an octal or character literal, the function checks if the last character of the literal is a lowercase letter. If it is, the function reports an error using the diagnostics object and the location of the offending token.
+4. registerPatterns() function
+This function adds the token pattern literalEndsWithLowerCase() to the misra::TokenPatternSet of the lex loop, which runs the patterns of all the token rules together. The pattern matches a numeric or character literal whose last character is a lowercase letter.
 
-5. check_char() function
-This is a helper function that checks if a character is a lowercase letter.It is called by the ExecuteAction() function to determine if the last character of an octal or character literal is a lowercase letter.
+5. run() function
+The set calls this function, of the misra::TokenPatternCallback interface, for every token that matches the pattern. It records the location of the offending token, and the violations are reported through the diagnostics engine in endTranslationUnit().
 
 6. OptionCategory and main() function
 The program defines an option category using the OptionCategory class from LLVM. This category is used to group the program's command line options.
 
-The main() function uses the CommonOptionsParser class from the Clang tooling library to parse the program's command line options. It then creates a ClangTool object using the command line options and runs the OctalLiteralFinder action on the source code using the newFrontendActionFactory() function.
+The main() function uses the CommonOptionsParser class from the Clang tooling library to parse the program's command line options. It then creates a ClangTool object using the command line options and runs the OctalLiteralFinder rule on the source code using the misra::newTokenRuleActionFactory() function.
 
-In summary, the program uses the Clang tooling library and LLVM to find octal literals in a C++ source file and check if their suffixes are in upper case, in accordance with the MISRA C++ Rule 2.13.4. It does this by defining a new class that derives from the PreprocessorFrontendAction class, implementing a function that tokenizes the input source file, and defining a helper function that checks if a character is a lowercase letter. The program also provides a command line interface using the CommonOptionsParser class and the OptionCategory class from LLVM.
+In summary, the program uses the Clang tooling library and LLVM to find octal literals in a C++ source file and check if their suffixes are in upper case, in accordance with the MISRA C++ Rule 2.13.4. It does this by defining a new class that derives from the misra::TokenRule class, and registering a token pattern that matches the literals with a lower case suffix. The program also provides a command line interface using the CommonOptionsParser class and the OptionCategory class from LLVM.
 */
\ No newline at end of file
@@ -5,58 +5,51 @@
 #include "llvm/Support/raw_ostream.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "llvm/Support/CommandLine.h"
+#include "MisraRule.h"
+#include "ViolationRecorder.h"
+#include "TokenPattern.h"
+#include "TokenRuleAction.h"
 
 using namespace clang;
 using namespace clang::tooling;
 using namespace llvm;
 using namespace std;
 
-// Define a class that inherits from the clang::PreprocessorFrontendAction class
-class OctalLiteralFinder : public clang::PreprocessorFrontendAction {
+namespace {
+
+// Define a class that looks for hexadecimal literals in the preprocessed
+// input
+class OctalLiteralFinder : public misra::TokenRule,
+                           public misra::TokenPatternCallback {
 public:
-  virtual void ExecuteAction() {
-    // Get references to the preprocessor, diagnostics, and source manager
-    auto& pp = getCompilerInstance().getPreprocessor();
-    auto& diags = getCompilerInstance().getDiagnostics();
-    auto& sm = pp.getSourceManager();
+  // Look for a literal starting with 0x or 0X
+  void registerPatterns(misra::TokenPatternSet &patterns) override {
+    patterns.addPattern(misra::token_patterns::hexLiteral(), this);
+  }
 
-    // Tokenize the input source file
-    pp.EnterMainSourceFile();
-    clang::Token tok;
-    bool uns_flg=false;
-    bool oct_flg=false;
-    while (true) {
-      pp.Lex(tok);
-      // Break if we reach the end of the file
-      if (tok.is(clang::tok::eof))
-        break;
+  // Called for every hexadecimal literal, which violates the coding rule
+  void run(const clang::Token &tok, clang::Preprocessor &pp) override {
+    Violations.add(pp.getSourceManager().getSpellingLoc(tok.getLocation()));
+  }
 
-      // Check if the current token is the "unsigned" keyword
-      if (tok.is(clang::tok::kw_unsigned)) {
-        // Print a message to stderr
-        errs() << "Found unsigned keyword!\n";
-        // Set the unsigned flag to true
-        uns_flg=true;
-      }
-      
-      // Check if the current token is an octal literal
-      if (tok.isLiteral() && tok.getLiteralData() != nullptr &&
-          tok.getLength() >= 2 && tok.getLiteralData()[0] == '0' &&
-          (tok.getKind() == clang::tok::numeric_constant ||
-           tok.getKind() == clang::tok::char_constant)) {
-        // Found an octal literal, get the location and line number
-        auto loc = sm.getSpellingLoc(tok.getLocation());
-        auto line = sm.getSpellingLineNumber(loc);
-        // Check if the octal literal violates a coding rule
-        if((tok.getLiteralData()[1] == 'x' || tok.getLiteralData()[1] == 'X'))
-          diags.Report(loc, diags.getCustomDiagID(clang::DiagnosticsEngine::Error, "MISRA C++ Rule 3.9.3 Violation! The underlying bit representations of floating-point values shall not be used.")) << line;
-        // Reset the unsigned flag
-        uns_flg=false;
-      }
-    }
+  // Report the violations found in the translation unit
+  void endTranslationUnit(clang::Preprocessor &pp) override {
+    Violations.report(pp.getDiagnostics(), pp.getSourceManager());
   }
+
+private:
+  misra::ViolationRecorder Violations{
+      "MISRA C++ Rule 3.9.3 Violation! The underlying bit representations of "
+      "floating-point values shall not be used."};
 };
 
+} // namespace
+
+std::unique_ptr<misra::TokenRule> misra::createRule3_9_3() {
+  return std::make_unique<OctalLiteralFinder>();
+}
+
+#ifndef MISRA_CHECK_DRIVER
 // Define an option category for the tool
 static llvm::cl::OptionCategory MyToolCategory("my-tool options");
 
@@ -73,22 +66,22 @@ int main(int argc, const char** argv) {
   // Create a ClangTool object
   ClangTool Tool(OptionsParser.getCompilations(),
                  OptionsParser.getSourcePathList());
-  // Run the tool with an instance of the OctalLiteralFinder class as the frontend action
-  return Tool.run(newFrontendActionFactory<OctalLiteralFinder>().get());
+  // Run the tool with the OctalLiteralFinder rule in the shared token pass
+  auto Rule = misra::createRule3_9_3();
+  return Tool.run(misra::newTokenRuleActionFactory(Rule.get()).get());
 }
+#endif // MISRA_CHECK_DRIVER
                               //DOCUMENTATION
 /*
 This is a C++ code that uses the Clang tooling library to identify violations of a specific rule in C++ code. The rule that this code checks for is "MISRA C++ Rule 3.9.3 Violation! The underlying bit representations of floating-point values shall not be used."
 
-The code starts by including the necessary headers from the Clang tooling library and the LLVM support library. It then defines a class called OctalLiteralFinder that inherits from the clang::PreprocessorFrontendAction class.
-
-In the main function, the code creates a CommonOptionsParser object, which parses the command-line options, and a ClangTool object, which represents the compilation process. It then runs the tool by calling the run method on the ClangTool object and passing it a factory for the frontend action that will run the OctalLiteralFinder.
+The code starts by including the necessary headers from the Clang tooling library and the LLVM support library. It then defines a class called OctalLiteralFinder that inherits from the misra::TokenRule class.
 
-The OctalLiteralFinder class defines a virtual function called ExecuteAction that is called by the Clang tool when it processes the input source file. In this method, the code gets references to the preprocessor, diagnostics, and source manager. It then tokenizes the input source file and searches for octal literals and the "unsigned" keyword.
+In the main function, the code creates a CommonOptionsParser object, which parses the command-line options, and a ClangTool object, which represents the compilation process. It then runs the tool by calling the run method on the ClangTool object and passing it a factory for misra::TokenRuleAction, the shared lex loop that gives every token to the OctalLiteralFinder.
 
-If an octal literal is found, the code gets the location and line number of the literal and checks whether it violates a coding rule. If it does, the code reports an error using Clang's diagnostics engine.
+The OctalLiteralFinder class overrides the registerPatterns method, which adds the token pattern hexLiteral() to the misra::TokenPatternSet of the lex loop: a literal that starts with 0x or 0X. The set runs the patterns of all the token rules together, and calls the run method of the class for every token that matches.
 
-If the "unsigned" keyword is found, the code sets a flag to true. If an octal literal is found and the flag is true, the code reports an error because the combination of "unsigned" and octal literals violates the coding rule.
+For each hexadecimal literal, the code records the location of the literal in a `misra::ViolationRecorder`, which reports the violations as errors using Clang's diagnostics engine at the end of the translation unit.
 
 Overall, this code uses the Clang tooling library to identify violations of a specific coding rule in C++ code and report them using Clang's diagnostics engine.
 */
\ No newline at end of file
@@ -6,6 +6,10 @@
 #include "clang/Tooling/Tooling.h"
 #include "llvm/Support/CommandLine.h"
 #include <vector>
+#include "MisraCheckAction.h"
+#include "MisraRule.h"
+#include "OperatorVisitor.h"
+#include "ViolationRecorder.h"
 
 // Use these namespaces to simplify code
 using namespace clang;
@@ -14,68 +18,70 @@ using namespace clang::tooling;
 using namespace llvm;
 using namespace std;
 
-StatementMatcher OperatorMatcher = anyOf(
-    binaryOperator(unless(anyOf(
-                                hasOperatorName("||"), hasOperatorName("&&"),
-                                hasOperatorName("=="), hasOperatorName("!="),
-                                hasOperatorName("="))))
-        .bind("binaryoperator"),
-    unaryOperator(unless(anyOf(hasOperatorName("&"),hasOperatorName("!")))).bind("unaryoperator"));
+namespace {
 
-// Create a callback class for the match found by the matcher
-class OperatorPrinter : public MatchFinder::MatchCallback {
+// Create a check class for the operators given to it by the operator visitor
+class OperatorPrinter : public misra::OperatorCheck {
 public:
-  // Override the virtual run function to process the match result
-  virtual void run(const MatchFinder::MatchResult &Result) override {
-    // Get the matched binary operator node
-    const BinaryOperator *binOp =
-        Result.Nodes.getNodeAs<BinaryOperator>("binaryoperator");
-    // Get the matched unary operator node
-    const UnaryOperator *unOp =
-        Result.Nodes.getNodeAs<UnaryOperator>("unaryoperator");
-    // Get the location of the operator in the source code
-    SourceLocation loc;
-    if (binOp) {
-      loc = binOp->getOperatorLoc();
-      // Get the full location of the operator in the source code
-      FullSourceLoc fullLoc(loc, (Result.Context->getSourceManager()));
-      // Get the diagnostics engine to report errors
-      DiagnosticsEngine &DE = Result.Context->getDiagnostics();
-      // Get a custom error ID for the violation
-      const unsigned ID = DE.getCustomDiagID(
-          clang::DiagnosticsEngine::Error,
-          "MISRA C++ Rule 4.5.1 Violation! Expressions with type bool shall not be used as operands to built-in operators other than the assignment operator =, the logical operators &&, ||, !, the equality operators == and !=, the unary & operator,and the conditional operator.");
-      // Get the left-hand side and right-hand side of the operator and ignore
-      // implicit casts
-      auto *LHS = binOp ? binOp->getLHS()->IgnoreParenImpCasts() : nullptr;
-      auto *RHS = binOp ? binOp->getRHS()->IgnoreParenImpCasts() : nullptr;
-      // Check if either operands is of boolean type
-      if (LHS && RHS && (LHS->getType()->isBooleanType() || RHS->getType()->isBooleanType())) {
-        // Report the violation
-        DE.Report(loc, ID);
-      }
+  // Name of the rule in the --profile summary of misra-check
+  StringRef getID() const override { return "4.5.1"; }
+
+  // Check the binary operators other than ||, &&, ==, != and =
+  virtual void checkBinary(const BinaryOperator &binOp,
+                           const misra::OperandInfo &LHS,
+                           const misra::OperandInfo &RHS,
+                           ASTContext &Context) override {
+    // Check if either operand, ignoring implicit casts, is of boolean type
+    if (LHS.WrittenIsBool || RHS.WrittenIsBool) {
+      // Record the violation at the location of the operator
+      Violations.add(binOp.getOperatorLoc());
     }
+  }
 
-    if (unOp) {
-      loc = unOp->getOperatorLoc();
-      // Get the full location of the operator in the source code
-      FullSourceLoc fullLoc(loc, (Result.Context->getSourceManager()));
-      // Get the diagnostics engine to report errors
-      DiagnosticsEngine &DE = Result.Context->getDiagnostics();
-      // Get a custom error ID for the violation
-      const unsigned ID = DE.getCustomDiagID(
-          clang::DiagnosticsEngine::Error,
-          "MISRA C++ Rule 4.5.1 Violation! Expressions with type bool shall not be used as operands to built-in operators other than the assignment operator =, the logical operators &&, ||, !, the equality operators == and !=, the unary & operator,and the conditional operator.");
-          auto *operand = unOp->getSubExpr()->IgnoreParenImpCasts();
-      // Check if the operand is of boolean type
-      if (operand && operand->getType()->isBooleanType()) {
-        // Report the MISRA C++ rule 4.5.1 violation
-        DE.Report(loc, ID);
-      }
+  // Check the unary operators other than & and !
+  virtual void checkUnary(const UnaryOperator &unOp,
+                          const misra::OperandInfo &operand,
+                          ASTContext &Context) override {
+    // Check if the operand is of boolean type
+    if (operand.WrittenIsBool) {
+      // Record the MISRA C++ rule 4.5.1 violation
+      Violations.add(unOp.getOperatorLoc());
     }
   }
+
+  // Report the violations found in the translation unit
+  virtual void endTranslationUnit(ASTContext &Context) override {
+    Violations.report(Context.getDiagnostics(), Context.getSourceManager());
+  }
+
+private:
+  misra::ViolationRecorder Violations{
+      "MISRA C++ Rule 4.5.1 Violation! Expressions with type bool shall not be "
+      "used as operands to built-in operators other than the assignment "
+      "operator =, the logical operators &&, ||, !, the equality operators == "
+      "and !=, the unary & operator,and the conditional operator."};
+};
+
+// The rule as registered in the misra-check driver
+class Rule4_5_1 : public misra::ASTRule {
+public:
+  void registerOperatorChecks(misra::OperatorVisitor &Visitor) override {
+    Visitor.addBinaryCheckExcept({BO_LOr, BO_LAnd, BO_EQ, BO_NE, BO_Assign},
+                                 &printer);
+    Visitor.addUnaryCheckExcept({UO_AddrOf, UO_LNot}, &printer);
+  }
+
+private:
+  OperatorPrinter printer;
 };
 
+} // namespace
+
+std::unique_ptr<misra::ASTRule> misra::createRule4_5_1() {
+  return std::make_unique<Rule4_5_1>();
+}
+
+#ifndef MISRA_CHECK_DRIVER
 // Create an option category for the tool
 static llvm::cl::OptionCategory MyToolCategory("my-tool options");
 
@@ -91,12 +97,17 @@ int main(int argc, const char **argv) {
   ClangTool Tool(OptionsParser.getCompilations(),
                  OptionsParser.getSourcePathList());
 
-  OperatorPrinter printer;
+  auto Rule = misra::createRule4_5_1();
   MatchFinder finder;
-  finder.addMatcher(OperatorMatcher, &printer);
+  misra::OperatorVisitor Operators;
+  Rule->registerMatchers(finder);
+  Rule->registerOperatorChecks(Operators);
 
-  return Tool.run(newFrontendActionFactory(&finder).get());
+  return Tool.run(misra::newMisraCheckActionFactory(finder, Operators,
+                                                    Rule.get(), None)
+                      .get());
 }
+#endif // MISRA_CHECK_DRIVER
 
                                   //DOCUMENTATION
 /*
@@ -104,9 +115,7 @@ This is a C++ program that uses the Clang AST Matchers library to find violation
 
 The program first includes necessary header files, which are used to import the Clang AST Matchers library, the Clang Frontend Actions library, the Clang Tooling library, and the LLVM command line library. It also uses several namespaces to simplify the code.
 
-The program then defines a `StatementMatcher` called `OperatorMatcher` that matches binary and unary operators, except for those that are allowed by the MISRA C++ Rule 4.5.1. The matcher uses the `bind` function to capture the matched nodes.
-
-The program defines a class called `OperatorPrinter` that inherits from the `MatchFinder::MatchCallback` class. The `OperatorPrinter` class overrides the `run` function, which is called when a match is found. The function retrieves the matched binary and unary operators, gets the location of the operator in the source code, and checks if either operand is of boolean type. If either operand is of boolean type, the function reports a custom error message using the `DiagnosticsEngine` class.
+The program defines a class called `OperatorPrinter` that inherits from the `misra::OperatorCheck` class. The rule adds it to a `misra::OperatorVisitor` for the binary operators other than those allowed by the MISRA C++ Rule 4.5.1 and for the unary operators other than & and !. The visitor walks the AST once for all the operator rules and calls `checkBinary` or `checkUnary` for each such operator, with the types of the operands already worked out. The check records a violation at the location of the operator if either operand, ignoring implicit casts, is of boolean type, and `endTranslationUnit` reports them using the `DiagnosticsEngine` class.
 
-Finally, the program defines an option category for the tool and creates a `CommonOptionsParser` object to parse command line arguments. It creates a `ClangTool` object and a `MatchFinder` object, adds the `OperatorMatcher` to the `MatchFinder`, and runs the tool using a frontend action factory and the `run` function.
+Finally, the program defines an option category for the tool and creates a `CommonOptionsParser` object to parse command line arguments. It creates a `ClangTool` object, a `MatchFinder` object and a `misra::OperatorVisitor` object, adds the checks of the rule to them, and runs the tool using `misra::newMisraCheckActionFactory`.
 */
@@ -6,6 +6,10 @@
 #include "clang/Tooling/Tooling.h"
 #include "llvm/Support/CommandLine.h"
 #include <vector>
+#include "MisraCheckAction.h"
+#include "MisraRule.h"
+#include "OperatorVisitor.h"
+#include "ViolationRecorder.h"
 
 // Use these namespaces to simplify code
 using namespace clang;
@@ -14,85 +18,73 @@ using namespace clang::tooling;
 using namespace llvm;
 using namespace std;
 
-StatementMatcher OperatorMatcher = anyOf(
-    binaryOperator(unless(anyOf(hasOperatorName("<"), hasOperatorName("<="),
-                                hasOperatorName(">"), hasOperatorName(">="),
-                                hasOperatorName("=="), hasOperatorName("!="),
-                                hasOperatorName("="), hasOperatorName("[]"))))
-        .bind("binaryoperator"),
-    unaryOperator(unless(hasOperatorName("&"))).bind("unaryoperator"));
+namespace {
 
-// Create a callback class for the match found by the matcher
-class OperatorPrinter : public MatchFinder::MatchCallback {
+// Create a check class for the operators given to it by the operator visitor
+class OperatorPrinter : public misra::OperatorCheck {
 public:
-  // Override the virtual run function to process the match result
-  virtual void run(const MatchFinder::MatchResult &Result) override {
-    // Get the matched binary operator node
-    const BinaryOperator *binOp =
-        Result.Nodes.getNodeAs<BinaryOperator>("binaryoperator");
-    // Get the matched unary operator node
-    const UnaryOperator *unOp =
-        Result.Nodes.getNodeAs<UnaryOperator>("unaryoperator");
-    // Get the location of the operator in the source code
-    SourceLocation loc;
-    if (binOp) {
-      loc = binOp->getOperatorLoc();
-      // Get the full location of the operator in the source code
-      FullSourceLoc fullLoc(loc, (Result.Context->getSourceManager()));
-      // Get the diagnostics engine to report errors
-      DiagnosticsEngine &DE = Result.Context->getDiagnostics();
-      // Get a custom error ID for MISRA C++ rule 4.5.2 violation
-      const unsigned ID = DE.getCustomDiagID(
-          clang::DiagnosticsEngine::Error,
-          "MISRA C++ Rule 4.5.2 Violation! Expressions with type enum shall "
-          "not be used as operands to built-in operators other than the "
-          "subscript operator [ ], the assignment operator =, the equality "
-          "operators == and !=, the unary & operator, and the relational "
-          "operators <, <=, >, >=.");
-      // Get the left-hand side and right-hand side of the operator and ignore
-      // implicit casts
-      auto *LHS = binOp ? binOp->getLHS()->IgnoreParenImpCasts() : nullptr;
-      auto *RHS = binOp ? binOp->getRHS()->IgnoreParenImpCasts() : nullptr;
-      // Check if both operands are of enumeration type
-      if (LHS && RHS && LHS->getType()->isEnumeralType() ||
-          RHS->getType()->isEnumeralType()) {
-        const EnumType *enumLHS = LHS->getType()->getAs<EnumType>();
-        const EnumType *enumRHS = RHS->getType()->getAs<EnumType>();
-        // Check if both operands are of the same enumeration type
-       // errs()<<"left enum "<<enumLHS->getDecl()<<" right enum "<<enumRHS->getDecl()<<"\n";
-       // if (enumLHS && enumRHS && enumLHS->getDecl() != enumRHS->getDecl()) {
-          // Report the MISRA C++ rule 4.5.2 violation
-          DE.Report(loc, ID);
-       // }
-      }
-     // DE.Report(loc, ID);
+  // Name of the rule in the --profile summary of misra-check
+  StringRef getID() const override { return "4.5.2"; }
+
+  // Check the binary operators other than <, <=, >, >=, ==, != and =
+  virtual void checkBinary(const BinaryOperator &binOp,
+                           const misra::OperandInfo &LHS,
+                           const misra::OperandInfo &RHS,
+                           ASTContext &Context) override {
+    // Check if either operand, ignoring implicit casts, is of enumeration
+    // type
+    if (LHS.WrittenIsEnum || RHS.WrittenIsEnum) {
+      // Record the MISRA C++ rule 4.5.2 violation
+      Violations.add(binOp.getOperatorLoc());
     }
+  }
 
-    if (unOp) {
-      loc = unOp->getOperatorLoc();
-      // Get the full location of the operator in the source code
-      FullSourceLoc fullLoc(loc, (Result.Context->getSourceManager()));
-      // Get the diagnostics engine to report errors
-      DiagnosticsEngine &DE = Result.Context->getDiagnostics();
-      // Get a custom error ID for MISRA C++ rule 4.5.2 violation
-      const unsigned ID = DE.getCustomDiagID(
-          clang::DiagnosticsEngine::Error,
-          "MISRA C++ Rule 4.5.2 Violation! Expressions with type enum shall "
-          "not be used as operands to built-in operators other than the "
-          "subscript operator [ ], the assignment operator =, the equality "
-          "operators == and !=, the unary & operator, and the relational "
-          "operators <, <=, >, >=.");
-      // Get the operand of the operator and ignore implicit casts
-      auto *operand = unOp->getSubExpr()->IgnoreParenImpCasts();
-      // Check if the operand is of enumeration type
-      if (operand && operand->getType()->isEnumeralType()) {
-        // Report the MISRA C++ rule 4.5.2 violation
-        DE.Report(loc, ID);
-      }
+  // Check the unary operators other than &
+  virtual void checkUnary(const UnaryOperator &unOp,
+                          const misra::OperandInfo &operand,
+                          ASTContext &Context) override {
+    // Check if the operand is of enumeration type
+    if (operand.WrittenIsEnum) {
+      // Record the MISRA C++ rule 4.5.2 violation
+      Violations.add(unOp.getOperatorLoc());
     }
   }
+
+  // Report the violations found in the translation unit
+  virtual void endTranslationUnit(ASTContext &Context) override {
+    Violations.report(Context.getDiagnostics(), Context.getSourceManager());
+  }
+
+private:
+  misra::ViolationRecorder Violations{
+      "MISRA C++ Rule 4.5.2 Violation! Expressions with type enum shall not be "
+      "used as operands to built-in operators other than the subscript "
+      "operator [ ], the assignment operator =, the equality operators == and "
+      "!=, the unary & operator, and the relational operators <, <=, >, >=."};
 };
 
+// The rule as registered in the misra-check driver
+class Rule4_5_2 : public misra::ASTRule {
+public:
+  void registerOperatorChecks(misra::OperatorVisitor &Visitor) override {
+    // The built-in subscript operator is an ArraySubscriptExpr, not a
+    // binary operator
+    Visitor.addBinaryCheckExcept(
+        {BO_LT, BO_LE, BO_GT, BO_GE, BO_EQ, BO_NE, BO_Assign}, &printer);
+    Visitor.addUnaryCheckExcept({UO_AddrOf}, &printer);
+  }
+
+private:
+  OperatorPrinter printer;
+};
+
+} // namespace
+
+std::unique_ptr<misra::ASTRule> misra::createRule4_5_2() {
+  return std::make_unique<Rule4_5_2>();
+}
+
+#ifndef MISRA_CHECK_DRIVER
 // Create an option category for the tool
 static llvm::cl::OptionCategory MyToolCategory("my-tool options");
 
@@ -108,21 +100,26 @@ int main(int argc, const char **argv) {
   ClangTool Tool(OptionsParser.getCompilations(),
                  OptionsParser.getSourcePathList());
 
-  OperatorPrinter printer;
+  auto Rule = misra::createRule4_5_2();
   MatchFinder finder;
-  finder.addMatcher(OperatorMatcher, &printer);
+  misra::OperatorVisitor Operators;
+  Rule->registerMatchers(finder);
+  Rule->registerOperatorChecks(Operators);
 
-  return Tool.run(newFrontendActionFactory(&finder).get());
+  return Tool.run(misra::newMisraCheckActionFactory(finder, Operators,
+                                                    Rule.get(), None)
+                      .get());
 }
+#endif // MISRA_CHECK_DRIVER
 
                             //DOCUMENTATION
 
 /*
 This is a C++ program that uses the Clang AST Matchers library to match and print occurrences of binary and unary operators that violate the MISRA C++ Rule 4.5.2, which states that expressions with type enum shall not be used as operands to built-in operators other than the subscript operator [ ], the assignment operator =, the equality operators == and !=, the unary & operator, and the relational operators <, <=, >, >=.
 
-The program includes necessary header files for the Clang AST Matchers library and other required dependencies. It defines a statement matcher called OperatorMatcher, which uses the anyOf function to match binary and unary operators that violate the MISRA C++ Rule 4.5.2. The binaryOperator and unaryOperator functions are used to match binary and unary operators, respectively. The unless function is used to exclude operators that are allowed by the rule.
+The program includes necessary header files for the Clang AST Matchers library and other required dependencies. It defines a check class called OperatorPrinter, which inherits from the misra::OperatorCheck class. The rule adds it to a misra::OperatorVisitor for every binary operator except those allowed by the MISRA C++ Rule 4.5.2, and for every unary operator except &. The built-in subscript operator is not a binary operator in the AST, so it is never checked.
 
-The program then defines a callback class called OperatorPrinter, which inherits from the MatchFinder::MatchCallback class. The OperatorPrinter class overrides the virtual run function to process the match result. The run function gets the matched binary or unary operator node, gets the location of the operator in the source code, and checks if the operands of the operator are of enumeration type. If the operands are of enumeration type and the operator violates the MISRA C++ Rule 4.5.2, the program reports a custom error message using the DiagnosticsEngine object.
+The visitor walks the AST once for all the operator rules and calls checkBinary or checkUnary for each such operator. The check records a violation at the location of the operator if an operand, ignoring implicit casts, is of enumeration type, and endTranslationUnit reports them with a custom error message using the DiagnosticsEngine object.
 
-Finally, the program creates an option category for the tool and uses the CommonOptionsParser class to parse command line arguments. The ClangTool object is created using the parsed command line arguments and is run with the matchers and callbacks defined earlier. If there are any errors parsing the command line arguments, the program will fail gracefully and report the error.
+Finally, the program creates an option category for the tool and uses the CommonOptionsParser class to parse command line arguments. The ClangTool object is created using the parsed command line arguments and is run with misra::newMisraCheckActionFactory and the checks defined earlier. If there are any errors parsing the command line arguments, the program will fail gracefully and report the error.
 */
\ No newline at end of file
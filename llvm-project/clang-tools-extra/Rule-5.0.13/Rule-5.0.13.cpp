@@ -7,6 +7,11 @@
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include <vector>
 #include "clang/AST/ASTContext.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "MisraCheckAction.h"
+#include "MisraRule.h"
+#include "OperatorVisitor.h"
+#include "ViolationRecorder.h"
 
 // Use these namespaces to simplify code
 using namespace clang;
@@ -15,102 +20,200 @@ using namespace clang::tooling;
 using namespace llvm;
 using namespace std;
 
-// Create a matcher to match casts from integral types to boolean
+namespace {
+
+// Find the casts from integral types to boolean that are the condition of an
+// if, while, for or do statement, in one top-down traversal. A cast is not
+// reported if an if or while statement around it, its own included, declares
+// a variable anywhere inside it. Whether a statement declares a variable is
+// only known once all of it has been visited, so the casts found inside an if
+// or while statement are kept until its end and dropped if it declared one.
+// Each cast is kept once and each node visited once, however deep the
+// statements are nested, and no parent map is needed.
+class ConditionChecker : public RecursiveASTVisitor<ConditionChecker> {
+public:
+  explicit ConditionChecker(misra::ViolationRecorder &Violations)
+      : Violations(Violations) {}
+
+  // Like the matchers, look into template instantiations and implicit code
+  bool shouldVisitTemplateInstantiations() const { return true; }
+  bool shouldVisitImplicitCode() const { return true; }
+
+  // These overrides have no data recursion queue, so the children of the
+  // statement are traversed before they return
+  bool TraverseIfStmt(IfStmt *S) {
+    pushStatement();
+    bool Result = RecursiveASTVisitor::TraverseIfStmt(S);
+    popStatement();
+    return Result;
+  }
 
-StatementMatcher IntegralToBoolCastMatcher = implicitCastExpr(
-    hasCastKind(CK_IntegralToBoolean),
-    hasParent(stmt(anyOf(ifStmt(), whileStmt(), forStmt()))),
-    unless(anyOf(
-            hasAncestor(ifStmt(hasDescendant(varDecl().bind("varDecl")))),
-            hasAncestor(whileStmt(hasDescendant(varDecl().bind("varDecl"))))
-        ))
-    ).bind("integralToBoolCast");
+  bool TraverseWhileStmt(WhileStmt *S) {
+    pushStatement();
+    bool Result = RecursiveASTVisitor::TraverseWhileStmt(S);
+    popStatement();
+    return Result;
+  }
 
+  bool VisitIfStmt(IfStmt *S) {
+    checkCondition(S->getCond());
+    return true;
+  }
 
-// Create a callback class for the match found by the matcher
-class IntegralToBoolCastPrinter : public MatchFinder::MatchCallback {
-public:
-  // Override the virtual run function to process the match result
-  virtual void run(const MatchFinder::MatchResult &Result) override {
-    // Get the matched cast expression node
-    const ImplicitCastExpr *castExpr = Result.Nodes.getNodeAs<ImplicitCastExpr>("integralToBoolCast");
-    // Get the matched unary operator node
-    // Get the location of the cast in the source code
-    SourceLocation loc = castExpr->getBeginLoc();
-    // Get the full location of the cast in the source code
-    FullSourceLoc fullLoc(loc, (Result.Context->getSourceManager()));
-    // Get the diagnostics engine to report errors
-    DiagnosticsEngine &DE = Result.Context->getDiagnostics();
-    // Get a custom error ID for the integral to boolean violation
-    const unsigned ID = DE.getCustomDiagID(
-        clang::DiagnosticsEngine::Error,
-        "MISRA C++ Rule 5.0.13 Violation! The condition of an if-statement and the condition of an iteration-statement shall have type bool.");
-
-    // Report the integral to boolean violation
-    DE.Report(loc, ID);
+  bool VisitWhileStmt(WhileStmt *S) {
+    checkCondition(S->getCond());
+    return true;
+  }
+
+  bool VisitForStmt(ForStmt *S) {
+    checkCondition(S->getCond());
+    return true;
+  }
+
+  bool VisitDoStmt(DoStmt *S) {
+    checkCondition(S->getCond());
+    return true;
   }
+
+  // Also called for the parameters of the lambdas and of the functions of
+  // local classes, which are variables of the statement too
+  bool VisitVarDecl(VarDecl *D) {
+    if (!Statements.empty())
+      Statements.back().DeclaresVariable = true;
+    return true;
+  }
+
+private:
+  // An if or while statement being traversed
+  struct Statement {
+    // The first of the casts kept for it in Casts
+    size_t FirstCast;
+    bool DeclaresVariable;
+  };
+
+  void pushStatement() { Statements.push_back({Casts.size(), false}); }
+
+  void popStatement() {
+    Statement Done = Statements.back();
+    Statements.pop_back();
+    if (Done.DeclaresVariable) {
+      // The casts inside the statement are exempt, and so are those in the
+      // statements around it, which contain the variable as well
+      Casts.resize(Done.FirstCast);
+      if (!Statements.empty())
+        Statements.back().DeclaresVariable = true;
+    } else if (Statements.empty()) {
+      // No statement around the casts declares a variable
+      for (SourceLocation Loc : Casts)
+        Violations.add(Loc);
+      Casts.clear();
+    }
+  }
+
+  void checkCondition(const Expr *Cond) {
+    const auto *castExpr = dyn_cast_or_null<ImplicitCastExpr>(Cond);
+    if (!castExpr || castExpr->getCastKind() != CK_IntegralToBoolean)
+      return;
+    // Record the integral to boolean violation, or keep it until the if and
+    // while statements around it are done
+    if (Statements.empty())
+      Violations.add(castExpr->getBeginLoc());
+    else
+      Casts.push_back(castExpr->getBeginLoc());
+  }
+
+  misra::ViolationRecorder &Violations;
+  std::vector<Statement> Statements;
+  // The casts inside the if and while statements being traversed, in the
+  // order they were found
+  std::vector<SourceLocation> Casts;
 };
 
-StatementMatcher OperatorMatcher = anyOf(
-    binaryOperator(anyOf(
-                                hasOperatorName("||"), hasOperatorName("&&")
-                                ))
-        .bind("binaryoperator"),
-    unaryOperator(((hasOperatorName("&"),hasOperatorName("!")))).bind("unaryoperator"));
+// Create a consumer class which runs the condition checker on the translation
+// unit
+class ConditionConsumer : public ASTConsumer {
+public:
+  explicit ConditionConsumer(misra::ViolationRecorder &Violations)
+      : Violations(Violations) {}
+
+  void HandleTranslationUnit(ASTContext &Context) override {
+    // TraverseAST only traverses the traversal scope of the context
+    ConditionChecker(Violations).TraverseAST(Context);
+    // Report the violations found in the translation unit
+    Violations.report(Context.getDiagnostics(), Context.getSourceManager());
+  }
+
+private:
+  misra::ViolationRecorder &Violations;
+};
 
-// Create a callback class for the match found by the matcher
-class OperatorPrinter : public MatchFinder::MatchCallback {
+// Create a check class for the operators given to it by the operator visitor
+class OperatorPrinter : public misra::OperatorCheck {
 public:
-  // Override the virtual run function to process the match result
-  virtual void run(const MatchFinder::MatchResult &Result) override {
-    // Get the matched binary operator node
-    const BinaryOperator *binOp =
-        Result.Nodes.getNodeAs<BinaryOperator>("binaryoperator");
-    // Get the matched unary operator node
-    const UnaryOperator *unOp =
-        Result.Nodes.getNodeAs<UnaryOperator>("unaryoperator");
-    // Get the location of the operator in the source code
-    SourceLocation loc;
-    if (binOp) {
-      loc = binOp->getOperatorLoc();
-      // Get the full location of the operator in the source code
-      FullSourceLoc fullLoc(loc, (Result.Context->getSourceManager()));
-      // Get the diagnostics engine to report errors
-      DiagnosticsEngine &DE = Result.Context->getDiagnostics();
-      // Get a custom error ID for the violation
-      const unsigned ID = DE.getCustomDiagID(
-          clang::DiagnosticsEngine::Error,
-"MISRA C++ Rule 5.0.13 Violation! The condition of an if-statement and the condition of an iteration-statement shall have type bool.");      // Get the left-hand side and right-hand side of the operator and ignore
-      // implicit casts
-      auto *LHS = binOp ? binOp->getLHS()->IgnoreParenImpCasts() : nullptr;
-      auto *RHS = binOp ? binOp->getRHS()->IgnoreParenImpCasts() : nullptr;
-      // Check if either operands is of boolean type
-      if (LHS && RHS && !(LHS->getType()->isBooleanType() && RHS->getType()->isBooleanType())) {
-        // Report the violation
-        DE.Report(loc, ID);
-      }
+  // Name of the rule in the --profile summary of misra-check
+  StringRef getID() const override { return "5.0.13"; }
+
+  // Check the operators || and &&
+  virtual void checkBinary(const BinaryOperator &binOp,
+                           const misra::OperandInfo &LHS,
+                           const misra::OperandInfo &RHS,
+                           ASTContext &Context) override {
+    // Check if either operand, ignoring implicit casts, is not of boolean
+    // type
+    if (!(LHS.WrittenIsBool && RHS.WrittenIsBool)) {
+      // Record the violation
+      Violations.add(binOp.getOperatorLoc());
     }
+  }
 
-    if (unOp) {
-      loc = unOp->getOperatorLoc();
-      // Get the full location of the operator in the source code
-      FullSourceLoc fullLoc(loc, (Result.Context->getSourceManager()));
-      // Get the diagnostics engine to report errors
-      DiagnosticsEngine &DE = Result.Context->getDiagnostics();
-      // Get a custom error ID for the violation
-      const unsigned ID = DE.getCustomDiagID(
-          clang::DiagnosticsEngine::Error,
-"MISRA C++ Rule 5.0.13 Violation! The condition of an if-statement and the condition of an iteration-statement shall have type bool.");      // Get the left-hand side and right-hand side of the operator and ignore
-          auto *operand = unOp->getSubExpr()->IgnoreParenImpCasts();
-      // Check if the operand is of boolean type
-      if (operand && !operand->getType()->isBooleanType()) {
-        // Report the MISRA C++ rule 4.5.1 violation
-        DE.Report(loc, ID);
-      }
+  // Check the operator !
+  virtual void checkUnary(const UnaryOperator &unOp,
+                          const misra::OperandInfo &operand,
+                          ASTContext &Context) override {
+    // Check if the operand is not of boolean type
+    if (!operand.WrittenIsBool) {
+      // Record the MISRA C++ rule 5.0.13 violation
+      Violations.add(unOp.getOperatorLoc());
     }
   }
+
+  // Report the violations found in the translation unit
+  virtual void endTranslationUnit(ASTContext &Context) override {
+    Violations.report(Context.getDiagnostics(), Context.getSourceManager());
+  }
+
+private:
+  misra::ViolationRecorder Violations{
+      "MISRA C++ Rule 5.0.13 Violation! The condition of an if-statement and "
+      "the condition of an iteration-statement shall have type bool."};
 };
 
+// The rule as registered in the misra-check driver
+class Rule5_0_13 : public misra::ASTRule {
+public:
+  void registerOperatorChecks(misra::OperatorVisitor &Visitor) override {
+    Visitor.addBinaryCheck({BO_LOr, BO_LAnd}, &Printer);
+    Visitor.addUnaryCheck({UO_LNot}, &Printer);
+  }
+
+  std::unique_ptr<ASTConsumer> newASTConsumer() override {
+    return std::make_unique<ConditionConsumer>(Conditions);
+  }
+
+private:
+  misra::ViolationRecorder Conditions{
+      "MISRA C++ Rule 5.0.13 Violation! The condition of an if-statement and "
+      "the condition of an iteration-statement shall have type bool."};
+  OperatorPrinter Printer;
+};
+
+} // namespace
+
+std::unique_ptr<misra::ASTRule> misra::createRule5_0_13() {
+  return std::make_unique<Rule5_0_13>();
+}
+
+#ifndef MISRA_CHECK_DRIVER
 // Create an option category for the tool
 static llvm::cl::OptionCategory MyToolCategory("my-tool options");
 
@@ -127,22 +230,25 @@ int main(int argc, const char **argv) {
   ClangTool Tool(OptionsParser.getCompilations(),
                  OptionsParser.getSourcePathList());
 
-  IntegralToBoolCastPrinter Printer1;
-  OperatorPrinter Printer2;
+  auto Rule = misra::createRule5_0_13();
   MatchFinder Finder;
-  Finder.addMatcher(IntegralToBoolCastMatcher, &Printer1);
-  Finder.addMatcher(OperatorMatcher,&Printer2);
+  misra::OperatorVisitor Operators;
+  Rule->registerMatchers(Finder);
+  Rule->registerOperatorChecks(Operators);
 
-  return Tool.run(newFrontendActionFactory(&Finder).get());
+  return Tool.run(misra::newMisraCheckActionFactory(Finder, Operators,
+                                                    Rule.get(), None)
+                      .get());
 
 }
+#endif // MISRA_CHECK_DRIVER
                               //DOCUMENTATION
 /*
-This code is a C++ tool that uses the Clang library to enforce MISRA C++ rules, specifically Rule 5.0.13. The code includes necessary header files for Clang, as well as the necessary namespaces. The tool defines two matchers using the AST matchers API to find violations of Rule 5.0.13.
+This code is a C++ tool that uses the Clang library to enforce MISRA C++ rules, specifically Rule 5.0.13. The code includes necessary header files for Clang, as well as the necessary namespaces. The tool finds violations of Rule 5.0.13 with a condition checker and a check of the operators.
 
-The first matcher is called IntegralToBoolCastMatcher and matches implicit casts from integral types to boolean types. The matcher searches for these casts in the condition of an if-statement or an iteration statement (for, while, do-while loops) but excludes cases where the condition is a declaration or initialization statement. If a match is found, a callback function called IntegralToBoolCastPrinter is invoked to report the violation. The function extracts the location of the cast and creates a custom error message using the DiagnosticsEngine.
+The condition checker is called ConditionChecker and finds implicit casts from integral types to boolean types that are the condition of an if-statement or an iteration statement (for, while, do-while loops), but excludes cases where an enclosing if-statement or while-statement, including the one of the condition, declares a variable, e.g. when the condition is a declaration. It is a RecursiveASTVisitor which the rule runs from its own ASTConsumer, so it walks the AST once from the top. Whether an if-statement or while-statement declares a variable is only known at its end, so the casts found inside it are kept in a list until then: they are dropped if it declared one, and recorded once no enclosing if-statement or while-statement is left. Each cast is kept once and each node is visited once, so the time grows linearly with the size of the function, however deeply the statements are nested. The earlier version used an AST matcher with hasParent and hasAncestor(ifStmt(hasDescendant(varDecl()))), which built the parent map of the AST and searched the whole subtree of every enclosing statement again for every cast. misra-bench-5.0.13 measures the checker on deeply nested control flow.
 
-The second matcher is called OperatorMatcher and matches binary or unary operators that are used in the condition of an if-statement or an iteration statement. The matcher checks if either operand is not of boolean type and reports the violation if it is found. If a match is found, a callback function called OperatorPrinter is invoked to report the violation. The function extracts the location of the operator and creates a custom error message using the DiagnosticsEngine.
+The check of the operators is called OperatorPrinter and is added to a misra::OperatorVisitor, which walks the AST once for all the operator rules, for the operators ||, && and !. It checks if an operand, ignoring implicit casts, is not of boolean type and records the violation at the location of the operator if it is. At the end of the translation unit the violations are reported with a custom error message using the DiagnosticsEngine.
 
 The code also defines an option category for the tool.
 */
@@ -7,6 +7,8 @@
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include <vector>
 #include "clang/AST/ASTContext.h"
+#include "MisraRule.h"
+#include "ViolationRecorder.h"
 
 // Use these namespaces to simplify code
 using namespace clang;
@@ -15,6 +17,8 @@ using namespace clang::tooling;
 using namespace llvm;
 using namespace std;
 
+namespace {
+
 // Create a matcher to match the ternary conditional operator with the first operand as bool
 StatementMatcher BoolTernaryMatcher = conditionalOperator(
     hasCondition(ignoringParenImpCasts(declRefExpr(
@@ -26,26 +30,56 @@ StatementMatcher BoolTernaryMatcher = conditionalOperator(
 // Create a callback class for the match found by the matcher
 class BoolTernaryPrinter : public MatchFinder::MatchCallback {
 public:
+  // Name of the rule in the --profile summary of misra-check
+  StringRef getID() const override { return "5.0.14"; }
+
   // Override the virtual run function to process the match result
   virtual void run(const MatchFinder::MatchResult &Result) override {
+    // Keep the context for the report at the end of the translation unit
+    Context = Result.Context;
     // Get the matched ternary statement node
     const ConditionalOperator *ternaryStmt = Result.Nodes.getNodeAs<ConditionalOperator>("ternaryStmt");
     // Get the location of the ternary statement in the source code
     SourceLocation loc = ternaryStmt->getBeginLoc();
-    // Get the full location of the ternary statement in the source code
-    FullSourceLoc fullLoc(loc, (Result.Context->getSourceManager()));
-    // Get the diagnostics engine to report errors
-    DiagnosticsEngine &DE = Result.Context->getDiagnostics();
-    // Get a custom error ID for the violation
-    const unsigned ID = DE.getCustomDiagID(
-        clang::DiagnosticsEngine::Error,
-        "MISRA C++ Rule 5.0.14 Violation! The first operand of a conditional-operator shall have type bool.");
-
-    // Report the violation
-    DE.Report(loc, ID);
+
+    // Record the violation
+    Violations.add(loc);
+  }
+
+  // Report the violations found in the translation unit
+  virtual void onEndOfTranslationUnit() override {
+    if (Context)
+      Violations.report(Context->getDiagnostics(),
+                        Context->getSourceManager());
+    Context = nullptr;
+  }
+
+private:
+  // Context of the matches, for the report
+  ASTContext *Context = nullptr;
+  misra::ViolationRecorder Violations{
+      "MISRA C++ Rule 5.0.14 Violation! The first operand of a "
+      "conditional-operator shall have type bool."};
+};
+
+// The rule as registered in the misra-check driver
+class Rule5_0_14 : public misra::ASTRule {
+public:
+  void registerMatchers(MatchFinder &Finder) override {
+    Finder.addMatcher(BoolTernaryMatcher, &Printer);
   }
+
+private:
+  BoolTernaryPrinter Printer;
 };
 
+} // namespace
+
+std::unique_ptr<misra::ASTRule> misra::createRule5_0_14() {
+  return std::make_unique<Rule5_0_14>();
+}
+
+#ifndef MISRA_CHECK_DRIVER
 // Create an option category for the tool
 static llvm::cl::OptionCategory MyToolCategory("my-tool options");
 
@@ -62,12 +96,13 @@ int main(int argc, const char **argv) {
   ClangTool Tool(OptionsParser.getCompilations(),
                  OptionsParser.getSourcePathList());
 
-  BoolTernaryPrinter Printer;
+  auto Rule = misra::createRule5_0_14();
   MatchFinder Finder;
-  Finder.addMatcher(BoolTernaryMatcher, &Printer);
+  Rule->registerMatchers(Finder);
 
   return Tool.run(newFrontendActionFactory(&Finder).get());
 }
+#endif // MISRA_CHECK_DRIVER
                                       //DOCUMENTATION
 /*
 This is a C++ tool that uses the Clang library to detect violations of the MISRA C++ Rule 5.0.14, which states that the first operand of a conditional operator (ternary operator) shall have type bool.
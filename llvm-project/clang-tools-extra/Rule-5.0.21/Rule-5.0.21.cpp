@@ -6,6 +6,10 @@
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include <vector>
 #include "clang/AST/ASTContext.h"
+#include "MisraCheckAction.h"
+#include "MisraRule.h"
+#include "OperatorVisitor.h"
+#include "ViolationRecorder.h"
 
 using namespace clang;
 using namespace clang::ast_matchers;
@@ -13,6 +17,8 @@ using namespace clang::tooling;
 using namespace llvm;
 using namespace std;
 
+namespace {
+
 // StatementMatcher BitwiseOpMatcher = anyOf(
 //     binaryOperator(
 //         anyOf(hasOperatorName("|"), hasOperatorName("&"), hasOperatorName("^"), 
@@ -29,50 +35,64 @@ using namespace std;
 //     ).bind("unaryBitwiseOp")
 // );
 
-StatementMatcher BitwiseOpMatcher = anyOf(
-    binaryOperator(
-        anyOf(hasOperatorName("|"), hasOperatorName("&"), hasOperatorName("^"), 
-              hasOperatorName("<<"), hasOperatorName(">>"), hasOperatorName("|="),
-              hasOperatorName("&="), hasOperatorName("^="), hasOperatorName(">>="),
-              hasOperatorName("<<=")),
-        hasEitherOperand(hasType(isSignedInteger())),
-        hasEitherOperand(unless(hasType(isUnsignedInteger()))),
-        unless(hasType(isUnsignedInteger()))
-    ).bind("binaryBitwiseOp"),
-    unaryOperator(
-        hasOperatorName("~"),
-        hasUnaryOperand(hasType(isSignedInteger())),
-        unless(hasType(isUnsignedInteger()))
-    ).bind("unaryBitwiseOp")
-);
-
-
-class BitwiseOpChecker : public MatchFinder::MatchCallback {
+class BitwiseOpChecker : public misra::OperatorCheck {
+public:
+  // Name of the rule in the --profile summary of misra-check
+  StringRef getID() const override { return "5.0.21"; }
+
+  // Check the bitwise and shift operators, and their compound assignments
+  virtual void checkBinary(const BinaryOperator &bitwiseOp,
+                           const misra::OperandInfo &LHS,
+                           const misra::OperandInfo &RHS,
+                           ASTContext &Context) override {
+    if ((LHS.IsSignedInteger || RHS.IsSignedInteger) &&
+        (!LHS.IsUnsignedInteger || !RHS.IsUnsignedInteger) &&
+        !bitwiseOp.getType()->isUnsignedIntegerType())
+      Violations.add(bitwiseOp.getBeginLoc());
+  }
+
+  // Check the operator ~
+  virtual void checkUnary(const UnaryOperator &bitwiseOp,
+                          const misra::OperandInfo &operand,
+                          ASTContext &Context) override {
+    if (operand.IsSignedInteger &&
+        !bitwiseOp.getType()->isUnsignedIntegerType())
+      Violations.add(bitwiseOp.getBeginLoc());
+  }
+
+  // Report the violations found in the translation unit
+  virtual void endTranslationUnit(ASTContext &Context) override {
+    Violations.report(Context.getDiagnostics(), Context.getSourceManager());
+  }
+
+private:
+  misra::ViolationRecorder Violations{
+      "MISRA C++ Rule 5.0.21 Violation! Bitwise operator applied to operands "
+      "of non-unsigned underlying type"};
+};
+
+// The rule as registered in the misra-check driver
+class Rule5_0_21 : public misra::ASTRule {
 public:
-  virtual void run(const MatchFinder::MatchResult &Result) override {
-    if (const BinaryOperator *bitwiseOp = Result.Nodes.getNodeAs<BinaryOperator>("binaryBitwiseOp")) {
-        SourceLocation loc = bitwiseOp->getBeginLoc();
-        FullSourceLoc fullLoc(loc, (Result.Context->getSourceManager()));
-        DiagnosticsEngine &DE = Result.Context->getDiagnostics();
-        const unsigned ID = DE.getCustomDiagID(
-            clang::DiagnosticsEngine::Error,
-            "MISRA C++ Rule 5.0.21 Violation! Bitwise operator applied to operands of non-unsigned underlying type");
-
-        DE.Report(loc, ID);
-    }
-    if (const UnaryOperator *bitwiseOp = Result.Nodes.getNodeAs<UnaryOperator>("unaryBitwiseOp")) {
-        SourceLocation loc = bitwiseOp->getBeginLoc();
-        FullSourceLoc fullLoc(loc, (Result.Context->getSourceManager()));
-        DiagnosticsEngine &DE = Result.Context->getDiagnostics();
-        const unsigned ID = DE.getCustomDiagID(
-            clang::DiagnosticsEngine::Error,
-            "MISRA C++ Rule 5.0.21 Violation! Bitwise operator applied to operands of non-unsigned underlying type");
-
-        DE.Report(loc, ID);
-    }
+  void registerOperatorChecks(misra::OperatorVisitor &Visitor) override {
+    Visitor.addBinaryCheck({BO_Or, BO_And, BO_Xor, BO_Shl, BO_Shr, BO_OrAssign,
+                            BO_AndAssign, BO_XorAssign, BO_ShrAssign,
+                            BO_ShlAssign},
+                           &Checker);
+    Visitor.addUnaryCheck({UO_Not}, &Checker);
   }
+
+private:
+  BitwiseOpChecker Checker;
 };
 
+} // namespace
+
+std::unique_ptr<misra::ASTRule> misra::createRule5_0_21() {
+  return std::make_unique<Rule5_0_21>();
+}
+
+#ifndef MISRA_CHECK_DRIVER
 static llvm::cl::OptionCategory MyToolCategory("my-tool options");
 
 int main(int argc, const char **argv) {
@@ -85,12 +105,17 @@ int main(int argc, const char **argv) {
   ClangTool Tool(OptionsParser.getCompilations(),
                  OptionsParser.getSourcePathList());
 
-  BitwiseOpChecker Checker;
+  auto Rule = misra::createRule5_0_21();
   MatchFinder Finder;
-  Finder.addMatcher(BitwiseOpMatcher, &Checker);
+  misra::OperatorVisitor Operators;
+  Rule->registerMatchers(Finder);
+  Rule->registerOperatorChecks(Operators);
 
-  return Tool.run(newFrontendActionFactory(&Finder).get());
+  return Tool.run(misra::newMisraCheckActionFactory(Finder, Operators,
+                                                    Rule.get(), None)
+                      .get());
 }
+#endif // MISRA_CHECK_DRIVER
                                         //DOCUMENTATION
 /*
 This code is a C++ program that uses the Clang AST Matcher library to detect violations of MISRA C++ Rule 5.0.21, which prohibits applying bitwise operators to operands of non-unsigned underlying type.
@@ -99,17 +124,13 @@ The code starts by including several header files, including those for the Clang
 
 The `using` statements at the beginning of the code declare several namespaces that will be used throughout the code, including `clang`, `clang::ast_matchers`, `clang::tooling`, and `llvm`.
 
-Next, a `StatementMatcher` object called `BitwiseOpMatcher` is defined. This matcher is used to match expressions that use bitwise operators, including `|`, `&`, `^`, `<<`, `>>`, `|=`, `&=`, `^=`, `>>=`, and `<<=`. The matcher includes two sub-matchers: one for binary operators and one for unary operators.
-
-The `BinaryOperator` matcher matches binary operators that have one of the specified operator names, at least one operand that has a signed integer type, and at least one operand that is not an unsigned integer type.
-
-The `UnaryOperator` matcher matches unary operators that have the `~` operator name, an operand that has a signed integer type, and an operand that is not an unsigned integer type.
+Next, a class called `BitwiseOpChecker` is defined. This class inherits from `misra::OperatorCheck`, and the rule adds it to a `misra::OperatorVisitor` for the bitwise operators `|`, `&`, `^`, `<<`, `>>`, `|=`, `&=`, `^=`, `>>=`, `<<=` and `~`. The visitor walks the AST once for all the operator rules and calls the check for each of these operators, with the types of the operands already worked out.
 
-After the matcher is defined, a class called `BitwiseOpChecker` is defined. This class inherits from `MatchFinder::MatchCallback`, which is a base class for objects that can be registered with a `MatchFinder` object to be called when a match is found. The `BitwiseOpChecker` class overrides the `run` method of the `MatchCallback` class to perform actions when a match is found.
+`checkBinary` records a violation for a binary operator that has at least one operand of signed integer type and at least one operand that is not of unsigned integer type, unless the type of the operator itself is unsigned.
 
-In particular, if a match is found for the `binaryBitwiseOp` or `unaryBitwiseOp` node in the AST, the `run` method retrieves the source location of the match and creates a diagnostic message using the Clang `DiagnosticsEngine` object. The diagnostic message includes a custom error code and a message that explains the violation of MISRA C++ Rule 5.0.21.
+`checkUnary` records a violation for a `~` operator whose operand has a signed integer type, unless the type of the operator itself is unsigned.
 
-Finally, the `main` function sets up the Clang tool by creating a `CommonOptionsParser` object, creating a `ClangTool` object, creating a `BitwiseOpChecker` object, creating a `MatchFinder` object, adding the `BitwiseOpMatcher` to the `MatchFinder`, and running the `ClangTool` with the `MatchFinder` as a frontend action.
+The violations are recorded at the start of the operator and reported at the end of the translation unit with the Clang `DiagnosticsEngine` object. The diagnostic message includes a custom error code and a message that explains the violation of MISRA C++ Rule 5.0.21.
 
-Overall, this code is an example of using the Clang AST Matcher library to detect violations of a coding standard rule, in this case MISRA C++ Rule 5.0.21. It demonstrates how to define a matcher for specific types of AST nodes, how to create a custom `MatchCallback` object to perform actions when matches are found, and how to use the Clang `DiagnosticsEngine` object to create custom diagnostic messages.
+Finally, the `main` function sets up the Clang tool by creating a `CommonOptionsParser` object, creating a `ClangTool` object, creating a `MatchFinder` and a `misra::OperatorVisitor` object, adding the checks of the rule to them, and running the `ClangTool` with `misra::newMisraCheckActionFactory`.
 */
\ No newline at end of file
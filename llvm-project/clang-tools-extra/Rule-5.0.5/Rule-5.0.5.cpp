@@ -7,6 +7,8 @@
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include <vector>
 #include "clang/AST/ASTContext.h"
+#include "MisraRule.h"
+#include "ViolationRecorder.h"
 
 // Use these namespaces to simplify code
 using namespace clang;
@@ -15,6 +17,8 @@ using namespace clang::tooling;
 using namespace llvm;
 using namespace std;
 
+namespace {
+
 // Create a matcher to match float to int casts downcast not allowed
 StatementMatcher FloatToIntCastMatcher =
     castExpr(hasCastKind(CK_FloatingToIntegral))
@@ -30,8 +34,13 @@ StatementMatcher IntToFloatCastMatcher =
 // Create a callback class for the match found by the matcher
 class CastPrinter : public MatchFinder::MatchCallback {
 public:
+  // Name of the rule in the --profile summary of misra-check
+  StringRef getID() const override { return "5.0.5"; }
+
   // Override the virtual run function to process the match result
   virtual void run(const MatchFinder::MatchResult &Result) override {
+    // Keep the context for the report at the end of the translation unit
+    Context = Result.Context;
     // Get the matched cast expression node
     const CastExpr *castExpr = nullptr;
     if (const auto *FloatToIntCast = Result.Nodes.getNodeAs<CastExpr>("floattointcast")) {
@@ -46,28 +55,54 @@ public:
 
     // Get the location of the cast in the source code
     SourceLocation loc = castExpr->getBeginLoc();
-    // Get the full location of the cast in the source code
-    FullSourceLoc fullLoc(loc,(Result.Context->getSourceManager()));
-    // Get the diagnostics engine to report errors
-    DiagnosticsEngine &DE = Result.Context->getDiagnostics();
 
     if (castExpr->getCastKind() == CK_FloatingToIntegral) {
-        // Get a custom error ID for the cast from float to int violation
-        const unsigned ID = DE.getCustomDiagID(
-            clang::DiagnosticsEngine::Error,
-            "MISRA C++ Rule 5.0.5 Violation! There shall be no implicit floating-integral conversions.");
-        // Report the cast from float to int violation
-        DE.Report(loc, ID);
+        // Record the cast from float to int violation
+        Violations.add(loc, 0);
     } else if (castExpr->getCastKind() == CK_IntegralToFloating) {
-        // Get a custom error ID for the cast from int to float violation
-        const unsigned ID = DE.getCustomDiagID(
-            clang::DiagnosticsEngine::Error,
-            "MISRA C++ Rule 5.0.5 Violation! There shall be no floating-integral conversions.");
-        // Report the cast from int to float violation
-        DE.Report(loc, ID);
+        // Record the cast from int to float violation
+        Violations.add(loc, 1);
     }
   }
+
+  // Report the violations found in the translation unit
+  virtual void onEndOfTranslationUnit() override {
+    if (Context)
+      Violations.report(Context->getDiagnostics(),
+                        Context->getSourceManager());
+    Context = nullptr;
+  }
+
+private:
+  // Context of the matches, for the report
+  ASTContext *Context = nullptr;
+  // One message for each kind of cast
+  misra::ViolationRecorder Violations{
+      "MISRA C++ Rule 5.0.5 Violation! There shall be no implicit "
+      "floating-integral conversions.",
+      "MISRA C++ Rule 5.0.5 Violation! There shall be no floating-integral "
+      "conversions."};
 };
+
+// The rule as registered in the misra-check driver
+class Rule5_0_5 : public misra::ASTRule {
+public:
+  void registerMatchers(MatchFinder &Finder) override {
+    Finder.addMatcher(FloatToIntCastMatcher, &Printer);
+    Finder.addMatcher(IntToFloatCastMatcher, &Printer);
+  }
+
+private:
+  CastPrinter Printer;
+};
+
+} // namespace
+
+std::unique_ptr<misra::ASTRule> misra::createRule5_0_5() {
+  return std::make_unique<Rule5_0_5>();
+}
+
+#ifndef MISRA_CHECK_DRIVER
 // Create an option category for the tool
 static llvm::cl::OptionCategory MyToolCategory("my-tool options");
 
@@ -84,17 +119,17 @@ int main(int argc, const char **argv) {
   // Create a ClangTool instance to run the tool
   ClangTool Tool(OptionsParser.getCompilations(), OptionsParser.getSourcePathList());
 
-  // Create a CastPrinter instance as the callback for the match
-  CastPrinter Printer;
-  // Create a MatchFinder instance to find matches based on the matchers
+  // Create the rule and a MatchFinder instance to find matches based on
+  // the matchers of the rule
+  auto Rule = misra::createRule5_0_5();
   MatchFinder Finder;
-  // Add the matchers to the MatchFinder instance
-  Finder.addMatcher(FloatToIntCastMatcher, &Printer);
-  Finder.addMatcher(IntToFloatCastMatcher, &Printer);
+  Rule->registerMatchers(Finder);
 
   // Run the tool with the MatchFinder instance as the action
   return Tool.run(newFrontendActionFactory(&Finder).get());
 }
+#endif // MISRA_CHECK_DRIVER
+
                                 //DOCUMENTATION
 /*
 This code is a tool that uses the Clang AST Matchers library to detect and report violations of the MISRA C++ Rule 5.0.5, which states that there shall be no floating-integral conversions. The tool detects two types of conversions: casting from float to int and casting from int to float. 
@@ -7,6 +7,10 @@
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include <vector>
 #include "clang/AST/ASTContext.h"
+#include "MisraCheckAction.h"
+#include "MisraRule.h"
+#include "OperatorVisitor.h"
+#include "ViolationRecorder.h"
 
 // Use these namespaces to simplify code
 using namespace clang;
@@ -15,35 +19,72 @@ using namespace clang::tooling;
 using namespace llvm;
 using namespace std;
 
-// Create a matcher to match int to bool casts
-StatementMatcher intToBooleanMatcher =
-    castExpr(hasCastKind(CK_IntegralToBoolean),
-             hasParent(expr(anyOf(binaryOperator(hasAnyOperatorName("||", "&&","<","<=",">",">=","==","!=")), unaryOperator(hasOperatorName("!"))))))
-        .bind("intToBoolean");
+namespace {
 
-// Create a callback class for the match found by the matcher
-class IntToBoolPrinter : public MatchFinder::MatchCallback {
+// Create a check class for the operators given to it by the operator visitor.
+// An int to bool cast is found from the operator it is an operand of, so no
+// parent map of the AST is needed.
+class IntToBoolPrinter : public misra::OperatorCheck {
 public:
-  // Override the virtual run function to process the match result
-  virtual void run(const MatchFinder::MatchResult &Result) override {
-    // Get the matched cast expression node
-    const CastExpr *castExpr = Result.Nodes.getNodeAs<CastExpr>("intToBoolean");
-    // Get the location of the cast in the source code
-    SourceLocation loc = castExpr->getBeginLoc();
-    // Get the full location of the cast in the source code
-    FullSourceLoc fullLoc(loc, (Result.Context->getSourceManager()));
-    // Get the diagnostics engine to report errors
-    DiagnosticsEngine &DE = Result.Context->getDiagnostics();
-    // Get a custom error ID for the cast from int to bool violation
-    const unsigned ID = DE.getCustomDiagID(
-        clang::DiagnosticsEngine::Error,
-        "MISRA C++ Rule 5.3.1 Violation! Each operand of the ! operator, the logical && or the logical || operators shall have type bool.");
-
-    // Report the cast from int to bool violation
-    DE.Report(loc, ID);
+  // Name of the rule in the --profile summary of misra-check
+  StringRef getID() const override { return "5.3.1"; }
+
+  // Check the operands of ||, &&, <, <=, >, >=, == and !=
+  virtual void checkBinary(const BinaryOperator &binOp,
+                           const misra::OperandInfo &LHS,
+                           const misra::OperandInfo &RHS,
+                           ASTContext &Context) override {
+    checkOperand(LHS);
+    checkOperand(RHS);
+  }
+
+  // Check the operand of !
+  virtual void checkUnary(const UnaryOperator &unOp,
+                          const misra::OperandInfo &operand,
+                          ASTContext &Context) override {
+    checkOperand(operand);
+  }
+
+  // Report the violations found in the translation unit
+  virtual void endTranslationUnit(ASTContext &Context) override {
+    Violations.report(Context.getDiagnostics(), Context.getSourceManager());
   }
+
+private:
+  void checkOperand(const misra::OperandInfo &operand) {
+    // Check if the operand is a cast from an integral type to bool
+    const auto *castExpr = dyn_cast<CastExpr>(operand.E);
+    if (castExpr && castExpr->getCastKind() == CK_IntegralToBoolean) {
+      // Record the cast from int to bool violation
+      Violations.add(castExpr->getBeginLoc());
+    }
+  }
+
+  misra::ViolationRecorder Violations{
+      "MISRA C++ Rule 5.3.1 Violation! Each operand of the ! operator, the "
+      "logical && or the logical || operators shall have type bool."};
 };
 
+// The rule as registered in the misra-check driver
+class Rule5_3_1 : public misra::ASTRule {
+public:
+  void registerOperatorChecks(misra::OperatorVisitor &Visitor) override {
+    Visitor.addBinaryCheck(
+        {BO_LOr, BO_LAnd, BO_LT, BO_LE, BO_GT, BO_GE, BO_EQ, BO_NE}, &Printer);
+    Visitor.addUnaryCheck({UO_LNot}, &Printer);
+  }
+
+private:
+  IntToBoolPrinter Printer;
+};
+
+} // namespace
+
+std::unique_ptr<misra::ASTRule> misra::createRule5_3_1() {
+  return std::make_unique<Rule5_3_1>();
+}
+
+#ifndef MISRA_CHECK_DRIVER
 // Create an option category for the tool
 static llvm::cl::OptionCategory MyToolCategory("my-tool options");
 
@@ -60,25 +101,28 @@ int main(int argc, const char **argv) {
   ClangTool Tool(OptionsParser.getCompilations(),
                  OptionsParser.getSourcePathList());
 
-  IntToBoolPrinter Printer;
+  auto Rule = misra::createRule5_3_1();
   MatchFinder Finder;
-  Finder.addMatcher(intToBooleanMatcher, &Printer);
+  misra::OperatorVisitor Operators;
+  Rule->registerMatchers(Finder);
+  Rule->registerOperatorChecks(Operators);
 
-  return Tool.run(newFrontendActionFactory(&Finder).get());
+  return Tool.run(misra::newMisraCheckActionFactory(Finder, Operators,
+                                                    Rule.get(), None)
+                      .get());
 }
+#endif // MISRA_CHECK_DRIVER
                                               //DOCUMENTATION
 /*
 This is a C++ program that uses the Clang AST Matchers library to find violations of MISRA C++ Rule 5.3.1, which states that "Each operand of the ! operator, the logical && or the logical || operators shall have type bool."
 
 The program starts by including necessary header files from Clang and LLVM. The namespaces for Clang, AST Matchers, Tooling, and LLVM are used to simplify the code.
 
-A matcher is defined to match int to bool casts. Specifically, it matches a CastExpr node that has a cast kind of CK_IntegralToBoolean and a parent node that is an expression that is either a binary operator with the operators ||, &&, <, <=, >, >=, ==, or != or a unary operator with the operator !. The matcher binds the matched node to the identifier "intToBoolean".
-
-A callback class, IntToBoolPrinter, is defined to process the match result. The class inherits from MatchFinder::MatchCallback and overrides the virtual function run. The run function gets the matched CastExpr node, gets the location of the cast in the source code, gets the full location of the cast in the source code, gets the diagnostics engine to report errors, and gets a custom error ID for the cast from int to bool violation. Finally, the run function reports the violation using the diagnostics engine.
+A check class, IntToBoolPrinter, is defined to find int to bool casts. The class inherits from misra::OperatorCheck and the rule adds it to a misra::OperatorVisitor for the binary operators ||, &&, <, <=, >, >=, == and != and for the unary operator !. The visitor walks the AST once for all the operator rules and calls the check for each of these operators. The check looks at the operands directly: an operand that is a CastExpr with a cast kind of CK_IntegralToBoolean is a violation, recorded at the location of the cast in a misra::ViolationRecorder. The casts are found from their operator, so no map of the parents of the AST nodes is built. At the end of the translation unit, endTranslationUnit reports all the recorded violations using the diagnostics engine, with a custom error ID that is registered once.
 
 An option category, MyToolCategory, is created for the tool.
 
-In the main function, a CommonOptionsParser object is created to parse command line arguments. If there is an error in parsing the arguments, the program gracefully exits with an error message. Otherwise, a ClangTool object is created with the parsed compilations and source path list. An instance of IntToBoolPrinter is created, and a MatchFinder object is created and the intToBooleanMatcher and Printer are added to it. Finally, the Tool is run with the MatchFinder object.
+In the main function, a CommonOptionsParser object is created to parse command line arguments. If there is an error in parsing the arguments, the program gracefully exits with an error message. Otherwise, a ClangTool object is created with the parsed compilations and source path list. The rule is created, and its check is added to a misra::OperatorVisitor object. Finally, the Tool is run with misra::newMisraCheckActionFactory.
 
-Overall, this program uses Clang's AST Matchers to find violations of MISRA C++ Rule 5.3.1, and reports them using the diagnostics engine.
+Overall, this program uses the Clang AST to find violations of MISRA C++ Rule 5.3.1, and reports them using the diagnostics engine.
 */
\ No newline at end of file
@@ -7,6 +7,8 @@
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include <vector>
 #include "clang/AST/ASTContext.h"
+#include "MisraRule.h"
+#include "ViolationRecorder.h"
 
 // Use these namespaces to simplify code
 using namespace clang;
@@ -15,6 +17,8 @@ using namespace clang::tooling;
 using namespace llvm;
 using namespace std;
 
+namespace {
+
 // Create a matcher to match var decl nodes for unsigned integers with negation
 const auto unsignedVarDeclMatcher = varDecl(
   hasType(isUnsignedInteger()),
@@ -24,26 +28,56 @@ const auto unsignedVarDeclMatcher = varDecl(
 // Create a callback class for the match found by the matcher
 class UnsignedVarDeclPrinter : public MatchFinder::MatchCallback {
 public:
+  // Name of the rule in the --profile summary of misra-check
+  StringRef getID() const override { return "5.3.2"; }
+
   // Override the virtual run function to process the match result
   virtual void run(const MatchFinder::MatchResult &Result) override {
+    // Keep the context for the report at the end of the translation unit
+    Context = Result.Context;
     // Get the matched var decl node
     const VarDecl *varDecl = Result.Nodes.getNodeAs<VarDecl>("unsignedVarDecl");
     // Get the location of the var decl in the source code
     SourceLocation loc = varDecl->getBeginLoc();
-    // Get the full location of the var decl in the source code
-    FullSourceLoc fullLoc(loc, (Result.Context->getSourceManager()));
-    // Get the diagnostics engine to report errors
-    DiagnosticsEngine &DE = Result.Context->getDiagnostics();
-    // Get a custom error ID for the unsigned variable with negation violation
-    const unsigned ID = DE.getCustomDiagID(
-        clang::DiagnosticsEngine::Error,
-        "MISRA C++ Rule 5.3.3 Violation! The unary minus operator shall not be applied to an operand whose underlying type is unsigned.");
-
-    // Report the unsigned variable with negation violation
-    DE.Report(loc, ID);
+
+    // Record the unsigned variable with negation violation
+    Violations.add(loc);
+  }
+
+  // Report the violations found in the translation unit
+  virtual void onEndOfTranslationUnit() override {
+    if (Context)
+      Violations.report(Context->getDiagnostics(),
+                        Context->getSourceManager());
+    Context = nullptr;
+  }
+
+private:
+  // Context of the matches, for the report
+  ASTContext *Context = nullptr;
+  misra::ViolationRecorder Violations{
+      "MISRA C++ Rule 5.3.2 Violation! The unary minus operator shall not be "
+      "applied to an operand whose underlying type is unsigned."};
+};
+
+// The rule as registered in the misra-check driver
+class Rule5_3_2 : public misra::ASTRule {
+public:
+  void registerMatchers(MatchFinder &Finder) override {
+    Finder.addMatcher(unsignedVarDeclMatcher, &Printer);
   }
+
+private:
+  UnsignedVarDeclPrinter Printer;
 };
 
+} // namespace
+
+std::unique_ptr<misra::ASTRule> misra::createRule5_3_2() {
+  return std::make_unique<Rule5_3_2>();
+}
+
+#ifndef MISRA_CHECK_DRIVER
 // Create an option category for the tool
 static llvm::cl::OptionCategory MyToolCategory("my-tool options");
 
@@ -60,19 +94,20 @@ int main(int argc, const char **argv) {
   ClangTool Tool(OptionsParser.getCompilations(),
                  OptionsParser.getSourcePathList());
 
-  UnsignedVarDeclPrinter Printer;
+  auto Rule = misra::createRule5_3_2();
   MatchFinder Finder;
-  Finder.addMatcher(unsignedVarDeclMatcher, &Printer);
+  Rule->registerMatchers(Finder);
 
   return Tool.run(newFrontendActionFactory(&Finder).get());
 }
+#endif // MISRA_CHECK_DRIVER
                                           //DOCUMENTATION
 /*
 This code is a C++ program that uses the Clang tooling library to analyze C++ source code for violations of the MISRA C++ Rule 5.3.2. The rule specifies that the unary minus operator shall not be applied to an operand whose underlying type is unsigned.
 
 The program defines a matcher that matches var decl nodes for unsigned integers with negation. It uses the Clang AST Matchers library to define this matcher. The matcher is named "unsignedVarDeclMatcher" and it binds to the node as "unsignedVarDecl".
 
-The program also defines a callback class named "UnsignedVarDeclPrinter". The callback class extends the "MatchFinder::MatchCallback" class and overrides the virtual "run" function to process the match result. The "run" function gets the matched var decl node, gets the location of the var decl in the source code, gets the full location of the var decl in the source code, and gets the diagnostics engine to report errors. It then reports the unsigned variable with negation violation by using a custom error ID.
+The program also defines a callback class named "UnsignedVarDeclPrinter". The callback class extends the "MatchFinder::MatchCallback" class and overrides the virtual "run" function to process the match result. The "run" function gets the matched var decl node, gets the location of the var decl in the source code and records the unsigned variable with negation violation there. The recorded violations are reported with a custom error ID at the end of the translation unit.
 
 The main function of the program creates a CommonOptionsParser object to parse command line arguments, creates an option category for the tool, and creates a ClangTool object. It also creates a "UnsignedVarDeclPrinter" object, a "MatchFinder" object, adds the "unsignedVarDeclMatcher" matcher to the "MatchFinder" object, and runs the tool with the "UnsignedVarDeclPrinter" object.
 
@@ -5,6 +5,10 @@
 #include "llvm/Support/raw_ostream.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "llvm/Support/CommandLine.h"
+#include "MisraRule.h"
+#include "ViolationRecorder.h"
+#include "TokenPattern.h"
+#include "TokenRuleAction.h"
 
 using namespace clang;
 using namespace clang::tooling;
@@ -13,40 +17,41 @@ using namespace std;
 using namespace clang::tooling;
 using namespace llvm;
 
-// Define a class OctalLiteralFinder which inherits from PreprocessorFrontendAction
-class OctalLiteralFinder : public clang::PreprocessorFrontendAction {
+namespace {
+
+// Define a class OctalLiteralFinder which looks for octal literals in the
+// tokens of the input
+class OctalLiteralFinder : public misra::TokenRule,
+                           public misra::TokenPatternCallback {
 public:
-  // Override the ExecuteAction() method
-  virtual void ExecuteAction() {
-    // Get the preprocessor, diagnostics, and source manager from the compiler instance
-    auto& pp = getCompilerInstance().getPreprocessor();
-    auto& diags = getCompilerInstance().getDiagnostics();
-    auto& sm = pp.getSourceManager();
-
-    // Tokenize the input source file
-    pp.EnterMainSourceFile();
-    clang::Token tok;
-
-    // Loop over all the tokens in the input source file
-    while (true) {
-      pp.Lex(tok);
-      if (tok.is(clang::tok::eof))
-        break;
-
-      // Check if the token is a literal with a length of at least 2 and starts with '0'
-      if (tok.isLiteral() && tok.getLiteralData() != nullptr &&
-          tok.getLength() >= 2 && tok.getLiteralData()[0] == '0' &&
-          (tok.getKind() == clang::tok::numeric_constant ||
-           tok.getKind() == clang::tok::char_constant)) {
-        // Found an octal literal, report a diagnostic for MISRA C Rule 7.1 violation
-        auto loc = sm.getSpellingLoc(tok.getLocation());
-        auto line = sm.getSpellingLineNumber(loc);
-        diags.Report(loc, diags.getCustomDiagID(clang::DiagnosticsEngine::Error, "MISRA C Rule 7.1 Violation! octal constant on line %0")) << line;
-      }
-    }
+  // Look for a literal with a length of at least 2 that starts with '0'
+  void registerPatterns(misra::TokenPatternSet &patterns) override {
+    patterns.addPattern(misra::token_patterns::zeroPrefixedLiteral(), this);
+  }
+
+  // Called for every octal literal of the preprocessed input source file
+  void run(const clang::Token &tok, clang::Preprocessor &pp) override {
+    // Found an octal literal, record a MISRA C Rule 7.1 violation
+    Violations.add(pp.getSourceManager().getSpellingLoc(tok.getLocation()));
+  }
+
+  // Report the violations found in the translation unit
+  void endTranslationUnit(clang::Preprocessor &pp) override {
+    Violations.report(pp.getDiagnostics(), pp.getSourceManager());
   }
+
+private:
+  misra::ViolationRecorder Violations{
+      "MISRA C Rule 7.1 Violation! octal constant on line %0"};
 };
 
+} // namespace
+
+std::unique_ptr<misra::TokenRule> misra::createRule7_1() {
+  return std::make_unique<OctalLiteralFinder>();
+}
+
+#ifndef MISRA_CHECK_DRIVER
 // Define a command line option category for the tool
 static llvm::cl::OptionCategory MyToolCategory("my-tool options");
 
@@ -63,26 +68,28 @@ int main(int argc, const char** argv) {
   ClangTool Tool(OptionsParser.getCompilations(),
                  OptionsParser.getSourcePathList());
 
-  // Run the OctalLiteralFinder action on the input source file(s)
-  return Tool.run(newFrontendActionFactory<OctalLiteralFinder>().get());
+  // Run the OctalLiteralFinder rule on the input source file(s)
+  auto Rule = misra::createRule7_1();
+  return Tool.run(misra::newTokenRuleActionFactory(Rule.get()).get());
 }
+#endif // MISRA_CHECK_DRIVER
                                           //DOCUMENTATION
 /*
 This is a C++ program that uses the Clang tooling library to analyze C source code for violations of MISRA C Rule 7.1, which prohibits the use of octal literals in C and C++ source code.
 
-The program defines a class called "OctalLiteralFinder" that inherits from "clang::PreprocessorFrontendAction". The "PreprocessorFrontendAction" is a class in Clang's FrontendActions.h header file, which defines an action that is executed by the Clang driver before any other frontend actions.
+The program defines a class called "OctalLiteralFinder" that inherits from "misra::TokenRule". A "TokenRule" is given the preprocessed tokens of the input by "misra::TokenRuleAction", a "PreprocessorFrontendAction" which lexes the file once for all the token rules that run together.
 
-The "OctalLiteralFinder" class overrides the "ExecuteAction()" method of the "PreprocessorFrontendAction" class. This method is called by the Clang driver to execute the action.
+The "OctalLiteralFinder" class overrides the "registerPatterns()" method of the "TokenRule" class. This method adds the token pattern "zeroPrefixedLiteral()" to the "misra::TokenPatternSet" of the shared lex loop, which runs the patterns of all the token rules together.
 
-The "ExecuteAction()" method gets the preprocessor, diagnostics, and source manager from the compiler instance. It then tokenizes the input source file using the preprocessor, and loops over all the tokens in the input source file.
+The pattern matches a literal with a length of at least 2 that starts with '0', a numeric constant or a character constant.
 
-For each token, the method checks if it is a literal with a length of at least 2 and starts with '0'. If so, it checks if the literal is a numeric constant or a character constant. If the literal is an octal constant, the method reports a diagnostic for MISRA C Rule 7.1 violation.
+For each token that matches, the set calls the "run()" method of the class, a "misra::TokenPatternCallback", which records a MISRA C Rule 7.1 violation at its location.
 
-The diagnostic is reported using the "getCustomDiagID()" method of the diagnostics engine. This method creates a custom diagnostic message with a unique ID that can be used to report the diagnostic. The custom diagnostic message includes the line number of the octal constant in the input source file.
+The violations are reported at the end of the translation unit by a "misra::ViolationRecorder", which calls the "getCustomDiagID()" method of the diagnostics engine once. This method creates a custom diagnostic message with a unique ID that can be used to report the diagnostic. The custom diagnostic message includes the line number of the octal constant in the input source file, which is only looked up when the violations are reported.
 
 The main function of the program creates a command line option category for the tool using the "llvm::cl::OptionCategory" class. It then parses the command line options using the "CommonOptionsParser::create()" method, which returns a "Expected<CommonOptionsParser>" object.
 
-If the command line options are supported, the program creates a "ClangTool" object and runs the "OctalLiteralFinder" action on the input source file(s) using the "run()" method of the "ClangTool" class.
+If the command line options are supported, the program creates a "ClangTool" object and runs the "OctalLiteralFinder" rule on the input source file(s) through a "misra::TokenRuleAction" using the "run()" method of the "ClangTool" class.
 
 Overall, this program is a useful tool for analyzing C++ source code for violations of MISRA C Rule 7.1.
 */
@@ -0,0 +1,144 @@
+// Time taken by each translation unit, kept between runs to schedule the next
+#include "CostHistory.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <queue>
+
+using namespace llvm;
+
+namespace misra {
+
+// Change it with the layout of the JSON file
+static const int64_t HistoryVersion = 1;
+
+// The seconds per byte of a file never checked when the history is empty,
+// about what a file that only includes the standard library takes. Only the
+// order of the files depends on it then.
+static const double DefaultSecondsPerByte = 1e-5;
+
+Expected<CostHistory> CostHistory::load(StringRef Path) {
+  CostHistory History;
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFile(Path);
+  if (!Buffer) {
+    if (Buffer.getError() == std::errc::no_such_file_or_directory)
+      return std::move(History);
+    return createFileError(Path, Buffer.getError());
+  }
+
+  Expected<json::Value> Root = json::parse((*Buffer)->getBuffer());
+  if (!Root)
+    return createFileError(Path, Root.takeError());
+
+  // {"version": 1, "units": {"<file>": {"size": 123, "seconds": 1.5}, ...}}
+  const json::Object *Object = Root->getAsObject();
+  if (!Object || Object->getInteger("version") != HistoryVersion)
+    // A history written by another version is rebuilt from scratch
+    return std::move(History);
+  const json::Object *Units = Object->getObject("units");
+  if (!Units)
+    return std::move(History);
+  for (const auto &Unit : *Units) {
+    const json::Object *Cost = Unit.second.getAsObject();
+    if (!Cost)
+      continue;
+    Optional<int64_t> Size = Cost->getInteger("size");
+    Optional<double> Seconds = Cost->getNumber("seconds");
+    if (Size && *Size >= 0 && Seconds && *Seconds >= 0)
+      History.setCost(Unit.first, *Size, *Seconds);
+  }
+  return std::move(History);
+}
+
+Error CostHistory::save(StringRef Path) const {
+  // Write the units in a fixed order, like the include graph
+  std::vector<StringRef> Files;
+  for (const auto &Unit : Units)
+    Files.push_back(Unit.first());
+  llvm::sort(Files);
+
+  Expected<sys::fs::TempFile> Temp =
+      sys::fs::TempFile::create(Path + ".tmp-%%%%%%%%");
+  if (!Temp)
+    return Temp.takeError();
+  {
+    raw_fd_ostream OS(Temp->FD, /*shouldClose=*/false);
+    json::OStream JOS(OS, /*IndentSize=*/2);
+    JOS.object([&] {
+      JOS.attribute("version", HistoryVersion);
+      JOS.attributeObject("units", [&] {
+        for (StringRef File : Files) {
+          const Entry &Cost = Units.find(File)->second;
+          JOS.attributeObject(File, [&] {
+            JOS.attribute("size", int64_t(Cost.Size));
+            JOS.attribute("seconds", Cost.Seconds);
+          });
+        }
+      });
+    });
+    OS << '\n';
+    OS.flush();
+    // The stream would abort the process if it were destroyed with its
+    // error, e.g. when the disk is full
+    if (OS.has_error()) {
+      std::error_code EC = OS.error();
+      OS.clear_error();
+      consumeError(Temp->discard());
+      return createFileError(Temp->TmpName, EC);
+    }
+  }
+  return Temp->keep(Path);
+}
+
+void CostHistory::setCost(StringRef File, uint64_t Size, double Seconds) {
+  auto Inserted = Units.try_emplace(File, Entry{Size, Seconds});
+  if (!Inserted.second) {
+    Entry &Old = Inserted.first->second;
+    TotalSize -= Old.Size;
+    TotalSeconds -= Old.Seconds;
+    Old = Entry{Size, Seconds};
+  }
+  TotalSize += Size;
+  TotalSeconds += Seconds;
+}
+
+double CostHistory::estimate(StringRef File, uint64_t Size) const {
+  auto Unit = Units.find(File);
+  if (Unit != Units.end())
+    return Unit->second.Seconds;
+  double SecondsPerByte =
+      TotalSize ? TotalSeconds / TotalSize : DefaultSecondsPerByte;
+  return Size * SecondsPerByte;
+}
+
+std::vector<size_t> getLongestFirstOrder(ArrayRef<double> Costs) {
+  std::vector<size_t> Order(Costs.size());
+  std::iota(Order.begin(), Order.end(), 0);
+  std::stable_sort(Order.begin(), Order.end(), [&](size_t A, size_t B) {
+    return Costs[A] > Costs[B];
+  });
+  return Order;
+}
+
+double predictMakespan(ArrayRef<double> Costs, ArrayRef<size_t> Order,
+                       unsigned NumWorkers) {
+  // When each worker is free again, the earliest on top
+  std::priority_queue<double, std::vector<double>, std::greater<double>> Free;
+  for (unsigned I = 0; I < std::max(1u, NumWorkers); ++I)
+    Free.push(0);
+  double Makespan = 0;
+  for (size_t Index : Order) {
+    double End = Free.top() + Costs[Index];
+    Free.pop();
+    Free.push(End);
+    Makespan = std::max(Makespan, End);
+  }
+  return Makespan;
+}
+
+} // namespace misra
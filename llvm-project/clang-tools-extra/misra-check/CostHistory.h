@@ -0,0 +1,59 @@
+// Time taken by each translation unit, kept between runs to schedule the next
+#ifndef MISRA_CHECK_COSTHISTORY_H
+#define MISRA_CHECK_COSTHISTORY_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include <cstdint>
+#include <vector>
+
+namespace misra {
+
+// For every translation unit that was checked, the size of its main file and
+// the seconds its last check took. The history is stored as a JSON file and
+// updated by each run, so that a later run can start the slowest files first.
+class CostHistory {
+public:
+  // Read the history from Path. A missing file gives an empty history.
+  static llvm::Expected<CostHistory> load(llvm::StringRef Path);
+
+  // Write the history to Path, replacing the file atomically
+  llvm::Error save(llvm::StringRef Path) const;
+
+  // Record that the check of File, whose main file has Size bytes, took
+  // Seconds
+  void setCost(llvm::StringRef File, uint64_t Size, double Seconds);
+
+  // The seconds the check of File is expected to take: the time of its last
+  // check, or for a file never checked, Size times the seconds per byte of
+  // the files in the history. The size of the main file says little about
+  // that of its headers, but a large generated file is seldom cheap.
+  double estimate(llvm::StringRef File, uint64_t Size) const;
+
+private:
+  struct Entry {
+    uint64_t Size;
+    double Seconds;
+  };
+  llvm::StringMap<Entry> Units;
+  // The sums over Units, for the seconds per byte
+  uint64_t TotalSize = 0;
+  double TotalSeconds = 0;
+};
+
+// The order in which to start the tasks that take Costs: the longest first,
+// in the order of Costs for equal ones. Since a worker takes the next task as
+// soon as it is free, no large task is left for the end, when the other
+// workers are idle.
+std::vector<size_t> getLongestFirstOrder(llvm::ArrayRef<double> Costs);
+
+// The time to run the tasks that take Costs on NumWorkers workers, which take
+// them in Order as soon as they are free
+double predictMakespan(llvm::ArrayRef<double> Costs,
+                       llvm::ArrayRef<size_t> Order, unsigned NumWorkers);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_COSTHISTORY_H
@@ -0,0 +1,324 @@
+// Unix socket protocol between misra-check and the misra-checkd daemon
+#include "Daemon.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Errno.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+
+#ifdef LLVM_ON_UNIX
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace llvm;
+
+namespace misra {
+
+std::string getDefaultSocketPath() {
+  SmallString<128> Path;
+  Optional<std::string> RuntimeDir = sys::Process::GetEnv("XDG_RUNTIME_DIR");
+  if (RuntimeDir && !RuntimeDir->empty()) {
+    Path = *RuntimeDir;
+    sys::path::append(Path, "misra-checkd.sock");
+    return std::string(Path);
+  }
+  sys::path::system_temp_directory(/*ErasedOnReboot=*/true, Path);
+#ifdef LLVM_ON_UNIX
+  sys::path::append(Path, "misra-checkd-" + Twine(::getuid()) + ".sock");
+#else
+  sys::path::append(Path, "misra-checkd.sock");
+#endif
+  return std::string(Path);
+}
+
+#ifdef LLVM_ON_UNIX
+
+namespace {
+
+// Closes a socket when it goes out of scope
+class SocketCloser {
+public:
+  explicit SocketCloser(int FD) : FD(FD) {}
+  ~SocketCloser() { ::close(FD); }
+
+private:
+  int FD;
+};
+
+// Fails with EPIPE instead of raising SIGPIPE when the other side is gone
+#ifdef MSG_NOSIGNAL
+const int SendFlags = MSG_NOSIGNAL;
+#else
+const int SendFlags = 0;
+#endif
+
+bool sendAll(int FD, StringRef Data) {
+  while (!Data.empty()) {
+    ssize_t Sent =
+        sys::RetryAfterSignal(-1, ::send, FD, Data.data(), Data.size(),
+                              SendFlags);
+    if (Sent <= 0)
+      return false;
+    Data = Data.drop_front(Sent);
+  }
+  return true;
+}
+
+bool sendMessage(int FD, json::Value Message) {
+  std::string Line;
+  raw_string_ostream OS(Line);
+  OS << Message << "\n";
+  OS.flush();
+  return sendAll(FD, Line);
+}
+
+// Reads the lines sent on a socket
+class LineReader {
+public:
+  explicit LineReader(int FD) : FD(FD) {}
+
+  // Returns false at the end of the stream
+  bool next(std::string &Line) {
+    while (true) {
+      size_t End = Buffer.find('\n');
+      if (End != std::string::npos) {
+        Line = Buffer.substr(0, End);
+        Buffer.erase(0, End + 1);
+        return true;
+      }
+      char Data[4096];
+      ssize_t Read = sys::RetryAfterSignal(
+          -1, ::recv, FD, static_cast<void *>(Data), sizeof(Data), 0);
+      if (Read <= 0)
+        return false;
+      Buffer.append(Data, Read);
+    }
+  }
+
+private:
+  int FD;
+  std::string Buffer;
+};
+
+// Sends what is written to it to a client, one {"output":...} message each
+// time it is flushed. Once the client is gone, the output is dropped.
+class OutputMessageStream : public raw_ostream {
+public:
+  explicit OutputMessageStream(int FD) : FD(FD) {}
+  ~OutputMessageStream() override { flush(); }
+
+private:
+  void write_impl(const char *Ptr, size_t Size) override {
+    Pos += Size;
+    if (!Failed)
+      Failed = !sendMessage(
+          FD, json::Object{{"output", json::fixUTF8(StringRef(Ptr, Size))}});
+  }
+
+  uint64_t current_pos() const override { return Pos; }
+
+  int FD;
+  uint64_t Pos = 0;
+  bool Failed = false;
+};
+
+Error makeAddress(StringRef SocketPath, sockaddr_un &Address) {
+  std::memset(&Address, 0, sizeof(Address));
+  Address.sun_family = AF_UNIX;
+  if (SocketPath.size() >= sizeof(Address.sun_path))
+    return createStringError(std::errc::filename_too_long,
+                             "socket path too long: %s",
+                             SocketPath.str().c_str());
+  std::memcpy(Address.sun_path, SocketPath.data(), SocketPath.size());
+  return Error::success();
+}
+
+// Connect to the daemon, returning the socket
+Expected<int> connectTo(StringRef SocketPath) {
+  sockaddr_un Address;
+  if (Error E = makeAddress(SocketPath, Address))
+    return std::move(E);
+  int FD = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (FD < 0)
+    return errorCodeToError(std::error_code(errno, std::generic_category()));
+  if (sys::RetryAfterSignal(-1, ::connect, FD,
+                            reinterpret_cast<sockaddr *>(&Address),
+                            sizeof(Address)) != 0) {
+    std::error_code EC(errno, std::generic_category());
+    ::close(FD);
+    return createStringError(EC, "cannot connect to misra-checkd on %s: %s",
+                             SocketPath.str().c_str(), EC.message().c_str());
+  }
+  return FD;
+}
+
+// Send Request and copy the answer of the daemon to OS
+Expected<int> sendRequest(StringRef SocketPath, json::Value Request,
+                          raw_ostream &OS) {
+  Expected<int> FD = connectTo(SocketPath);
+  if (!FD)
+    return FD.takeError();
+  SocketCloser Closer(*FD);
+  if (!sendMessage(*FD, std::move(Request)))
+    return createStringError(std::errc::broken_pipe,
+                             "cannot send the request to misra-checkd");
+
+  LineReader Reader(*FD);
+  std::string Line;
+  while (Reader.next(Line)) {
+    Expected<json::Value> Message = json::parse(Line);
+    if (!Message)
+      return Message.takeError();
+    const json::Object *Object = Message->getAsObject();
+    if (!Object)
+      continue;
+    if (Optional<StringRef> Output = Object->getString("output")) {
+      OS << *Output;
+      OS.flush();
+    } else if (Optional<int64_t> Status = Object->getInteger("status")) {
+      return static_cast<int>(*Status);
+    }
+  }
+  return createStringError(std::errc::connection_aborted,
+                           "misra-checkd closed the connection");
+}
+
+} // namespace
+
+Expected<int> runClient(StringRef SocketPath, ArrayRef<std::string> Args,
+                        raw_ostream &OS) {
+  SmallString<256> CurrentDir;
+  if (std::error_code EC = sys::fs::current_path(CurrentDir))
+    return errorCodeToError(EC);
+  json::Array JSONArgs;
+  for (const std::string &Arg : Args)
+    JSONArgs.push_back(json::fixUTF8(Arg));
+  return sendRequest(SocketPath,
+                     json::Object{{"cwd", json::fixUTF8(CurrentDir)},
+                                  {"args", std::move(JSONArgs)}},
+                     OS);
+}
+
+Error stopServer(StringRef SocketPath) {
+  Expected<int> Status =
+      sendRequest(SocketPath, json::Object{{"shutdown", true}}, nulls());
+  if (!Status)
+    return Status.takeError();
+  return Error::success();
+}
+
+Error runServer(StringRef SocketPath, RequestHandler Handler) {
+  sockaddr_un Address;
+  if (Error E = makeAddress(SocketPath, Address))
+    return E;
+
+  // A socket file left by a daemon that did not stop cleanly is removed, but
+  // not one that another daemon is still listening on
+  if (sys::fs::exists(SocketPath)) {
+    Expected<int> Other = connectTo(SocketPath);
+    if (Other) {
+      ::close(*Other);
+      return createStringError(std::errc::address_in_use,
+                               "misra-checkd is already running on %s",
+                               SocketPath.str().c_str());
+    }
+    consumeError(Other.takeError());
+    sys::fs::remove(SocketPath);
+  }
+
+  int FD = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (FD < 0)
+    return errorCodeToError(std::error_code(errno, std::generic_category()));
+  SocketCloser Closer(FD);
+  if (::bind(FD, reinterpret_cast<sockaddr *>(&Address), sizeof(Address)) !=
+          0 ||
+      ::listen(FD, SOMAXCONN) != 0) {
+    std::error_code EC(errno, std::generic_category());
+    return createStringError(EC, "cannot listen on %s: %s",
+                             SocketPath.str().c_str(), EC.message().c_str());
+  }
+
+  // A client that goes away in the middle of its request must not kill the
+  // daemon
+  ::signal(SIGPIPE, SIG_IGN);
+
+  bool Stop = false;
+  while (!Stop) {
+    int Client = sys::RetryAfterSignal(-1, ::accept, FD, nullptr, nullptr);
+    if (Client < 0)
+      continue;
+    SocketCloser ClientCloser(Client);
+
+    LineReader Reader(Client);
+    std::string Line;
+    if (!Reader.next(Line))
+      continue;
+    Expected<json::Value> Request = json::parse(Line);
+    const json::Object *Object = Request ? Request->getAsObject() : nullptr;
+    if (!Object) {
+      if (!Request)
+        consumeError(Request.takeError());
+      sendMessage(Client,
+                  json::Object{{"output", "misra-checkd: invalid request\n"}});
+      sendMessage(Client, json::Object{{"status", 1}});
+      continue;
+    }
+
+    if (Object->getBoolean("shutdown").getValueOr(false)) {
+      sendMessage(Client, json::Object{{"status", 0}});
+      Stop = true;
+      continue;
+    }
+
+    std::vector<std::string> Args;
+    if (const json::Array *JSONArgs = Object->getArray("args"))
+      for (const json::Value &Arg : *JSONArgs)
+        if (Optional<StringRef> S = Arg.getAsString())
+          Args.push_back(S->str());
+
+    int Status = 1;
+    {
+      OutputMessageStream OS(Client);
+      Optional<StringRef> Dir = Object->getString("cwd");
+      std::error_code EC;
+      if (Args.empty() || !Dir)
+        OS << "misra-checkd: invalid request\n";
+      else if ((EC = sys::fs::set_current_path(*Dir)))
+        OS << "misra-checkd: cannot change to directory '" << *Dir
+           << "': " << EC.message() << "\n";
+      else
+        Status = Handler(Args, OS);
+    }
+    sendMessage(Client, json::Object{{"status", Status}});
+  }
+
+  sys::fs::remove(SocketPath);
+  return Error::success();
+}
+
+#else // LLVM_ON_UNIX
+
+static Error notSupported() {
+  return createStringError(std::errc::not_supported,
+                           "misra-checkd needs Unix domain sockets");
+}
+
+Expected<int> runClient(StringRef SocketPath, ArrayRef<std::string> Args,
+                        raw_ostream &OS) {
+  return notSupported();
+}
+
+Error stopServer(StringRef SocketPath) { return notSupported(); }
+
+Error runServer(StringRef SocketPath, RequestHandler Handler) {
+  return notSupported();
+}
+
+#endif // LLVM_ON_UNIX
+
+} // namespace misra
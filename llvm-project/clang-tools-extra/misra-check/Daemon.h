@@ -0,0 +1,49 @@
+// Unix socket protocol between misra-check and the misra-checkd daemon
+#ifndef MISRA_CHECK_DAEMON_H
+#define MISRA_CHECK_DAEMON_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+#include <functional>
+#include <string>
+
+namespace misra {
+
+// A client sends one request per connection, a line of JSON with its
+// working directory and its command line:
+//   {"cwd":"/src/project","args":["misra-check","-p","build","a.cpp"]}
+// or {"shutdown":true} to stop the daemon. The daemon answers with lines of
+// JSON, the output of the command as it is produced and then its exit
+// status:
+//   {"output":"a.cpp:3:5: error: ..."}
+//   {"status":1}
+
+// Runs the command line Args, whose first element is the program name, in
+// the current directory, and returns its exit status. The output written to
+// OS is sent to the client every time OS is flushed.
+using RequestHandler =
+    std::function<int(llvm::ArrayRef<std::string> Args, llvm::raw_ostream &OS)>;
+
+// $XDG_RUNTIME_DIR/misra-checkd.sock, or a socket named after the user in
+// the temporary directory
+std::string getDefaultSocketPath();
+
+// Send Args and the current directory to the daemon on SocketPath, copy its
+// output to OS and return the exit status of the command
+llvm::Expected<int> runClient(llvm::StringRef SocketPath,
+                              llvm::ArrayRef<std::string> Args,
+                              llvm::raw_ostream &OS);
+
+// Ask the daemon on SocketPath to stop
+llvm::Error stopServer(llvm::StringRef SocketPath);
+
+// Listen on SocketPath and run Handler for each request, one at a time, in
+// the working directory of the client. Returns when a client asks the daemon
+// to stop.
+llvm::Error runServer(llvm::StringRef SocketPath, RequestHandler Handler);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_DAEMON_H
@@ -0,0 +1,196 @@
+// Stops the check of a translation unit once its time is up
+#include "Deadline.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/MultiplexConsumer.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Sema/Sema.h"
+#include "clang/Sema/TemplateInstCallback.h"
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace misra {
+
+namespace {
+
+class DeadlineAction : public WrapperFrontendAction {
+public:
+  DeadlineAction(std::unique_ptr<FrontendAction> Wrapped,
+                 std::chrono::steady_clock::time_point Deadline,
+                 const std::string &Message, bool &TimedOut)
+      : WrapperFrontendAction(std::move(Wrapped)), Deadline(Deadline),
+        Message(Message), TimedOut(TimedOut) {}
+
+  // Returns true if the deadline has passed, and stops the check of the
+  // file the first time
+  bool check();
+
+protected:
+  bool BeginSourceFileAction(CompilerInstance &CI) override;
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
+                                                 StringRef InFile) override;
+  void ExecuteAction() override;
+
+private:
+  std::chrono::steady_clock::time_point Deadline;
+  const std::string &Message;
+  bool &TimedOut;
+};
+
+bool DeadlineAction::check() {
+  if (TimedOut)
+    return true;
+  if (std::chrono::steady_clock::now() < Deadline)
+    return false;
+  TimedOut = true;
+
+  CompilerInstance &CI = getCompilerInstance();
+  DiagnosticsEngine &Diags = CI.getDiagnostics();
+  Diags.Report(Diags.getCustomDiagID(DiagnosticsEngine::Fatal, "%0"))
+      << Message;
+  // The engine only records the fatal error when another diagnostic follows
+  // it, which is then not shown. From then on the preprocessor enters no
+  // more included file.
+  Diags.Report(Diags.getCustomDiagID(DiagnosticsEngine::Error, "%0"))
+      << Message;
+  // And every template instantiation fails at once, as if it was too deep,
+  // with an error that is not shown either
+  CI.getLangOpts().InstantiationDepth = 0;
+  return true;
+}
+
+// Checks the deadline at each template instantiation
+class DeadlineTemplateCallback : public TemplateInstantiationCallback {
+public:
+  explicit DeadlineTemplateCallback(DeadlineAction &Action) : Action(Action) {}
+
+  void initialize(const Sema &S) override {}
+  void finalize(const Sema &S) override {}
+  void atTemplateBegin(const Sema &S,
+                       const Sema::CodeSynthesisContext &Inst) override {
+    Action.check();
+  }
+  void atTemplateEnd(const Sema &S,
+                     const Sema::CodeSynthesisContext &Inst) override {}
+
+private:
+  DeadlineAction &Action;
+};
+
+// Checks the deadline at each included file and macro expansion
+class DeadlinePPCallbacks : public PPCallbacks {
+public:
+  explicit DeadlinePPCallbacks(DeadlineAction &Action) : Action(Action) {}
+
+  void FileChanged(SourceLocation Loc, FileChangeReason Reason,
+                   SrcMgr::CharacteristicKind FileType,
+                   FileID PrevFID) override {
+    if (Reason == EnterFile)
+      Action.check();
+  }
+
+  void MacroExpands(const Token &MacroNameTok, const MacroDefinition &MD,
+                    SourceRange Range, const MacroArgs *Args) override {
+    Action.check();
+  }
+
+private:
+  DeadlineAction &Action;
+};
+
+// Passes everything on to the consumer of the wrapped action, but ends the
+// parse at the first top level declaration after the deadline, and does not
+// run the AST checks if it has passed
+class DeadlineConsumer : public MultiplexConsumer {
+public:
+  DeadlineConsumer(std::vector<std::unique_ptr<ASTConsumer>> Inner,
+                   DeadlineAction &Action)
+      : MultiplexConsumer(std::move(Inner)), Action(Action) {}
+
+  bool HandleTopLevelDecl(DeclGroupRef D) override {
+    if (Action.check())
+      return false;
+    return MultiplexConsumer::HandleTopLevelDecl(D);
+  }
+
+  void HandleTranslationUnit(ASTContext &Context) override {
+    if (!Action.check())
+      MultiplexConsumer::HandleTranslationUnit(Context);
+  }
+
+private:
+  DeadlineAction &Action;
+};
+
+bool DeadlineAction::BeginSourceFileAction(CompilerInstance &CI) {
+  if (!WrapperFrontendAction::BeginSourceFileAction(CI))
+    return false;
+  CI.getPreprocessor().addPPCallbacks(
+      std::make_unique<DeadlinePPCallbacks>(*this));
+  return true;
+}
+
+std::unique_ptr<ASTConsumer>
+DeadlineAction::CreateASTConsumer(CompilerInstance &CI, StringRef InFile) {
+  std::unique_ptr<ASTConsumer> Inner =
+      WrapperFrontendAction::CreateASTConsumer(CI, InFile);
+  if (!Inner)
+    return nullptr;
+  std::vector<std::unique_ptr<ASTConsumer>> Consumers;
+  Consumers.push_back(std::move(Inner));
+  return std::make_unique<DeadlineConsumer>(std::move(Consumers), *this);
+}
+
+void DeadlineAction::ExecuteAction() {
+  CompilerInstance &CI = getCompilerInstance();
+  // The template callbacks are added to the Sema before the parse, so it is
+  // created here rather than by the ASTFrontendAction, as clang's
+  // -templight-dump does
+  if (!usesPreprocessorOnly() && CI.hasASTConsumer()) {
+    if (!CI.hasSema())
+      CI.createSema(getTranslationUnitKind(),
+                    CI.hasCodeCompletionConsumer()
+                        ? &CI.getCodeCompletionConsumer()
+                        : nullptr);
+    CI.getSema().TemplateInstCallbacks.push_back(
+        std::make_unique<DeadlineTemplateCallback>(*this));
+  }
+  WrapperFrontendAction::ExecuteAction();
+}
+
+class DeadlineActionFactory : public FrontendActionFactory {
+public:
+  DeadlineActionFactory(std::unique_ptr<FrontendActionFactory> Inner,
+                        std::chrono::steady_clock::time_point Deadline,
+                        std::string Message, bool &TimedOut)
+      : Inner(std::move(Inner)), Deadline(Deadline),
+        Message(std::move(Message)), TimedOut(TimedOut) {}
+
+  std::unique_ptr<FrontendAction> create() override {
+    return std::make_unique<DeadlineAction>(Inner->create(), Deadline, Message,
+                                            TimedOut);
+  }
+
+private:
+  std::unique_ptr<FrontendActionFactory> Inner;
+  std::chrono::steady_clock::time_point Deadline;
+  std::string Message;
+  bool &TimedOut;
+};
+
+} // namespace
+
+std::unique_ptr<FrontendActionFactory>
+newDeadlineActionFactory(std::unique_ptr<FrontendActionFactory> Inner,
+                         std::chrono::steady_clock::time_point Deadline,
+                         std::string Message, bool &TimedOut) {
+  return std::make_unique<DeadlineActionFactory>(
+      std::move(Inner), Deadline, std::move(Message), TimedOut);
+}
+
+} // namespace misra
@@ -0,0 +1,32 @@
+// Stops the check of a translation unit once its time is up
+#ifndef MISRA_CHECK_DEADLINE_H
+#define MISRA_CHECK_DEADLINE_H
+
+#include "clang/Tooling/Tooling.h"
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace misra {
+
+// Wrap Inner so that the check of the file stops once Deadline has passed.
+// Clang cannot be interrupted at any point, so the deadline is checked where
+// the frontend calls back: at each top level declaration, whose consumer then
+// ends the parse, at each template instantiation, included file and macro
+// expansion, and before the AST checks, which are then not run. Message is
+// then reported as a fatal error, and TimedOut set. The violations of the
+// rules are reported at the end of the translation unit, so none is reported
+// for a file that was stopped.
+//
+// A deep template instantiation, or an include of a large header, is
+// stopped within one instantiation or one file, but a rule that is already
+// running is not: the deadline bounds the time of a file, not exactly.
+std::unique_ptr<clang::tooling::FrontendActionFactory>
+newDeadlineActionFactory(
+    std::unique_ptr<clang::tooling::FrontendActionFactory> Inner,
+    std::chrono::steady_clock::time_point Deadline, std::string Message,
+    bool &TimedOut);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_DEADLINE_H
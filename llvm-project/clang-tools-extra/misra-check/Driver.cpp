@@ -0,0 +1,1026 @@
+// Serial and parallel checking of translation units
+#include "Driver.h"
+#include "CostHistory.h"
+#include "Deadline.h"
+#include "IncludeGraph.h"
+#include "LineFilter.h"
+#include "MisraCheckAction.h"
+#include "OperatorVisitor.h"
+#include "PrecompiledHeader.h"
+#include "Prefilter.h"
+#include "Profile.h"
+#include "RawTokenLexer.h"
+#include "ResultCache.h"
+#include "StructuredOutput.h"
+#include "TokenPattern.h"
+#include "TokenRuleAction.h"
+#include "WorkerPool.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticIDs.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/LangOptions.h"
+#include "clang/Driver/Types.h"
+#include "clang/Frontend/PCHContainerOperations.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace misra {
+
+namespace {
+
+// Smallest duration, in microseconds, of the events kept in the time trace of
+// --profile, the default of -ftime-trace-granularity
+const unsigned ProfileGranularity = 500;
+
+MatchFinder::MatchFinderOptions
+getFinderOptions(bool Profile, StringMap<TimeRecord> &Records) {
+  MatchFinder::MatchFinderOptions Options;
+  if (Profile)
+    Options.CheckProfiling.emplace(Records);
+  return Options;
+}
+
+// The rules run on one translation unit. A new set is created for every
+// translation unit, so no rule state is ever shared between threads. When
+// profiling, the rules are wrapped or set up to record their own times.
+struct RuleSet {
+  std::vector<std::unique_ptr<TokenRule>> TokenRules;
+  std::vector<TokenRule *> TokenRulePtrs;
+  std::vector<std::unique_ptr<ASTRule>> ASTRules;
+  std::vector<ASTRule *> ASTRulePtrs;
+  // The times of the rules by rule name, or by callback or check ID, which
+  // is the rule name too
+  ProfileTimes TokenSeconds;
+  double TokenEndSeconds = 0;
+  ProfileTimes ConsumerSeconds;
+  ProfileTimes OperatorSeconds;
+  StringMap<TimeRecord> MatcherRecords;
+  StringMap<TimeRecord> WholeTUMatcherRecords;
+  MatchFinder Finder;
+  OperatorVisitor Operators;
+  // With SeparateWholeTU, the checks of the rules that need the whole
+  // translation unit are kept apart from the others, which are split over
+  // workers or restricted to the lines of a filter
+  MatchFinder WholeTUFinder;
+  OperatorVisitor WholeTUOperators;
+  std::vector<ASTRule *> WholeTURulePtrs;
+
+  RuleSet(const RuleSelection &Selection, bool Profile,
+          bool SeparateWholeTU = false)
+      : Finder(getFinderOptions(Profile, MatcherRecords)),
+        WholeTUFinder(getFinderOptions(Profile, WholeTUMatcherRecords)) {
+    for (const TokenRuleInfo *Info : Selection.TokenRules) {
+      TokenRules.push_back(Info->Create());
+      if (Profile)
+        TokenRules.push_back(std::make_unique<ProfiledTokenRule>(
+            *TokenRules.back(), TokenSeconds[Info->Name], TokenEndSeconds));
+      TokenRulePtrs.push_back(TokenRules.back().get());
+    }
+    if (Profile) {
+      Operators.enableProfiling(OperatorSeconds);
+      WholeTUOperators.enableProfiling(OperatorSeconds);
+    }
+    for (const ASTRuleInfo *Info : Selection.ASTRules) {
+      ASTRules.push_back(Info->Create());
+      if (Profile)
+        ASTRules.push_back(std::make_unique<ProfiledASTRule>(
+            *ASTRules.back(), Info->Name, ConsumerSeconds[Info->Name]));
+      if (SeparateWholeTU && Info->WholeTranslationUnit) {
+        ASTRules.back()->registerMatchers(WholeTUFinder);
+        ASTRules.back()->registerOperatorChecks(WholeTUOperators);
+        WholeTURulePtrs.push_back(ASTRules.back().get());
+        continue;
+      }
+      ASTRules.back()->registerMatchers(Finder);
+      ASTRules.back()->registerOperatorChecks(Operators);
+      ASTRulePtrs.push_back(ASTRules.back().get());
+    }
+  }
+
+  // The times of the translation unit, given the time it took in all, the
+  // time spent scanning it and getting its precompiled header and the time
+  // of its AST consumers. What is not spent in the rules is put in the phases
+  // around them.
+  ProfileTimes getTimes(double TotalSeconds, double ScanSeconds,
+                        double PCHSeconds, double ASTSeconds) const {
+    ProfileTimes Times;
+    double TokenRuleSeconds = 0;
+    for (const auto &Entry : TokenSeconds) {
+      Times[("rule " + Entry.getKey() + " (tokens)").str()] += Entry.getValue();
+      TokenRuleSeconds += Entry.getValue();
+    }
+    double ASTRuleSeconds = 0;
+    auto AddASTRule = [&](StringRef Name, StringRef Kind, double Seconds) {
+      Times[("rule " + Name + " (" + Kind + ")").str()] += Seconds;
+      ASTRuleSeconds += Seconds;
+    };
+    for (const auto &Entry : OperatorSeconds)
+      AddASTRule(Entry.getKey(), "operators", Entry.getValue());
+    for (const auto &Entry : ConsumerSeconds)
+      AddASTRule(Entry.getKey(), "traversal", Entry.getValue());
+    for (const auto &Entry : MatcherRecords)
+      AddASTRule(Entry.getKey(), "matchers", Entry.getValue().getWallTime());
+    for (const auto &Entry : WholeTUMatcherRecords)
+      AddASTRule(Entry.getKey(), "matchers", Entry.getValue().getWallTime());
+
+    if (ScanSeconds > 0)
+      Times["prefilter"] += ScanSeconds;
+    if (PCHSeconds > 0)
+      Times["precompiled header"] += PCHSeconds;
+    double FrontendSeconds =
+        TotalSeconds - ScanSeconds - PCHSeconds - TokenRuleSeconds;
+    if (!ASTRules.empty()) {
+      // The token rules are ended among the AST consumers
+      FrontendSeconds -= ASTSeconds - TokenEndSeconds;
+      Times["AST traversals"] +=
+          std::max(0.0, ASTSeconds - ASTRuleSeconds - TokenEndSeconds);
+    }
+    Times[ASTRules.empty() ? "preprocess" : "preprocess, parse and sema"] +=
+        std::max(0.0, FrontendSeconds);
+    return Times;
+  }
+};
+
+// Prints the diagnostics of each file in the order of the input files, as
+// soon as the diagnostics of all the files before it have been printed. The
+// lines of a structured format go through Writer if it is not null.
+class OrderedOutput {
+public:
+  OrderedOutput(raw_ostream &OS, size_t NumFiles,
+                StructuredOutputWriter *Writer)
+      : OS(OS), Pending(NumFiles), Writer(Writer) {}
+
+  void done(size_t Index, std::string Text) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Pending[Index] = std::move(Text);
+    while (Next < Pending.size() && Pending[Next]) {
+      if (Writer)
+        Writer->write(*Pending[Next]);
+      else
+        OS << *Pending[Next];
+      Pending[Next].reset();
+      ++Next;
+    }
+    // A client of misra-checkd sees each file as soon as it is done
+    OS.flush();
+  }
+
+private:
+  raw_ostream &OS;
+  std::mutex Mutex;
+  std::vector<Optional<std::string>> Pending;
+  StructuredOutputWriter *Writer;
+  size_t Next = 0;
+};
+
+// Passes the diagnostics on to another consumer and counts the errors
+// reported by the compiler itself, as opposed to those of the rules, which
+// all use custom diagnostic IDs
+class CompileErrorCounter : public ForwardingDiagnosticConsumer {
+public:
+  explicit CompileErrorCounter(DiagnosticConsumer &Target)
+      : ForwardingDiagnosticConsumer(Target), Target(Target) {}
+
+  void HandleDiagnostic(DiagnosticsEngine::Level Level,
+                        const Diagnostic &Info) override {
+    // Keep the error count of the base class, ClangTool uses it for the
+    // exit status
+    DiagnosticConsumer::HandleDiagnostic(Level, Info);
+    if (Level >= DiagnosticsEngine::Error &&
+        DiagnosticIDs::isBuiltinDiag(Info.getID()))
+      ++NumCompileErrors;
+    ForwardingDiagnosticConsumer::HandleDiagnostic(Level, Info);
+  }
+
+  // Passed on too, the text printer needs the language options of the file
+  void BeginSourceFile(const LangOptions &LangOpts,
+                       const Preprocessor *PP) override {
+    Target.BeginSourceFile(LangOpts, PP);
+  }
+  void EndSourceFile() override { Target.EndSourceFile(); }
+
+  unsigned NumCompileErrors = 0;
+
+private:
+  DiagnosticConsumer &Target;
+};
+
+// Everything about a run that is the same for all the files
+struct CheckContext {
+  const CompilationDatabase &Compilations;
+  const RuleSelection &Selection;
+  // The automata of the token patterns, kept for the files checked after
+  // the one that built them
+  TokenAutomatonCache &Automata;
+  // Null if no cache is used
+  ResultCache *Cache;
+  // Null if all the lines are checked
+  const LineFilter *Filter;
+  // Null if no precompiled header is used
+  PCHManager *PCH;
+  OutputFormat Format;
+  // Null unless profiling
+  RunProfile *Profile;
+  // Whether to scan the text of each translation unit first and only run
+  // the rules that it can trigger
+  bool Prefilter;
+  // Whether to only run the token rules, on the raw tokens of the main file
+  bool RawLex;
+  // Number of worker processes the AST checks of a file are split over, 1
+  // to run them in the process that parsed it
+  unsigned TUJobs;
+  // The longest time the check of one file may take, 0 for no limit
+  std::chrono::seconds TUTimeout;
+  // When the files not checked yet are given up, if ever
+  Optional<std::chrono::steady_clock::time_point> RunDeadline;
+  // Description of the options that change the diagnostics, for the keys of
+  // the cache
+  std::string KeyOptions;
+};
+
+std::unique_ptr<DiagnosticConsumer>
+newPrinter(const CheckContext &Context, raw_ostream &OS,
+           DiagnosticOptions *DiagOpts) {
+  if (Context.Format == OutputFormat::Text)
+    return std::make_unique<TextDiagnosticPrinter>(OS, DiagOpts);
+  return std::make_unique<StructuredDiagnosticConsumer>(OS, Context.Format);
+}
+
+// The diagnostic consumers of one file: the printer of the output format,
+// behind the counter of the compile errors, behind the line filter if any
+struct FileDiagnostics {
+  FileDiagnostics(const CheckContext &Context, raw_ostream &OS)
+      : DiagOpts(new DiagnosticOptions()),
+        Printer(newPrinter(Context, OS, DiagOpts.get())), Counter(*Printer) {
+    if (Context.Filter)
+      Filtered.emplace(Counter, *Context.Filter);
+  }
+
+  // The consumer the diagnostics are reported to
+  DiagnosticConsumer &getConsumer() {
+    return Filtered ? static_cast<DiagnosticConsumer &>(*Filtered) : Counter;
+  }
+
+  IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts;
+  std::unique_ptr<DiagnosticConsumer> Printer;
+  CompileErrorCounter Counter;
+  Optional<LineFilterDiagnosticConsumer> Filtered;
+};
+
+} // namespace
+
+// Scan the text of the translation units of the compile commands of a file,
+// or return None if one of them cannot be scanned
+static Optional<SourceScan> scanCommands(ArrayRef<CompileCommand> Commands) {
+  if (Commands.empty())
+    return None;
+  SourceScan All;
+  for (const CompileCommand &Command : Commands) {
+    Optional<SourceScan> Scan = scanTranslationUnit(
+        Command.Filename, Command.Directory, Command.CommandLine);
+    if (!Scan)
+      return None;
+    All.Features |= Scan->Features;
+    All.Files.insert(All.Files.end(), Scan->Files.begin(), Scan->Files.end());
+  }
+  return All;
+}
+
+// The rules of Selection that may find a violation in a text with the given
+// SourceFeatures
+static RuleSelection getApplicableRules(const RuleSelection &Selection,
+                                        unsigned Features) {
+  RuleSelection Applicable;
+  for (const ASTRuleInfo *Info : Selection.ASTRules)
+    if ((Info->Requires & Features) == Info->Requires)
+      Applicable.ASTRules.push_back(Info);
+  for (const TokenRuleInfo *Info : Selection.TokenRules)
+    if ((Info->Requires & Features) == Info->Requires)
+      Applicable.TokenRules.push_back(Info);
+  return Applicable;
+}
+
+// Whether every compile command compiles its file as C rather than C++, from
+// an -x option or else from the extension of the file
+static bool isCFile(ArrayRef<CompileCommand> Commands) {
+  if (Commands.empty())
+    return false;
+  for (const CompileCommand &Command : Commands) {
+    ArrayRef<std::string> Args = Command.CommandLine;
+    std::string Language;
+    bool CXXDriver = false;
+    if (!Args.empty() && sys::path::filename(Args.front()).contains("++"))
+      CXXDriver = true;
+    for (size_t I = 0; I < Args.size(); ++I) {
+      StringRef Arg = Args[I];
+      if (Arg == "-x" && I + 1 < Args.size())
+        Language = Args[++I];
+      else if (Arg.startswith("-x") && Arg.size() > 2)
+        Language = Arg.drop_front(2).str();
+      else if (Arg.startswith("--driver-mode="))
+        CXXDriver = Arg == "--driver-mode=g++";
+    }
+    driver::types::ID Type;
+    if (!Language.empty())
+      Type = driver::types::lookupTypeForTypeSpecifier(Language.c_str());
+    else if (CXXDriver)
+      // clang++ and g++ compile .c files as C++
+      return false;
+    else
+      Type = driver::types::lookupTypeForExtension(
+          sys::path::extension(Command.Filename).drop_front());
+    if (Type == driver::types::TY_INVALID ||
+        !driver::types::isDerivedFromC(Type) || driver::types::isCXX(Type))
+      return false;
+  }
+  return true;
+}
+
+// The rules of Selection that apply to the given RuleLanguage
+static RuleSelection getLanguageRules(const RuleSelection &Selection,
+                                      unsigned Language) {
+  RuleSelection Applicable;
+  for (const ASTRuleInfo *Info : Selection.ASTRules)
+    if (Info->Languages & Language)
+      Applicable.ASTRules.push_back(Info);
+  for (const TokenRuleInfo *Info : Selection.TokenRules)
+    if (Info->Languages & Language)
+      Applicable.TokenRules.push_back(Info);
+  return Applicable;
+}
+
+// Drop the options that only apply to C++ from the command line of a C file,
+// e.g. a -std=c++14 given after -- for the C and the C++ files alike, which
+// the compiler would reject
+static ArgumentsAdjuster getCLanguageAdjuster() {
+  return [](const CommandLineArguments &Args, StringRef) {
+    CommandLineArguments Adjusted;
+    for (const std::string &Arg : Args) {
+      StringRef Flag(Arg);
+      if (Flag.startswith("-std=c++") || Flag.startswith("-std=gnu++") ||
+          Flag.startswith("--std=c++") || Flag.startswith("--std=gnu++") ||
+          Flag.startswith("-stdlib="))
+        continue;
+      Adjusted.push_back(Arg);
+    }
+    return Adjusted;
+  };
+}
+
+// Check one file with the token rules of Selection on its raw tokens, for
+// --raw-lex. The diagnostics only depend on the file itself.
+static int checkFileRaw(const CheckContext &Context, StringRef File, bool IsC,
+                        RuleSelection Selection, raw_ostream &OS,
+                        std::vector<std::string> *Dependencies,
+                        unsigned &NumCompileErrors) {
+  auto Start = std::chrono::steady_clock::now();
+  FileDiagnostics Diagnostics(Context, OS);
+  int Status;
+  double ScanSeconds = 0;
+  // The rules and the lexer must end before the consumers
+  {
+    RawTokenLexer Lexer(File, IsC, Diagnostics.getConsumer());
+    Optional<StringRef> Text = Lexer.getText();
+    // Only the main file is lexed, so only its text needs to be scanned, and
+    // only for the numbers, which are all the literal rules look at. A file
+    // without any is not lexed.
+    if (Text && Context.Prefilter) {
+      auto ScanStart = std::chrono::steady_clock::now();
+      unsigned Features =
+          scanNumberFeatures(*Text) | (SF_All & ~unsigned(SF_Numbers));
+      Selection = getApplicableRules(Selection, Features);
+      ScanSeconds = secondsSince(ScanStart);
+    }
+    RuleSet Rules(Selection, Context.Profile != nullptr);
+    if (Text && !Rules.TokenRulePtrs.empty())
+      Lexer.run(Rules.TokenRulePtrs,
+                Context.Automata.get(Selection.TokenRules));
+    Status = Diagnostics.Counter.getNumErrors() ? 1 : 0;
+    if (Context.Profile)
+      Context.Profile->add(Rules.getTimes(secondsSince(Start), ScanSeconds,
+                                          /*PCHSeconds=*/0,
+                                          /*ASTSeconds=*/0));
+  }
+  NumCompileErrors = Diagnostics.Counter.NumCompileErrors;
+  if (Dependencies)
+    Dependencies->push_back(getCanonicalPath(File));
+  return Status;
+}
+
+// Check one file and write its diagnostics to OS. If Dependencies is not
+// null, the files read by the compiler are added to it. TimedOut is set if
+// the check was stopped by the --tu-timeout or the --deadline.
+static int checkFile(const CheckContext &Context, const std::string &File,
+                     raw_ostream &OS, std::vector<std::string> *Dependencies,
+                     unsigned &NumCompileErrors, bool &TimedOut) {
+  auto Start = std::chrono::steady_clock::now();
+  TimedOut = false;
+  SmallString<256> AbsoluteFile(File);
+  sys::fs::make_absolute(AbsoluteFile);
+  std::vector<CompileCommand> Commands =
+      Context.Compilations.getCompileCommands(AbsoluteFile);
+
+  // A C file is only checked against the rules for C
+  bool IsC = isCFile(Commands);
+  RuleSelection Selection =
+      getLanguageRules(Context.Selection, IsC ? RL_C : RL_CXX);
+
+  if (Context.RawLex)
+    return checkFileRaw(Context, AbsoluteFile, IsC, Selection, OS,
+                        Dependencies, NumCompileErrors);
+
+  // Leave out the rules that cannot find a violation in the text of the
+  // translation unit, and all of them if none of the files the compiler may
+  // read has a line of the filter
+  Optional<SourceScan> Scan;
+  double ScanSeconds = 0;
+  if ((Context.Prefilter || Context.Filter) &&
+      !(Selection.ASTRules.empty() && Selection.TokenRules.empty())) {
+    auto ScanStart = std::chrono::steady_clock::now();
+    Scan = scanCommands(Commands);
+    ScanSeconds = secondsSince(ScanStart);
+    if (Scan && Context.Prefilter)
+      Selection = getApplicableRules(Selection, Scan->Features);
+    if (Scan && Context.Filter &&
+        std::none_of(Scan->Files.begin(), Scan->Files.end(),
+                     [&](const std::string &ScannedFile) {
+                       return Context.Filter->getRanges(ScannedFile);
+                     }))
+      Selection = RuleSelection();
+  }
+
+  // Do not even preprocess the file if no rule is left. The result then only
+  // depends on the files scanned, or on the file itself if no rule applies to
+  // its language.
+  if (Selection.ASTRules.empty() && Selection.TokenRules.empty()) {
+    NumCompileErrors = 0;
+    if (Dependencies) {
+      if (Scan)
+        *Dependencies = std::move(Scan->Files);
+      else
+        Dependencies->push_back(getCanonicalPath(AbsoluteFile));
+    }
+    if (Context.Profile)
+      Context.Profile->add(ProfileTimes{{"prefilter", ScanSeconds}});
+    return 0;
+  }
+  // With --tu-jobs the AST checks are split over worker processes, unless
+  // every rule needs the whole translation unit
+  bool SplitTU = Context.TUJobs > 1 &&
+                 std::any_of(Selection.ASTRules.begin(),
+                             Selection.ASTRules.end(),
+                             [](const ASTRuleInfo *Info) {
+                               return !Info->WholeTranslationUnit;
+                             });
+  // The line filter must not narrow the rules that need the whole
+  // translation unit either, so they are kept apart with a filter too
+  RuleSet Rules(Selection, Context.Profile != nullptr,
+                SplitTU || Context.Filter);
+  WholeTUChecks WholeTU{Rules.WholeTUFinder, Rules.WholeTUOperators,
+                        Rules.WholeTURulePtrs};
+
+  // Every file gets its own file system object, since ClangTool changes its
+  // working directory to the one of the compile command
+  IntrusiveRefCntPtr<vfs::FileSystem> FS(
+      vfs::createPhysicalFileSystem().release());
+  ClangTool Tool(Context.Compilations, {File},
+                 std::make_shared<PCHContainerOperations>(), FS);
+
+  FileDiagnostics Diagnostics(Context, OS);
+  Tool.setDiagnosticConsumer(&Diagnostics.getConsumer());
+  Optional<PCHInfo> PCH;
+  double PCHSeconds = 0;
+  if (Context.PCH) {
+    auto PCHStart = std::chrono::steady_clock::now();
+    if (!Commands.empty())
+      PCH = Context.PCH->get(Commands.front(), IsC);
+    PCHSeconds = secondsSince(PCHStart);
+    if (PCH)
+      Tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(
+          {"-include-pch", PCH->Path}, ArgumentInsertPosition::BEGIN));
+  }
+  if (IsC)
+    Tool.appendArgumentsAdjuster(getCLanguageAdjuster());
+
+  TokenAutomaton &Automaton = Context.Automata.get(Selection.TokenRules);
+  std::unique_ptr<FrontendActionFactory> Factory;
+  if (Selection.ASTRules.empty())
+    // Without AST rules there is no need to parse, preprocessing is enough
+    Factory = newTokenRuleActionFactory(Rules.TokenRulePtrs, &Automaton);
+  else
+    // Otherwise the token rules watch the tokens of the parse done for the
+    // AST rules, so the file is preprocessed and parsed only once
+    Factory = newMisraCheckActionFactory(
+        Rules.Finder, Rules.Operators, Rules.ASTRulePtrs, Rules.TokenRulePtrs,
+        &Automaton, Context.Filter, &WholeTU, SplitTU ? Context.TUJobs : 1);
+
+  // Stop the check at the earliest of the timeout of the file and the
+  // deadline of the run
+  if (Context.TUTimeout.count() || Context.RunDeadline) {
+    auto Deadline = std::chrono::steady_clock::time_point::max();
+    std::string Message = "the deadline of the run passed (--deadline)";
+    if (Context.TUTimeout.count())
+      Deadline = Start + Context.TUTimeout;
+    if (Context.RunDeadline && *Context.RunDeadline < Deadline)
+      Deadline = *Context.RunDeadline;
+    else
+      Message = "it took more than " +
+                std::to_string(Context.TUTimeout.count()) +
+                " seconds (--tu-timeout)";
+    Factory = newDeadlineActionFactory(
+        std::move(Factory), Deadline,
+        "checking '" + File + "' was stopped, " + Message, TimedOut);
+  }
+
+  double ASTSeconds = 0;
+  if (Context.Profile)
+    Factory = newProfilingActionFactory(std::move(Factory), ASTSeconds);
+  if (Dependencies)
+    Factory =
+        newDependencyRecordingActionFactory(std::move(Factory), *Dependencies);
+  int Status = Tool.run(Factory.get());
+  NumCompileErrors = Diagnostics.Counter.NumCompileErrors;
+  if (Context.Profile)
+    Context.Profile->add(
+        Rules.getTimes(secondsSince(Start), ScanSeconds, PCHSeconds,
+                       ASTSeconds));
+  // The files in the precompiled header are not loaded by the source manager
+  // unless a diagnostic points into them, but the file depends on them all
+  if (Dependencies && PCH)
+    Dependencies->insert(Dependencies->end(), PCH->Dependencies.begin(),
+                         PCH->Dependencies.end());
+  return Status;
+}
+
+// An error without a location about File, in the output format of the run,
+// for a file that could not be checked
+static std::string reportFileError(const CheckContext &Context,
+                                   const Twine &Message) {
+  std::string Text;
+  raw_string_ostream OS(Text);
+  {
+    FileDiagnostics Diagnostics(Context, OS);
+    // Not given to the line filter, which would drop an error without a
+    // location
+    DiagnosticConsumer &Consumer = Diagnostics.Counter;
+    DiagnosticsEngine Diags(new DiagnosticIDs(), Diagnostics.DiagOpts.get(),
+                            &Consumer, /*ShouldOwnClient=*/false);
+    Consumer.BeginSourceFile(LangOptions());
+    Diags.Report(Diags.getCustomDiagID(DiagnosticsEngine::Error, "%0"))
+        << Message.str();
+    Consumer.EndSourceFile();
+  }
+  OS.flush();
+  return Text;
+}
+
+// Whether the --deadline of the run has passed
+static bool isPastDeadline(const CheckContext &Context) {
+  return Context.RunDeadline &&
+         std::chrono::steady_clock::now() >= *Context.RunDeadline;
+}
+
+static std::string reportDeadlinePassed(const CheckContext &Context,
+                                        StringRef File) {
+  return reportFileError(Context, "'" + File + "' was not checked, the "
+                                               "deadline of the run passed "
+                                               "(--deadline)");
+}
+
+// Check one file, or replay its diagnostics from the cache if none of the
+// files it depends on has changed since it was last checked. If Dependencies
+// is not null, it is set to the files read for this translation unit, or left
+// empty if they are not known because the file does not compile or was not
+// checked to the end. Once the --deadline has passed, only the cached results
+// are given, the other files fail. CheckSeconds is set to the time the check
+// took, or left empty if the file was not checked.
+static int checkFileCached(const CheckContext &Context,
+                           const std::string &File, raw_ostream &OS,
+                           std::vector<std::string> *Dependencies,
+                           Optional<double> &CheckSeconds) {
+  unsigned NumCompileErrors;
+  bool TimedOut;
+  CheckSeconds.reset();
+  ResultCache *Cache = Context.Cache;
+  if (!Cache) {
+    if (isPastDeadline(Context)) {
+      OS << reportDeadlinePassed(Context, File);
+      return 1;
+    }
+    auto Start = std::chrono::steady_clock::now();
+    int Status = checkFile(Context, File, OS, Dependencies, NumCompileErrors,
+                           TimedOut);
+    CheckSeconds = secondsSince(Start);
+    if (Dependencies && (NumCompileErrors || TimedOut))
+      Dependencies->clear();
+    return Status;
+  }
+
+  std::string Key = Cache->getKey(Context.Compilations, File,
+                                  Context.Selection, Context.KeyOptions);
+  if (Optional<CachedResult> Cached = Cache->lookup(Key)) {
+    OS << Cached->Output;
+    if (Dependencies)
+      *Dependencies = std::move(Cached->Dependencies);
+    return Cached->Status;
+  }
+
+  if (isPastDeadline(Context)) {
+    OS << reportDeadlinePassed(Context, File);
+    return 1;
+  }
+  CachedResult Result;
+  raw_string_ostream OutputOS(Result.Output);
+  auto Start = std::chrono::steady_clock::now();
+  Result.Status = checkFile(Context, File, OutputOS, &Result.Dependencies,
+                            NumCompileErrors, TimedOut);
+  CheckSeconds = secondsSince(Start);
+  OutputOS.flush();
+  OS << Result.Output;
+  // Files that do not compile are not cached: the error may come from a
+  // header that was not found, which is not among the dependencies. Nor are
+  // the files that were stopped, whose violations were not reported.
+  if (NumCompileErrors || TimedOut)
+    return Result.Status;
+  // A failure to write the cache only costs time on the next run
+  if (!Result.Dependencies.empty())
+    consumeError(Cache->store(Key, Result));
+  if (Dependencies)
+    *Dependencies = std::move(Result.Dependencies);
+  return Result.Status;
+}
+
+// The result of checkFileCached() in a worker process, as sent back to the
+// driver: the status, the seconds of the check, empty if there was none, and
+// the number of dependencies on a line each, then the dependencies, one per
+// line, then the output
+static std::string encodeWorkerResult(int Status, Optional<double> CheckSeconds,
+                                      ArrayRef<std::string> Dependencies,
+                                      StringRef Output) {
+  std::string Result = std::to_string(Status) + "\n";
+  if (CheckSeconds)
+    Result += std::to_string(*CheckSeconds);
+  Result += "\n" + std::to_string(Dependencies.size()) + "\n";
+  for (const std::string &File : Dependencies)
+    Result += File + "\n";
+  Result += Output;
+  return Result;
+}
+
+// Returns the status of a result of encodeWorkerResult(), and sets
+// CheckSeconds, Output and Dependencies, unless it is null
+static int decodeWorkerResult(StringRef Result,
+                              Optional<double> &CheckSeconds,
+                              std::vector<std::string> *Dependencies,
+                              std::string &Output) {
+  StringRef Line;
+  int Status = 1;
+  size_t NumDependencies = 0;
+  std::tie(Line, Result) = Result.split('\n');
+  Line.getAsInteger(10, Status);
+  std::tie(Line, Result) = Result.split('\n');
+  double Seconds;
+  if (!Line.getAsDouble(Seconds))
+    CheckSeconds = Seconds;
+  std::tie(Line, Result) = Result.split('\n');
+  Line.getAsInteger(10, NumDependencies);
+  for (size_t I = 0; I < NumDependencies; ++I) {
+    std::tie(Line, Result) = Result.split('\n');
+    if (Dependencies)
+      Dependencies->push_back(Line.str());
+  }
+  Output = Result.str();
+  return Status;
+}
+
+int checkFiles(const CompilationDatabase &Compilations,
+               ArrayRef<std::string> AllFiles, const RuleSelection &Rules,
+               const DriverOptions &Options, raw_ostream &OS) {
+  // The --deadline counts from here
+  auto RunStart = std::chrono::steady_clock::now();
+  std::unique_ptr<ResultCache> Cache;
+  if (!Options.CacheDir.empty()) {
+    if (std::error_code EC = sys::fs::create_directories(Options.CacheDir))
+      OS << "misra-check: cannot create cache directory '"
+         << Options.CacheDir << "': " << EC.message() << "\n";
+    else
+      Cache = std::make_unique<ResultCache>(Options.CacheDir);
+  }
+
+  Optional<IncludeGraph> Graph;
+  if (!Options.IncludeGraphPath.empty()) {
+    Expected<IncludeGraph> Loaded =
+        IncludeGraph::load(Options.IncludeGraphPath);
+    if (!Loaded) {
+      OS << "misra-check: " << toString(Loaded.takeError()) << "\n";
+      return 1;
+    }
+    Graph = std::move(*Loaded);
+  }
+
+  // Without --cost-history, the files are only told apart by their size
+  CostHistory Costs;
+  if (!Options.CostHistoryPath.empty()) {
+    Expected<CostHistory> Loaded = CostHistory::load(Options.CostHistoryPath);
+    if (!Loaded) {
+      OS << "misra-check: " << toString(Loaded.takeError()) << "\n";
+      return 1;
+    }
+    Costs = std::move(*Loaded);
+  }
+
+  // With --changed-since, only check the files that include a changed file
+  std::vector<std::string> Files(AllFiles.begin(), AllFiles.end());
+  if (!Options.ChangedSince.empty()) {
+    assert(Graph && "--changed-since needs an include graph");
+    Expected<StringSet<>> Changed = getChangedFiles(Options.ChangedSince);
+    if (!Changed) {
+      OS << "misra-check: " << toString(Changed.takeError()) << "\n";
+      return 1;
+    }
+    Files = Graph->getAffected(AllFiles, *Changed);
+    OS << "misra-check: " << Files.size() << " of " << AllFiles.size()
+       << " translation units affected by changes since "
+       << Options.ChangedSince << "\n";
+  }
+
+  // With --line-filter or --diff, only check some lines of the files
+  Optional<LineFilter> Filter;
+  if (!Options.LineFilterJSON.empty() || !Options.DiffSince.empty()) {
+    Expected<LineFilter> Parsed =
+        Options.DiffSince.empty()
+            ? LineFilter::parseJSON(Options.LineFilterJSON)
+            : LineFilter::fromGitDiff(Options.DiffSince);
+    if (!Parsed) {
+      OS << "misra-check: " << toString(Parsed.takeError()) << "\n";
+      return 1;
+    }
+    Filter = std::move(*Parsed);
+  }
+
+  // With --pch-header, the files that start with an include of the header
+  // use a precompiled header built from it
+  std::unique_ptr<PCHManager> PCH;
+  if (!Options.PCHHeader.empty()) {
+    SmallString<256> PCHDir(Options.PCHDir);
+    if (PCHDir.empty()) {
+      sys::path::system_temp_directory(/*ErasedOnReboot=*/true, PCHDir);
+      sys::path::append(PCHDir, "misra-check-pch");
+    }
+    if (std::error_code EC = sys::fs::create_directories(PCHDir))
+      OS << "misra-check: cannot create directory '" << PCHDir
+         << "': " << EC.message() << "\n";
+    else
+      PCH = std::make_unique<PCHManager>(Options.PCHHeader, PCHDir);
+  }
+
+  // The token rules do not see the tokens of a precompiled header, so its use
+  // changes the diagnostics
+  std::string KeyOptions;
+  if (Filter)
+    KeyOptions += Filter->str();
+  if (PCH)
+    KeyOptions += "pch:" + Options.PCHHeader;
+  if (Options.Format != OutputFormat::Text)
+    KeyOptions += "format:" + std::to_string(unsigned(Options.Format));
+  // The compile errors found by the parser are not reported for the files
+  // that the prefilter does not parse
+  if (Options.Prefilter)
+    KeyOptions += "prefilter";
+  if (Options.RawLex)
+    KeyOptions += "raw-lex";
+  // The split AST checks report their violations in the order of the source
+  unsigned TUJobs =
+      hardware_concurrency(Options.TUJobs).compute_thread_count();
+  if (TUJobs > 1)
+    KeyOptions += "tu-jobs";
+  std::unique_ptr<RunProfile> Profile;
+  if (!Options.ProfileFile.empty())
+    Profile = std::make_unique<RunProfile>();
+  Optional<std::chrono::steady_clock::time_point> RunDeadline;
+  if (Options.Deadline)
+    RunDeadline = RunStart + std::chrono::seconds(Options.Deadline);
+  TokenAutomatonCache Automata;
+  CheckContext Context{Compilations,
+                       Rules,
+                       Automata,
+                       Cache.get(),
+                       Filter.getPointer(),
+                       PCH.get(),
+                       Options.Format,
+                       Profile.get(),
+                       Options.Prefilter,
+                       Options.RawLex,
+                       TUJobs,
+                       std::chrono::seconds(Options.TUTimeout),
+                       RunDeadline,
+                       KeyOptions};
+
+  // With a structured format, the lines written for each file are put
+  // together in the output file
+  std::unique_ptr<raw_fd_ostream> OutputFile;
+  Optional<StructuredOutputWriter> Writer;
+  if (Options.Format != OutputFormat::Text) {
+    raw_ostream *ResultOS = &outs();
+    if (!Options.OutputFile.empty() && Options.OutputFile != "-") {
+      std::error_code EC;
+      OutputFile = std::make_unique<raw_fd_ostream>(Options.OutputFile, EC);
+      if (EC) {
+        OS << "misra-check: cannot write '" << Options.OutputFile
+           << "': " << EC.message() << "\n";
+        return 1;
+      }
+      ResultOS = OutputFile.get();
+    }
+    Writer.emplace(*ResultOS, Options.Format);
+    Writer->begin(Rules);
+  }
+
+  OrderedOutput Output(OS, Files.size(), Writer.getPointer());
+  std::vector<int> Status(Files.size(), 0);
+  std::vector<std::vector<std::string>> Dependencies(Graph ? Files.size() : 0);
+  std::vector<Optional<double>> CheckSeconds(Files.size());
+
+  // In parallel, the files expected to take longest are started first, so
+  // that a large one does not start last and run alone at the end. The
+  // output stays in the order of Files. With one job the files are checked
+  // in order, so that each one is printed as soon as it is done.
+  unsigned NumJobs = Options.Isolate || Options.Jobs != 1
+                         ? hardware_concurrency(Options.Jobs)
+                               .compute_thread_count()
+                         : 1;
+  std::vector<std::string> CanonicalFiles;
+  std::vector<uint64_t> Sizes(Files.size(), 0);
+  std::vector<double> Estimates(Files.size(), 0);
+  for (size_t I = 0; I < Files.size(); ++I) {
+    CanonicalFiles.push_back(getCanonicalPath(Files[I]));
+    sys::fs::file_size(CanonicalFiles[I], Sizes[I]);
+    Estimates[I] = Costs.estimate(CanonicalFiles[I], Sizes[I]);
+  }
+  std::vector<size_t> Order(Files.size());
+  std::iota(Order.begin(), Order.end(), 0);
+  if (NumJobs > 1)
+    Order = getLongestFirstOrder(Estimates);
+  auto ChecksStart = std::chrono::steady_clock::now();
+
+  // With --profile, each thread records its own time trace. A worker thread
+  // records one for each file and hands it over when the file is done.
+  if (Profile)
+    timeTraceProfilerInitialize(ProfileGranularity, "misra-check");
+
+  auto CheckOne = [&](size_t Index) {
+    bool WorkerTrace = Profile && !timeTraceProfilerEnabled();
+    if (WorkerTrace)
+      timeTraceProfilerInitialize(ProfileGranularity, "misra-check");
+    {
+      TimeTraceScope TimeScope("Check", Files[Index]);
+      std::string Text;
+      raw_string_ostream FileOS(Text);
+      Status[Index] = checkFileCached(Context, Files[Index], FileOS,
+                                      Graph ? &Dependencies[Index] : nullptr,
+                                      CheckSeconds[Index]);
+      FileOS.flush();
+      Output.done(Index, std::move(Text));
+    }
+    if (WorkerTrace)
+      timeTraceProfilerFinishThread();
+  };
+
+  if (Options.Isolate) {
+    // Each file is checked in a worker process, so that one that crashes or
+    // runs out of memory only fails itself. The workers are forked here,
+    // before any thread is started. The workers take the tasks in turn, task
+    // I checks the file Order[I].
+    OS.flush();
+    runInWorkers(
+        Files.size(), NumJobs, Options.WorkerMemoryLimitMB,
+        // A file that is not stopped by the timeout in its worker gets as
+        // long again before the worker is killed
+        std::chrono::seconds(2 * uint64_t(Options.TUTimeout)),
+        [&](size_t Task) {
+          size_t Index = Order[Task];
+          std::vector<std::string> FileDependencies;
+          Optional<double> FileSeconds;
+          std::string Text;
+          raw_string_ostream FileOS(Text);
+          int FileStatus = checkFileCached(
+              Context, Files[Index], FileOS,
+              Graph ? &FileDependencies : nullptr, FileSeconds);
+          FileOS.flush();
+          return encodeWorkerResult(FileStatus, FileSeconds, FileDependencies,
+                                    Text);
+        },
+        [&](size_t Task, std::string Result) {
+          size_t Index = Order[Task];
+          std::string Text;
+          Status[Index] = decodeWorkerResult(
+              Result, CheckSeconds[Index],
+              Graph ? &Dependencies[Index] : nullptr, Text);
+          Output.done(Index, std::move(Text));
+        },
+        [&](size_t Task, StringRef Reason) {
+          size_t Index = Order[Task];
+          Status[Index] = 1;
+          Output.done(Index, reportFileError(Context,
+                                             "the worker process checking '" +
+                                                 Files[Index] + "' " + Reason +
+                                                 ", the file is not checked"));
+        });
+  } else if (NumJobs == 1) {
+    for (size_t Index : Order)
+      CheckOne(Index);
+  } else {
+    // The threads of the pool take the next file from a shared queue as soon
+    // as they are free
+    ThreadPool Pool(hardware_concurrency(Options.Jobs));
+    for (size_t Index : Order)
+      Pool.async(CheckOne, Index);
+    Pool.wait();
+  }
+  double Makespan = secondsSince(ChecksStart);
+
+  if (Writer)
+    Writer->end();
+
+  if (!Options.CostHistoryPath.empty()) {
+    // The files replayed from the cache, or skipped past the deadline, were
+    // not checked and took next to no time
+    for (size_t I = 0; I < Files.size(); ++I)
+      if (!CheckSeconds[I])
+        Estimates[I] = 0;
+    OS << "misra-check: checked " << Files.size() << " translation units in "
+       << format("%.1f", Makespan) << " s on " << NumJobs
+       << " jobs, predicted "
+       << format("%.1f", predictMakespan(Estimates, Order, NumJobs))
+       << " s\n";
+    // The files replayed from the cache keep the time of their last check
+    for (size_t I = 0; I < Files.size(); ++I)
+      if (CheckSeconds[I])
+        Costs.setCost(CanonicalFiles[I], Sizes[I], *CheckSeconds[I]);
+    if (Error E = Costs.save(Options.CostHistoryPath))
+      OS << "misra-check: cannot write the cost history: "
+         << toString(std::move(E)) << "\n";
+    OS.flush();
+  }
+
+  if (Profile) {
+    std::error_code EC;
+    raw_fd_ostream TraceOS(Options.ProfileFile, EC, sys::fs::OF_Text);
+    if (EC)
+      OS << "misra-check: cannot write '" << Options.ProfileFile
+         << "': " << EC.message() << "\n";
+    else
+      timeTraceProfilerWrite(TraceOS);
+    timeTraceProfilerCleanup();
+    Profile->print(OS);
+    OS.flush();
+  }
+
+  if (Cache)
+    Cache->prune(Options.CachePolicy);
+
+  if (Graph) {
+    for (size_t I = 0; I < Files.size(); ++I)
+      Graph->setDependencies(CanonicalFiles[I], Dependencies[I]);
+    if (Error E = Graph->save(Options.IncludeGraphPath))
+      OS << "misra-check: cannot write the include graph: "
+         << toString(std::move(E)) << "\n";
+  }
+
+  // Same convention as ClangTool::run: 1 if a file failed, otherwise 2 if a
+  // file was skipped
+  int Result = 0;
+  for (int S : Status) {
+    if (S == 1)
+      return 1;
+    if (S == 2)
+      Result = 2;
+  }
+  return Result;
+}
+
+} // namespace misra
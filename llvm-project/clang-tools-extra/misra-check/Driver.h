@@ -0,0 +1,93 @@
+// Runs the selected rules over a list of translation units
+#ifndef MISRA_CHECK_DRIVER_H
+#define MISRA_CHECK_DRIVER_H
+
+#include "MisraRule.h"
+#include "StructuredOutput.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace misra {
+
+// The rules selected for a run
+struct RuleSelection {
+  std::vector<const ASTRuleInfo *> ASTRules;
+  std::vector<const TokenRuleInfo *> TokenRules;
+};
+
+// Options of the driver
+struct DriverOptions {
+  // Number of translation units checked in parallel, 0 means one per core
+  unsigned Jobs = 1;
+  // Directory of the result cache, no cache is used if it is empty
+  std::string CacheDir;
+  // When and how much of the result cache to remove after the run
+  llvm::CachePruningPolicy CachePolicy;
+  // JSON file with the files included by each translation unit, read and
+  // updated by the run if it is not empty
+  std::string IncludeGraphPath;
+  // JSON file with the time each translation unit took, read and updated by
+  // the run if it is not empty. The files expected to take longest are
+  // started first (see CostHistory.h).
+  std::string CostHistoryPath;
+  // Only check the files affected by the changes since this git revision.
+  // Needs IncludeGraphPath.
+  std::string ChangedSince;
+  // Only check the lines given in this JSON text, see LineFilter::parseJSON
+  std::string LineFilterJSON;
+  // Only check the lines changed since this git revision
+  std::string DiffSince;
+  // Header to precompile for the files whose first directive includes it
+  std::string PCHHeader;
+  // Where the precompiled headers are kept, a temporary directory if empty
+  std::string PCHDir;
+  // Format of the diagnostics
+  OutputFormat Format = OutputFormat::Text;
+  // File receiving the JSON Lines or SARIF output, stdout if empty or "-".
+  // Text diagnostics are always printed to the stream given to checkFiles.
+  std::string OutputFile;
+  // If not empty, write a Chrome trace of the run to this file and print
+  // the time spent in each phase and rule after the diagnostics
+  std::string ProfileFile;
+  // Scan the text of each translation unit and of its headers first, and
+  // only run the rules that can find a violation in it (see Prefilter.h)
+  bool Prefilter = true;
+  // Only run the token rules, on the raw tokens of each file without
+  // preprocessing it (see RawTokenLexer.h)
+  bool RawLex = false;
+  // Check each translation unit in one of Jobs worker processes, so that a
+  // crash only fails its own file (see WorkerPool.h). Not with ProfileFile.
+  bool Isolate = false;
+  // Split the AST checks of each translation unit over this many worker
+  // processes, 0 for one per core, so that a single large file uses more
+  // than one core (see ParallelChecks.h). Needs Jobs == 1 or Isolate.
+  unsigned TUJobs = 1;
+  // With Isolate, the address space of each worker in megabytes, or 0 for
+  // no limit
+  uint64_t WorkerMemoryLimitMB = 0;
+  // Stop the check of a file that takes more than this many seconds, 0 for
+  // no limit (see Deadline.h)
+  unsigned TUTimeout = 0;
+  // Stop the checks running this many seconds after the start of the run,
+  // and fail the files not checked yet but for the cached ones, 0 for no
+  // deadline. The output, the cache and the include graph are still written.
+  unsigned Deadline = 0;
+};
+
+// Check every file with the selected rules. Each translation unit gets its
+// own instances of the rules, so results do not depend on the number of
+// jobs. Diagnostics are printed to OS, or to Options.OutputFile in a
+// structured format, in the order of Files, and flushed after each file.
+// Returns the exit status of the tool.
+int checkFiles(const clang::tooling::CompilationDatabase &Compilations,
+               llvm::ArrayRef<std::string> Files, const RuleSelection &Rules,
+               const DriverOptions &Options, llvm::raw_ostream &OS);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_DRIVER_H
@@ -0,0 +1,51 @@
+// Helpers to ask git about the repository containing the current directory
+#include "Git.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FileUtilities.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Program.h"
+
+using namespace llvm;
+
+namespace misra {
+
+// Run git with Args in the current directory and return its standard output
+Expected<std::string> runGit(ArrayRef<StringRef> Args) {
+  ErrorOr<std::string> Git = sys::findProgramByName("git");
+  if (!Git)
+    return createStringError(Git.getError(), "cannot find git");
+
+  SmallString<128> OutputPath;
+  if (std::error_code EC =
+          sys::fs::createTemporaryFile("misra-check-git", "txt", OutputPath))
+    return createStringError(EC, "cannot create a temporary file");
+  FileRemover RemoveOutput(OutputPath);
+
+  std::vector<StringRef> Argv = {*Git};
+  Argv.insert(Argv.end(), Args.begin(), Args.end());
+  Optional<StringRef> Redirects[] = {StringRef(""), StringRef(OutputPath),
+                                     None};
+  std::string ErrMsg;
+  int Result = sys::ExecuteAndWait(*Git, Argv, /*Env=*/None, Redirects,
+                                   /*SecondsToWait=*/0, /*MemoryLimit=*/0,
+                                   &ErrMsg);
+  if (Result != 0)
+    return createStringError(inconvertibleErrorCode(), "git %s failed%s%s",
+                             Args.front().str().c_str(),
+                             ErrMsg.empty() ? "" : ": ", ErrMsg.c_str());
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Output =
+      MemoryBuffer::getFile(OutputPath);
+  if (!Output)
+    return createStringError(Output.getError(), "cannot read git output");
+  return (*Output)->getBuffer().str();
+}
+
+Expected<std::string> getGitTopLevel() {
+  Expected<std::string> TopLevel = runGit({"rev-parse", "--show-toplevel"});
+  if (!TopLevel)
+    return TopLevel.takeError();
+  return StringRef(*TopLevel).trim().str();
+}
+
+} // namespace misra
@@ -0,0 +1,20 @@
+// Helpers to ask git about the repository containing the current directory
+#ifndef MISRA_CHECK_GIT_H
+#define MISRA_CHECK_GIT_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include <string>
+
+namespace misra {
+
+// Run git with Args in the current directory and return its standard output
+llvm::Expected<std::string> runGit(llvm::ArrayRef<llvm::StringRef> Args);
+
+// Return the absolute path of the top directory of the repository
+llvm::Expected<std::string> getGitTopLevel();
+
+} // namespace misra
+
+#endif // MISRA_CHECK_GIT_H
@@ -0,0 +1,141 @@
+// Files included by each translation unit, kept between runs
+#include "IncludeGraph.h"
+#include "Git.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+namespace misra {
+
+// Change it with the layout of the JSON file
+static const int64_t GraphVersion = 1;
+
+Expected<IncludeGraph> IncludeGraph::load(StringRef Path) {
+  IncludeGraph Graph;
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFile(Path);
+  if (!Buffer) {
+    if (Buffer.getError() == std::errc::no_such_file_or_directory)
+      return std::move(Graph);
+    return createFileError(Path, Buffer.getError());
+  }
+
+  Expected<json::Value> Root = json::parse((*Buffer)->getBuffer());
+  if (!Root)
+    return createFileError(Path, Root.takeError());
+
+  // {"version": 1, "units": {"<file>": ["<dependency>", ...], ...}}
+  const json::Object *Object = Root->getAsObject();
+  if (!Object || Object->getInteger("version") != GraphVersion)
+    // A graph written by another version is rebuilt from scratch
+    return std::move(Graph);
+  const json::Object *Units = Object->getObject("units");
+  if (!Units)
+    return std::move(Graph);
+  for (const auto &Unit : *Units) {
+    const json::Array *Deps = Unit.second.getAsArray();
+    if (!Deps)
+      continue;
+    std::vector<std::string> &Entry = Graph.Units[Unit.first.str()];
+    for (const json::Value &Dep : *Deps)
+      if (Optional<StringRef> Path = Dep.getAsString())
+        Entry.push_back(Path->str());
+  }
+  return std::move(Graph);
+}
+
+Error IncludeGraph::save(StringRef Path) const {
+  // Write the units in a fixed order, so that the file does not change when
+  // the graph does not
+  std::vector<StringRef> Files;
+  for (const auto &Unit : Units)
+    Files.push_back(Unit.first());
+  llvm::sort(Files);
+
+  Expected<sys::fs::TempFile> Temp =
+      sys::fs::TempFile::create(Path + ".tmp-%%%%%%%%");
+  if (!Temp)
+    return Temp.takeError();
+  {
+    raw_fd_ostream OS(Temp->FD, /*shouldClose=*/false);
+    json::OStream JOS(OS, /*IndentSize=*/2);
+    JOS.object([&] {
+      JOS.attribute("version", GraphVersion);
+      JOS.attributeObject("units", [&] {
+        for (StringRef File : Files)
+          JOS.attributeArray(File, [&] {
+            for (const std::string &Dep : Units.find(File)->second)
+              JOS.value(Dep);
+          });
+      });
+    });
+    OS << '\n';
+    OS.flush();
+    // The stream would abort the process if it were destroyed with its
+    // error, e.g. when the disk is full
+    if (OS.has_error()) {
+      std::error_code EC = OS.error();
+      OS.clear_error();
+      consumeError(Temp->discard());
+      return createFileError(Temp->TmpName, EC);
+    }
+  }
+  return Temp->keep(Path);
+}
+
+void IncludeGraph::setDependencies(StringRef File,
+                                   ArrayRef<std::string> Dependencies) {
+  std::vector<std::string> &Entry = Units[File];
+  Entry.assign(Dependencies.begin(), Dependencies.end());
+  llvm::sort(Entry);
+  Entry.erase(std::unique(Entry.begin(), Entry.end()), Entry.end());
+}
+
+std::vector<std::string>
+IncludeGraph::getAffected(ArrayRef<std::string> Files,
+                          const StringSet<> &Changed) const {
+  std::vector<std::string> Affected;
+  for (const std::string &File : Files) {
+    auto Unit = Units.find(getCanonicalPath(File));
+    if (Unit == Units.end() || Unit->second.empty() ||
+        llvm::any_of(Unit->second, [&](const std::string &Dep) {
+          return Changed.count(Dep);
+        }))
+      Affected.push_back(File);
+  }
+  return Affected;
+}
+
+Expected<StringSet<>> getChangedFiles(StringRef Rev) {
+  Expected<std::string> Root = getGitTopLevel();
+  if (!Root)
+    return Root.takeError();
+
+  // Files changed in the commits since Rev and in the working tree. The names
+  // are separated by NUL bytes, so that they are never quoted.
+  Expected<std::string> Diff = runGit({"diff", "--name-only", "-z", Rev, "--"});
+  if (!Diff)
+    return Diff.takeError();
+
+  StringSet<> Changed;
+  SmallVector<StringRef, 64> Names;
+  StringRef(*Diff).split(Names, '\0', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+  for (StringRef Name : Names) {
+    SmallString<256> Path(*Root);
+    sys::path::append(Path, Name);
+    Changed.insert(getCanonicalPath(Path));
+  }
+  return std::move(Changed);
+}
+
+std::string getCanonicalPath(StringRef File) {
+  SmallString<256> Path(File);
+  sys::fs::make_absolute(Path);
+  sys::path::remove_dots(Path, /*remove_dot_dot=*/true);
+  return std::string(Path.str());
+}
+
+} // namespace misra
@@ -0,0 +1,52 @@
+// Files included by each translation unit, kept between runs
+#ifndef MISRA_CHECK_INCLUDEGRAPH_H
+#define MISRA_CHECK_INCLUDEGRAPH_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Error.h"
+#include <string>
+#include <vector>
+
+namespace misra {
+
+// For every translation unit that was checked, the absolute paths of all the
+// files it read, i.e. the main file and every header it includes, directly or
+// not. The graph is stored as a JSON file and updated by each run, so that a
+// later run can find the translation units affected by a change.
+class IncludeGraph {
+public:
+  // Read the graph from Path. A missing file gives an empty graph.
+  static llvm::Expected<IncludeGraph> load(llvm::StringRef Path);
+
+  // Write the graph to Path, replacing the file atomically
+  llvm::Error save(llvm::StringRef Path) const;
+
+  // Replace the files read by the translation unit File. An empty list means
+  // they are not known, e.g. because the file did not compile.
+  void setDependencies(llvm::StringRef File,
+                       llvm::ArrayRef<std::string> Dependencies);
+
+  // Return the files of Files that include one of the Changed files, or whose
+  // dependencies are not known, in the order of Files
+  std::vector<std::string>
+  getAffected(llvm::ArrayRef<std::string> Files,
+              const llvm::StringSet<> &Changed) const;
+
+private:
+  llvm::StringMap<std::vector<std::string>> Units;
+};
+
+// Return the absolute paths of the files that differ between the git revision
+// Rev and the working tree of the repository containing the current directory
+llvm::Expected<llvm::StringSet<>> getChangedFiles(llvm::StringRef Rev);
+
+// Absolute path of File without . and .. components, the form used for all
+// the paths in the graph
+std::string getCanonicalPath(llvm::StringRef File);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_INCLUDEGRAPH_H
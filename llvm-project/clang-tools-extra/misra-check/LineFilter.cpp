@@ -0,0 +1,282 @@
+// Restrict the checks to some lines of some files, e.g. the lines of a diff
+#include "LineFilter.h"
+#include "Git.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/Basic/DiagnosticIDs.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <climits>
+
+using namespace clang;
+using namespace llvm;
+
+namespace misra {
+
+// The key of a file in the filter: its real path if it exists, otherwise its
+// absolute path without . and .. components
+static std::string getFilterKey(StringRef File) {
+  SmallString<256> Path(File);
+  sys::fs::make_absolute(Path);
+  sys::path::remove_dots(Path, /*remove_dot_dot=*/true);
+  SmallString<256> RealPath;
+  if (!sys::fs::real_path(Path, RealPath))
+    return std::string(RealPath.str());
+  return std::string(Path.str());
+}
+
+// The key of a file read by the compiler
+static StringRef getFilterKey(const FileEntry *File) {
+  StringRef RealPath = File->tryGetRealPathName();
+  return RealPath.empty() ? File->getName() : RealPath;
+}
+
+Expected<LineFilter> LineFilter::parseJSON(StringRef JSON) {
+  Expected<json::Value> Root = json::parse(JSON);
+  if (!Root)
+    return Root.takeError();
+
+  auto Invalid = [](const char *Message) {
+    return createStringError(inconvertibleErrorCode(),
+                             "invalid line filter: %s", Message);
+  };
+  const json::Array *Entries = Root->getAsArray();
+  if (!Entries)
+    return Invalid("expected an array");
+
+  LineFilter Filter;
+  for (const json::Value &Entry : *Entries) {
+    const json::Object *Object = Entry.getAsObject();
+    Optional<StringRef> Name = Object ? Object->getString("name") : None;
+    if (!Name)
+      return Invalid("expected {\"name\": ..., \"lines\": ...}");
+
+    const json::Array *Lines = Object->getArray("lines");
+    if (!Lines) {
+      Filter.add(*Name, 1, UINT_MAX);
+      continue;
+    }
+    for (const json::Value &Range : *Lines) {
+      const json::Array *Pair = Range.getAsArray();
+      Optional<int64_t> First, Last;
+      if (Pair && Pair->size() == 2) {
+        First = (*Pair)[0].getAsInteger();
+        Last = (*Pair)[1].getAsInteger();
+      }
+      if (!First || !Last || *First < 1 || *Last < *First)
+        return Invalid("expected a range [first, last] of lines");
+      Filter.add(*Name, *First, *Last);
+    }
+  }
+  Filter.normalize();
+  return std::move(Filter);
+}
+
+Expected<LineFilter> LineFilter::fromGitDiff(StringRef Rev) {
+  Expected<std::string> Root = getGitTopLevel();
+  if (!Root)
+    return Root.takeError();
+  // Without context lines, every hunk only covers changed lines
+  Expected<std::string> Diff =
+      runGit({"diff", "-U0", "--no-color", "--no-ext-diff", "--src-prefix=a/",
+              "--dst-prefix=b/", Rev, "--"});
+  if (!Diff)
+    return Diff.takeError();
+
+  LineFilter Filter;
+  std::string File;
+  // The "+++" line is only a file name in the header of a file, inside a hunk
+  // it is an added line that starts with "++"
+  bool InHeader = false;
+  SmallVector<StringRef, 0> Lines;
+  StringRef(*Diff).split(Lines, '\n');
+  for (StringRef Line : Lines) {
+    if (Line.startswith("diff --git ")) {
+      InHeader = true;
+      File.clear();
+      continue;
+    }
+    if (InHeader && Line.consume_front("+++ ")) {
+      // Deleted files are "/dev/null", file names with unusual characters
+      // are quoted and skipped
+      if (Line.consume_front("b/")) {
+        SmallString<256> Path(*Root);
+        sys::path::append(Path, Line);
+        File = getFilterKey(Path);
+      }
+      continue;
+    }
+    // @@ -<old first>[,<old count>] +<first>[,<count>] @@
+    if (!Line.consume_front("@@ "))
+      continue;
+    InHeader = false;
+    if (File.empty())
+      continue;
+    StringRef New = Line.split(" +").second.split(' ').first;
+    StringRef FirstStr, CountStr;
+    std::tie(FirstStr, CountStr) = New.split(',');
+    unsigned First, Count = 1;
+    if (FirstStr.getAsInteger(10, First) ||
+        (!CountStr.empty() && CountStr.getAsInteger(10, Count)))
+      continue;
+    if (Count == 0)
+      // Lines were only removed, after line First: select the lines around
+      Filter.Files[File].push_back({std::max(First, 1u), First + 1});
+    else
+      Filter.Files[File].push_back({First, First + Count - 1});
+  }
+  Filter.normalize();
+  return std::move(Filter);
+}
+
+void LineFilter::add(StringRef File, unsigned First, unsigned Last) {
+  Files[getFilterKey(File)].push_back({First, Last});
+}
+
+void LineFilter::normalize() {
+  for (auto &File : Files) {
+    std::vector<LineRange> &Ranges = File.second;
+    llvm::sort(Ranges);
+    std::vector<LineRange> Merged;
+    for (const LineRange &Range : Ranges) {
+      if (!Merged.empty() && Range.first <= Merged.back().second + 1)
+        Merged.back().second = std::max(Merged.back().second, Range.second);
+      else
+        Merged.push_back(Range);
+    }
+    Ranges = std::move(Merged);
+  }
+}
+
+const std::vector<LineFilter::LineRange> *
+LineFilter::getRanges(StringRef RealPath) const {
+  auto It = Files.find(RealPath);
+  if (It == Files.end() || It->second.empty())
+    return nullptr;
+  return &It->second;
+}
+
+bool LineFilter::overlaps(const std::vector<LineRange> &Ranges,
+                          unsigned First, unsigned Last) {
+  // The first range that ends at or after First
+  auto It = std::lower_bound(Ranges.begin(), Ranges.end(), First,
+                             [](const LineRange &Range, unsigned Line) {
+                               return Range.second < Line;
+                             });
+  return It != Ranges.end() && It->first <= Last;
+}
+
+std::string LineFilter::str() const {
+  std::vector<StringRef> Names;
+  for (const auto &File : Files)
+    Names.push_back(File.first());
+  llvm::sort(Names);
+
+  std::string Result;
+  raw_string_ostream OS(Result);
+  for (StringRef Name : Names) {
+    OS << Name << ':';
+    for (const LineRange &Range : Files.find(Name)->second)
+      OS << Range.first << '-' << Range.second << ',';
+    OS << '\n';
+  }
+  return OS.str();
+}
+
+void LineFilterDiagnosticConsumer::HandleDiagnostic(
+    DiagnosticsEngine::Level Level, const Diagnostic &Info) {
+  if (!DiagnosticIDs::isBuiltinDiag(Info.getID()) && Info.hasSourceManager() &&
+      Info.getLocation().isValid()) {
+    const SourceManager &SM = Info.getSourceManager();
+    SourceLocation Loc = SM.getExpansionLoc(Info.getLocation());
+    const FileEntry *File = SM.getFileEntryForID(SM.getFileID(Loc));
+    const std::vector<LineFilter::LineRange> *Ranges =
+        File ? Filter.getRanges(getFilterKey(File)) : nullptr;
+    unsigned Line = SM.getExpansionLineNumber(Loc);
+    if (!Ranges || !LineFilter::overlaps(*Ranges, Line, Line))
+      return;
+  }
+  // Only the diagnostics that are passed on count for the exit status
+  DiagnosticConsumer::HandleDiagnostic(Level, Info);
+  ForwardingDiagnosticConsumer::HandleDiagnostic(Level, Info);
+}
+
+namespace {
+
+class LineFilterASTConsumer : public ASTConsumer {
+public:
+  LineFilterASTConsumer(std::unique_ptr<ASTConsumer> Inner,
+                        const LineFilter &Filter)
+      : Inner(std::move(Inner)), Filter(Filter) {}
+
+  bool HandleTopLevelDecl(DeclGroupRef DG) override {
+    TopLevelDecls.insert(TopLevelDecls.end(), DG.begin(), DG.end());
+    return Inner->HandleTopLevelDecl(DG);
+  }
+
+  void HandleTranslationUnit(ASTContext &Context) override {
+    std::vector<Decl *> Scope;
+    for (Decl *D : TopLevelDecls)
+      select(D, Context.getSourceManager(), Scope);
+    // Every AST traversal of Inner, including the one of the matchers, only
+    // visits the selected declarations. The checks that run on the whole
+    // translation unit get the scope they had back.
+    std::vector<Decl *> Previous = Context.getTraversalScope();
+    Context.setTraversalScope(Scope);
+    Inner->HandleTranslationUnit(Context);
+    Context.setTraversalScope(Previous);
+  }
+
+private:
+  // Add D to Scope if it overlaps the lines of the filter
+  void select(Decl *D, const SourceManager &SM, std::vector<Decl *> &Scope) {
+    if (isa<NamespaceDecl>(D) || isa<LinkageSpecDecl>(D)) {
+      for (Decl *Child : cast<DeclContext>(D)->decls())
+        select(Child, SM, Scope);
+      return;
+    }
+
+    SourceLocation Begin = SM.getExpansionLoc(D->getBeginLoc());
+    SourceLocation End = SM.getExpansionRange(D->getEndLoc()).getEnd();
+    FileID FID = SM.getFileID(Begin);
+    const std::vector<LineFilter::LineRange> *Ranges = getRanges(SM, FID);
+    if (!Ranges)
+      return;
+    unsigned First = SM.getExpansionLineNumber(Begin);
+    unsigned Last = SM.getFileID(End) == FID ? SM.getExpansionLineNumber(End)
+                                             : UINT_MAX;
+    if (LineFilter::overlaps(*Ranges, First, Last))
+      Scope.push_back(D);
+  }
+
+  // The ranges of a file, looked up once per file
+  const std::vector<LineFilter::LineRange> *getRanges(const SourceManager &SM,
+                                                      FileID FID) {
+    auto Inserted = RangesOfFile.insert({FID, nullptr});
+    if (Inserted.second)
+      if (const FileEntry *File = SM.getFileEntryForID(FID))
+        Inserted.first->second = Filter.getRanges(getFilterKey(File));
+    return Inserted.first->second;
+  }
+
+  std::unique_ptr<ASTConsumer> Inner;
+  const LineFilter &Filter;
+  std::vector<Decl *> TopLevelDecls;
+  DenseMap<FileID, const std::vector<LineFilter::LineRange> *> RangesOfFile;
+};
+
+} // namespace
+
+std::unique_ptr<ASTConsumer>
+newLineFilterASTConsumer(std::unique_ptr<ASTConsumer> Inner,
+                         const LineFilter &Filter) {
+  return std::make_unique<LineFilterASTConsumer>(std::move(Inner), Filter);
+}
+
+} // namespace misra
@@ -0,0 +1,89 @@
+// Restrict the checks to some lines of some files, e.g. the lines of a diff
+#ifndef MISRA_CHECK_LINEFILTER_H
+#define MISRA_CHECK_LINEFILTER_H
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/Basic/Diagnostic.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace misra {
+
+// Sets of line ranges, keyed by the real path of the file. Files that are not
+// in the filter have no selected lines at all.
+class LineFilter {
+public:
+  typedef std::pair<unsigned, unsigned> LineRange;
+
+  // Parse a filter in the format of clang-tidy's -line-filter option:
+  //   [{"name": "file.cpp", "lines": [[1, 3], [5, 7]]}, {"name": "file.h"}]
+  // A file without "lines" is selected as a whole.
+  static llvm::Expected<LineFilter> parseJSON(llvm::StringRef JSON);
+
+  // Select the lines added or changed since the git revision Rev, including
+  // the uncommitted changes
+  static llvm::Expected<LineFilter> fromGitDiff(llvm::StringRef Rev);
+
+  // Add the lines First to Last of File
+  void add(llvm::StringRef File, unsigned First, unsigned Last);
+
+  // Return the sorted, non overlapping ranges of a file given by its real
+  // path, or null if none of its lines is selected
+  const std::vector<LineRange> *getRanges(llvm::StringRef RealPath) const;
+
+  // Return true if one of Ranges intersects the lines First to Last
+  static bool overlaps(const std::vector<LineRange> &Ranges, unsigned First,
+                       unsigned Last);
+
+  // A description of the whole filter that only depends on the selected lines
+  std::string str() const;
+
+private:
+  // Sort and merge the ranges of every file
+  void normalize();
+
+  llvm::StringMap<std::vector<LineRange>> Files;
+};
+
+// Only pass on the rule diagnostics, i.e. those with a custom diagnostic ID,
+// that are in the lines of Filter. The compiler diagnostics are always passed
+// on.
+class LineFilterDiagnosticConsumer
+    : public clang::ForwardingDiagnosticConsumer {
+public:
+  LineFilterDiagnosticConsumer(clang::DiagnosticConsumer &Target,
+                               const LineFilter &Filter)
+      : ForwardingDiagnosticConsumer(Target), Target(Target), Filter(Filter) {}
+
+  void HandleDiagnostic(clang::DiagnosticsEngine::Level Level,
+                        const clang::Diagnostic &Info) override;
+
+  // Passed on too, the text printer needs the language options of the file
+  void BeginSourceFile(const clang::LangOptions &LangOpts,
+                       const clang::Preprocessor *PP) override {
+    Target.BeginSourceFile(LangOpts, PP);
+  }
+  void EndSourceFile() override { Target.EndSourceFile(); }
+
+private:
+  clang::DiagnosticConsumer &Target;
+  const LineFilter &Filter;
+};
+
+// Wrap an AST consumer so that it only traverses the top level declarations
+// that overlap the lines of Filter. Namespaces and linkage specifications are
+// looked into rather than taken as a whole. The traversal scope is put back
+// once the consumer is done, for the checks that need the whole translation
+// unit; their violations are only dropped by LineFilterDiagnosticConsumer.
+std::unique_ptr<clang::ASTConsumer>
+newLineFilterASTConsumer(std::unique_ptr<clang::ASTConsumer> Inner,
+                         const LineFilter &Filter);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_LINEFILTER_H
@@ -0,0 +1,162 @@
+// Frontend action shared by the AST rules and the token rules
+#include "MisraCheckAction.h"
+#include "LineFilter.h"
+#include "ParallelChecks.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/MultiplexConsumer.h"
+#include "clang/Lex/Preprocessor.h"
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace misra {
+
+bool MisraCheckAction::BeginSourceFileAction(CompilerInstance &CI) {
+  TokenRules = addTokenPatterns(TokenRules, Patterns);
+  if (TokenRules.empty())
+    return true;
+
+  Preprocessor &PP = CI.getPreprocessor();
+  for (TokenRule *Rule : TokenRules)
+    Rule->startTranslationUnit(PP);
+
+  // The token watcher sees every token of the expanded token stream exactly
+  // once, in the same order as a plain Lex() loop over the file would
+  PP.setTokenWatcher([this, &PP](const Token &Tok) {
+    if (Tok.isAnnotation())
+      return;
+    for (TokenRule *Rule : TokenRules)
+      Rule->handleToken(Tok, PP);
+  });
+  return true;
+}
+
+namespace {
+
+// Ends the token rules once the parser has consumed all the tokens, before
+// the diagnostic consumer leaves the source file
+class EndTokenRulesConsumer : public ASTConsumer {
+public:
+  EndTokenRulesConsumer(ArrayRef<TokenRule *> TokenRules, Preprocessor &PP)
+      : TokenRules(TokenRules), PP(PP) {}
+
+  void HandleTranslationUnit(ASTContext &Context) override {
+    for (TokenRule *Rule : TokenRules)
+      Rule->endTranslationUnit(PP);
+  }
+
+private:
+  ArrayRef<TokenRule *> TokenRules;
+  Preprocessor &PP;
+};
+
+// The AST checks of Rules: the operators are visited first, then the rules
+// with their own traversal run, then the matchers, and their violations come
+// in the same order
+std::unique_ptr<ASTConsumer> newASTChecksConsumer(MatchFinder &Finder,
+                                                  OperatorVisitor &Operators,
+                                                  ArrayRef<ASTRule *> Rules) {
+  std::vector<std::unique_ptr<ASTConsumer>> ASTChecks;
+  if (!Operators.empty())
+    ASTChecks.push_back(Operators.newASTConsumer());
+  for (ASTRule *Rule : Rules)
+    if (std::unique_ptr<ASTConsumer> Consumer = Rule->newASTConsumer())
+      ASTChecks.push_back(std::move(Consumer));
+  ASTChecks.push_back(Finder.newASTConsumer());
+  if (ASTChecks.size() == 1)
+    return std::move(ASTChecks.front());
+  return std::make_unique<MultiplexConsumer>(std::move(ASTChecks));
+}
+
+} // namespace
+
+std::unique_ptr<ASTConsumer>
+MisraCheckAction::CreateASTConsumer(CompilerInstance &CI, StringRef InFile) {
+  std::unique_ptr<ASTConsumer> Matchers =
+      newASTChecksConsumer(Finder, Operators, ASTRules);
+  std::unique_ptr<ASTConsumer> WholeTUMatchers;
+  if (WholeTU && !WholeTU->Rules.empty())
+    WholeTUMatchers = newASTChecksConsumer(WholeTU->Finder, WholeTU->Operators,
+                                           WholeTU->Rules);
+  if (TUJobs > 1) {
+    // The line filter chooses the declarations that are split, the checks of
+    // the whole translation unit ignore the traversal scope
+    Matchers = newParallelASTConsumer(std::move(Matchers),
+                                      std::move(WholeTUMatchers), TUJobs);
+    if (Filter)
+      Matchers = newLineFilterASTConsumer(std::move(Matchers), *Filter);
+  } else {
+    if (Filter)
+      Matchers = newLineFilterASTConsumer(std::move(Matchers), *Filter);
+    // The line filter puts the traversal scope back once its checks ran, so
+    // the order of the two does not matter
+    if (WholeTUMatchers) {
+      std::vector<std::unique_ptr<ASTConsumer>> Checks;
+      Checks.push_back(std::move(WholeTUMatchers));
+      Checks.push_back(std::move(Matchers));
+      Matchers = std::make_unique<MultiplexConsumer>(std::move(Checks));
+    }
+  }
+  if (TokenRules.empty())
+    return Matchers;
+
+  // The violations of the token rules are reported before those of the AST
+  // rules, as when the token rules reported them while lexing
+  std::vector<std::unique_ptr<ASTConsumer>> Consumers;
+  Consumers.push_back(std::make_unique<EndTokenRulesConsumer>(
+      TokenRules, CI.getPreprocessor()));
+  Consumers.push_back(std::move(Matchers));
+  return std::make_unique<MultiplexConsumer>(std::move(Consumers));
+}
+
+namespace {
+class MisraCheckActionFactory : public FrontendActionFactory {
+public:
+  MisraCheckActionFactory(MatchFinder &Finder, OperatorVisitor &Operators,
+                          ArrayRef<ASTRule *> ASTRules,
+                          ArrayRef<TokenRule *> TokenRules,
+                          TokenAutomaton *Automaton, const LineFilter *Filter,
+                          const WholeTUChecks *WholeTU, unsigned TUJobs)
+      : Finder(Finder), Operators(Operators),
+        ASTRules(ASTRules.begin(), ASTRules.end()),
+        TokenRules(TokenRules.begin(), TokenRules.end()), Automaton(Automaton),
+        Filter(Filter), WholeTU(WholeTU), TUJobs(TUJobs) {
+    if (!Automaton) {
+      OwnedAutomaton = std::make_unique<TokenAutomaton>();
+      this->Automaton = OwnedAutomaton.get();
+    }
+  }
+
+  std::unique_ptr<FrontendAction> create() override {
+    return std::make_unique<MisraCheckAction>(Finder, Operators, ASTRules,
+                                              TokenRules, *Automaton, Filter,
+                                              WholeTU, TUJobs);
+  }
+
+private:
+  MatchFinder &Finder;
+  OperatorVisitor &Operators;
+  std::vector<ASTRule *> ASTRules;
+  std::vector<TokenRule *> TokenRules;
+  TokenAutomaton *Automaton;
+  std::unique_ptr<TokenAutomaton> OwnedAutomaton;
+  const LineFilter *Filter;
+  const WholeTUChecks *WholeTU;
+  unsigned TUJobs;
+};
+} // namespace
+
+std::unique_ptr<FrontendActionFactory>
+newMisraCheckActionFactory(MatchFinder &Finder, OperatorVisitor &Operators,
+                           ArrayRef<ASTRule *> ASTRules,
+                           ArrayRef<TokenRule *> TokenRules,
+                           TokenAutomaton *Automaton, const LineFilter *Filter,
+                           const WholeTUChecks *WholeTU, unsigned TUJobs) {
+  return std::make_unique<MisraCheckActionFactory>(Finder, Operators, ASTRules,
+                                                   TokenRules, Automaton,
+                                                   Filter, WholeTU, TUJobs);
+}
+
+} // namespace misra
@@ -0,0 +1,85 @@
+// Frontend action which runs the AST rules and the token rules in one parse
+#ifndef MISRA_CHECK_MISRACHECKACTION_H
+#define MISRA_CHECK_MISRACHECKACTION_H
+
+#include "MisraRule.h"
+#include "OperatorVisitor.h"
+#include "TokenPattern.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Tooling/Tooling.h"
+#include <memory>
+#include <vector>
+
+namespace misra {
+
+class LineFilter;
+
+// The AST checks of the rules whose violations may depend on more than one
+// top level declaration. MisraCheckAction keeps them apart from the others so
+// that they always run on the whole translation unit, whatever the line
+// filter and however the other checks are split over workers.
+struct WholeTUChecks {
+  clang::ast_matchers::MatchFinder &Finder;
+  OperatorVisitor &Operators;
+  std::vector<ASTRule *> Rules;
+};
+
+// Build the AST for the matchers of Finder, the operator checks of Operators
+// and the consumers of the AST rules and, while the preprocessor lexes the
+// input for the parser, give every token to the token rules as well. This way
+// a translation unit is preprocessed and parsed only once for all rules. With
+// a line filter, the AST checks only traverse the top level declarations that
+// overlap its lines, except those of WholeTU. With TUJobs above 1, they run in
+// that many worker processes (see ParallelChecks.h).
+class MisraCheckAction : public clang::ASTFrontendAction {
+public:
+  MisraCheckAction(clang::ast_matchers::MatchFinder &Finder,
+                   OperatorVisitor &Operators,
+                   llvm::ArrayRef<ASTRule *> ASTRules,
+                   llvm::ArrayRef<TokenRule *> TokenRules,
+                   TokenAutomaton &Automaton,
+                   const LineFilter *Filter = nullptr,
+                   const WholeTUChecks *WholeTU = nullptr,
+                   unsigned TUJobs = 1)
+      : Finder(Finder), Operators(Operators),
+        ASTRules(ASTRules.begin(), ASTRules.end()),
+        TokenRules(TokenRules.begin(), TokenRules.end()), Filter(Filter),
+        WholeTU(WholeTU), TUJobs(TUJobs), Patterns(Automaton) {}
+
+protected:
+  bool BeginSourceFileAction(clang::CompilerInstance &CI) override;
+
+  std::unique_ptr<clang::ASTConsumer>
+  CreateASTConsumer(clang::CompilerInstance &CI,
+                    llvm::StringRef InFile) override;
+
+private:
+  clang::ast_matchers::MatchFinder &Finder;
+  OperatorVisitor &Operators;
+  std::vector<ASTRule *> ASTRules;
+  std::vector<TokenRule *> TokenRules;
+  const LineFilter *Filter;
+  const WholeTUChecks *WholeTU;
+  unsigned TUJobs;
+  // Runs the patterns of the token rules on the automaton of the run
+  TokenPatternSet Patterns;
+};
+
+// Create a factory for ClangTool::run that runs MisraCheckAction. Finder,
+// Operators, the rules, Automaton, the filter and WholeTU are not owned by
+// the factory and must outlive it. Without an automaton, the factory makes
+// one for all its actions.
+std::unique_ptr<clang::tooling::FrontendActionFactory>
+newMisraCheckActionFactory(clang::ast_matchers::MatchFinder &Finder,
+                           OperatorVisitor &Operators,
+                           llvm::ArrayRef<ASTRule *> ASTRules,
+                           llvm::ArrayRef<TokenRule *> TokenRules,
+                           TokenAutomaton *Automaton = nullptr,
+                           const LineFilter *Filter = nullptr,
+                           const WholeTUChecks *WholeTU = nullptr,
+                           unsigned TUJobs = 1);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_MISRACHECKACTION_H
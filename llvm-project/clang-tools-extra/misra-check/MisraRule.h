@@ -0,0 +1,160 @@
+// Shared interface between the MISRA rule checkers and the misra-check driver
+#ifndef MISRA_CHECK_MISRARULE_H
+#define MISRA_CHECK_MISRARULE_H
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Lex/Token.h"
+#include "llvm/ADT/ArrayRef.h"
+#include <memory>
+
+namespace misra {
+
+class OperatorVisitor;
+class TokenPatternSet;
+
+// Base class for every rule that is checked on the AST. A rule owns its match
+// callbacks and adds its matchers to a MatchFinder that is shared with the
+// other rules, so that all of them run in one AST traversal. The checks of
+// the built-in operators are added to an OperatorVisitor instead, which
+// dispatches each operator to its checks by opcode. A rule that cannot be
+// expressed with either, without building the parent map of the AST or
+// searching the same subtrees again and again, walks the AST itself with its
+// own consumer.
+class ASTRule {
+public:
+  virtual ~ASTRule() = default;
+
+  // Add the matchers of the rule, together with their callbacks, to Finder
+  virtual void registerMatchers(clang::ast_matchers::MatchFinder &Finder) {}
+
+  // Add the operator checks of the rule to Visitor
+  virtual void registerOperatorChecks(OperatorVisitor &Visitor) {}
+
+  // Create a consumer that checks one translation unit, if the rule has its
+  // own traversal of the AST. It is called for every translation unit, and
+  // the consumer must only traverse the traversal scope of the ASTContext.
+  virtual std::unique_ptr<clang::ASTConsumer> newASTConsumer() {
+    return nullptr;
+  }
+};
+
+// Base class for every rule that is checked on the preprocessed token
+// stream. The tokens of a translation unit are lexed once and handed to each
+// token rule in turn, so a rule keeps whatever state it needs between tokens
+// in its own members. With --raw-lex the rule is given the raw tokens of the
+// main file instead, and a preprocessor that only has its source manager,
+// diagnostics and identifiers set up (see RawTokenLexer.h). A rule that
+// looks for sequences of tokens should rather declare them as token patterns,
+// which are run together with those of the other rules.
+class TokenRule {
+public:
+  virtual ~TokenRule() = default;
+
+  // Add the token patterns of the rule, together with their callbacks, to
+  // Patterns (see TokenPattern.h)
+  virtual void registerPatterns(TokenPatternSet &Patterns) {}
+
+  // Called before the first token of each translation unit, reset the state
+  // of the rule here
+  virtual void startTranslationUnit(clang::Preprocessor &PP) {}
+
+  // Called for every token of the translation unit, in order
+  virtual void handleToken(const clang::Token &Tok, clang::Preprocessor &PP) {
+  }
+
+  // Called after the last token of each translation unit, while diagnostics
+  // can still be reported. Report the recorded violations here.
+  virtual void endTranslationUnit(clang::Preprocessor &PP) {}
+};
+
+// Features of the source text of a translation unit, found by a cheap scan
+// of the text of the file and of its headers (see Prefilter.h). A rule that
+// can only report a violation when the text has some of them is not run on
+// the translation units whose text does not have them all.
+enum SourceFeature : unsigned {
+  // The typedef keyword
+  SF_Typedef = 1 << 0,
+  // The enum keyword
+  SF_Enum = 1 << 1,
+  // A floating type or literal, or a builtin that may return one
+  SF_Floating = 1 << 2,
+  // The unsigned keyword
+  SF_Unsigned = 1 << 3,
+  // An if, while, for or do statement, or a logical operator
+  SF_Condition = 1 << 4,
+  // The operators !, && or ||
+  SF_Logical = 1 << 5,
+  // The operators &, |, ^, ~, << or >>
+  SF_Bitwise = 1 << 6,
+  // The operator ?
+  SF_Conditional = 1 << 7,
+  // The operator -
+  SF_Minus = 1 << 8,
+  // A number of two characters or more starting with 0, e.g. 017 or 0x1F
+  SF_ZeroPrefixedNumber = 1 << 9,
+  // A number starting with 0x or 0X
+  SF_HexNumber = 1 << 10,
+  // A number ending with a lower case letter, e.g. 3u or 0xff
+  SF_LowerCaseEnd = 1 << 11,
+  SF_All = (1 << 12) - 1,
+  // The features that only numbers have
+  SF_Numbers = SF_ZeroPrefixedNumber | SF_HexNumber | SF_LowerCaseEnd
+};
+
+// The languages of the translation units a rule is run on
+enum RuleLanguage : unsigned {
+  RL_C = 1 << 0,
+  RL_CXX = 1 << 1
+};
+
+// An entry in the table of rules known to the driver
+struct ASTRuleInfo {
+  // Rule number as given to --rules=, e.g. "2.10.3"
+  const char *Name;
+  // Create a new instance of the rule
+  std::unique_ptr<ASTRule> (*Create)();
+  // The SourceFeatures that the text of a translation unit must all have
+  // for the rule to find a violation in it, none if it may always find one
+  unsigned Requires = 0;
+  // The RuleLanguages the rule applies to. The MISRA C++ rules are not run
+  // on C files.
+  unsigned Languages = RL_CXX;
+  // True if a violation may depend on more than one top level declaration,
+  // e.g. on names declared anywhere in the translation unit. With --tu-jobs
+  // or a line filter such a rule is still checked on the whole translation
+  // unit, the others on parts of it.
+  bool WholeTranslationUnit = false;
+};
+
+struct TokenRuleInfo {
+  const char *Name;
+  std::unique_ptr<TokenRule> (*Create)();
+  unsigned Requires = 0;
+  unsigned Languages = RL_CXX;
+};
+
+// Return the tables of all AST rules and all token rules
+llvm::ArrayRef<ASTRuleInfo> getASTRules();
+llvm::ArrayRef<TokenRuleInfo> getTokenRules();
+
+// Factory functions, each one defined in the source file of its rule
+std::unique_ptr<ASTRule> createRule2_10_3();
+std::unique_ptr<ASTRule> createRule4_5_1();
+std::unique_ptr<ASTRule> createRule4_5_2();
+std::unique_ptr<ASTRule> createRule5_0_5();
+std::unique_ptr<ASTRule> createRule5_0_13();
+std::unique_ptr<ASTRule> createRule5_0_14();
+std::unique_ptr<ASTRule> createRule5_0_21();
+std::unique_ptr<ASTRule> createRule5_3_1();
+std::unique_ptr<ASTRule> createRule5_3_2();
+std::unique_ptr<TokenRule> createRule2_13_2();
+std::unique_ptr<TokenRule> createRule2_13_3();
+std::unique_ptr<TokenRule> createRule2_13_4();
+std::unique_ptr<TokenRule> createRule3_9_3();
+std::unique_ptr<TokenRule> createRule7_1();
+
+} // namespace misra
+
+#endif // MISRA_CHECK_MISRARULE_H
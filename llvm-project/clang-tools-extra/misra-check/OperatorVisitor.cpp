@@ -0,0 +1,163 @@
+// Single traversal of the built-in operators shared by the operator rules
+#include "OperatorVisitor.h"
+#include "Profile.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/TimeProfiler.h"
+#include <chrono>
+
+using namespace clang;
+using namespace llvm;
+
+namespace misra {
+
+OperandInfo::OperandInfo(const Expr *E)
+    : E(E), Type(E->getType()), Written(E->IgnoreParenImpCasts()),
+      WrittenType(Written->getType()),
+      IsSignedInteger(Type->isSignedIntegerType()),
+      IsUnsignedInteger(Type->isUnsignedIntegerType()),
+      WrittenIsBool(WrittenType->isBooleanType()),
+      WrittenIsEnum(WrittenType->isEnumeralType()) {}
+
+OperatorVisitor::OperatorVisitor()
+    : BinaryChecks(BO_Comma + 1), UnaryChecks(UO_Coawait + 1) {}
+
+void OperatorVisitor::addCheck(OperatorCheck *Check) {
+  if (!is_contained(Checks, Check))
+    Checks.push_back(Check);
+}
+
+void OperatorVisitor::addBinaryCheck(ArrayRef<BinaryOperatorKind> Opcodes,
+                                     OperatorCheck *Check) {
+  for (BinaryOperatorKind Opcode : Opcodes)
+    BinaryChecks[Opcode].push_back(Check);
+  addCheck(Check);
+}
+
+void OperatorVisitor::addBinaryCheckExcept(ArrayRef<BinaryOperatorKind> Opcodes,
+                                           OperatorCheck *Check) {
+  for (unsigned Opcode = 0; Opcode < BinaryChecks.size(); ++Opcode)
+    if (!is_contained(Opcodes, BinaryOperatorKind(Opcode)))
+      BinaryChecks[Opcode].push_back(Check);
+  addCheck(Check);
+}
+
+void OperatorVisitor::addUnaryCheck(ArrayRef<UnaryOperatorKind> Opcodes,
+                                    OperatorCheck *Check) {
+  for (UnaryOperatorKind Opcode : Opcodes)
+    UnaryChecks[Opcode].push_back(Check);
+  addCheck(Check);
+}
+
+void OperatorVisitor::addUnaryCheckExcept(ArrayRef<UnaryOperatorKind> Opcodes,
+                                          OperatorCheck *Check) {
+  for (unsigned Opcode = 0; Opcode < UnaryChecks.size(); ++Opcode)
+    if (!is_contained(Opcodes, UnaryOperatorKind(Opcode)))
+      UnaryChecks[Opcode].push_back(Check);
+  addCheck(Check);
+}
+
+void OperatorVisitor::visitBinary(const BinaryOperator &Op,
+                                  ASTContext &Context) {
+  const std::vector<OperatorCheck *> &OpChecks = BinaryChecks[Op.getOpcode()];
+  if (OpChecks.empty())
+    return;
+  OperandInfo LHS(Op.getLHS());
+  OperandInfo RHS(Op.getRHS());
+  if (ProfileSeconds) {
+    for (OperatorCheck *Check : OpChecks) {
+      auto Start = std::chrono::steady_clock::now();
+      Check->checkBinary(Op, LHS, RHS, Context);
+      CheckSeconds[Check] += secondsSince(Start);
+    }
+    return;
+  }
+  for (OperatorCheck *Check : OpChecks)
+    Check->checkBinary(Op, LHS, RHS, Context);
+}
+
+void OperatorVisitor::visitUnary(const UnaryOperator &Op,
+                                 ASTContext &Context) {
+  const std::vector<OperatorCheck *> &OpChecks = UnaryChecks[Op.getOpcode()];
+  if (OpChecks.empty())
+    return;
+  OperandInfo Operand(Op.getSubExpr());
+  if (ProfileSeconds) {
+    for (OperatorCheck *Check : OpChecks) {
+      auto Start = std::chrono::steady_clock::now();
+      Check->checkUnary(Op, Operand, Context);
+      CheckSeconds[Check] += secondsSince(Start);
+    }
+    return;
+  }
+  for (OperatorCheck *Check : OpChecks)
+    Check->checkUnary(Op, Operand, Context);
+}
+
+namespace {
+
+class OperatorASTVisitor : public RecursiveASTVisitor<OperatorASTVisitor> {
+public:
+  OperatorASTVisitor(OperatorVisitor &Visitor, ASTContext &Context)
+      : Visitor(Visitor), Context(Context) {}
+
+  // Visit the same nodes as a MatchFinder does
+  bool shouldVisitTemplateInstantiations() const { return true; }
+  bool shouldVisitImplicitCode() const { return true; }
+
+  // Also called for the compound assignments, which derive from
+  // BinaryOperator
+  bool VisitBinaryOperator(BinaryOperator *Op) {
+    Visitor.visitBinary(*Op, Context);
+    return true;
+  }
+
+  bool VisitUnaryOperator(UnaryOperator *Op) {
+    Visitor.visitUnary(*Op, Context);
+    return true;
+  }
+
+private:
+  OperatorVisitor &Visitor;
+  ASTContext &Context;
+};
+
+class OperatorASTConsumer : public ASTConsumer {
+public:
+  explicit OperatorASTConsumer(OperatorVisitor &Visitor) : Visitor(Visitor) {}
+
+  void HandleTranslationUnit(ASTContext &Context) override {
+    Visitor.run(Context);
+  }
+
+private:
+  OperatorVisitor &Visitor;
+};
+
+} // namespace
+
+void OperatorVisitor::run(ASTContext &Context) {
+  if (Checks.empty())
+    return;
+  TimeTraceScope TimeScope("Operator checks");
+  // TraverseAST only traverses the traversal scope of the context
+  OperatorASTVisitor(*this, Context).TraverseAST(Context);
+  for (OperatorCheck *Check : Checks) {
+    auto Start = std::chrono::steady_clock::now();
+    Check->endTranslationUnit(Context);
+    if (ProfileSeconds)
+      CheckSeconds[Check] += secondsSince(Start);
+  }
+
+  if (ProfileSeconds) {
+    for (const auto &Entry : CheckSeconds)
+      (*ProfileSeconds)[Entry.first->getID()] += Entry.second;
+    CheckSeconds.clear();
+  }
+}
+
+std::unique_ptr<ASTConsumer> OperatorVisitor::newASTConsumer() {
+  return std::make_unique<OperatorASTConsumer>(*this);
+}
+
+} // namespace misra
@@ -0,0 +1,118 @@
+// Single traversal of the built-in operators shared by the operator rules
+#ifndef MISRA_CHECK_OPERATORVISITOR_H
+#define MISRA_CHECK_OPERATORVISITOR_H
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/OperationKinds.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <memory>
+#include <vector>
+
+namespace misra {
+
+// An operand of a built-in operator, with the properties of its type that
+// the operator rules test. They are computed once per operator, whatever the
+// number of rules that look at it.
+struct OperandInfo {
+  // The operand as it is in the AST, after the implicit conversions
+  const clang::Expr *E;
+  clang::QualType Type;
+  // The operand as written, without parentheses and implicit casts
+  const clang::Expr *Written;
+  clang::QualType WrittenType;
+
+  // Properties of Type
+  bool IsSignedInteger;
+  bool IsUnsignedInteger;
+  // Properties of WrittenType
+  bool WrittenIsBool;
+  bool WrittenIsEnum;
+
+  explicit OperandInfo(const clang::Expr *E);
+};
+
+// The part of a rule that looks at built-in operators. The checks are called
+// by an OperatorVisitor for the opcodes they were added for.
+class OperatorCheck {
+public:
+  virtual ~OperatorCheck() = default;
+
+  virtual void checkBinary(const clang::BinaryOperator &Op,
+                           const OperandInfo &LHS, const OperandInfo &RHS,
+                           clang::ASTContext &Context) {}
+
+  virtual void checkUnary(const clang::UnaryOperator &Op,
+                          const OperandInfo &Operand,
+                          clang::ASTContext &Context) {}
+
+  // Called after the last operator of each translation unit. Report the
+  // recorded violations here.
+  virtual void endTranslationUnit(clang::ASTContext &Context) {}
+
+  // Name of the check in profiles, like MatchCallback::getID()
+  virtual llvm::StringRef getID() const { return "<unknown>"; }
+};
+
+// Visits every built-in unary and binary operator of a translation unit once,
+// including compound assignments, and calls the checks added for its opcode.
+// Rules that would otherwise each match nearly every operator with their own
+// matcher share this one traversal, and a table indexed by the opcode gives
+// the checks of each operator without any matching. Like a MatchFinder, it
+// visits template instantiations and implicit code, and only the traversal
+// scope of the ASTContext.
+class OperatorVisitor {
+public:
+  OperatorVisitor();
+
+  // Call Check for every binary operator with one of the given opcodes
+  void addBinaryCheck(llvm::ArrayRef<clang::BinaryOperatorKind> Opcodes,
+                      OperatorCheck *Check);
+  // Call Check for every binary operator, except those with the given
+  // opcodes
+  void addBinaryCheckExcept(llvm::ArrayRef<clang::BinaryOperatorKind> Opcodes,
+                            OperatorCheck *Check);
+  void addUnaryCheck(llvm::ArrayRef<clang::UnaryOperatorKind> Opcodes,
+                     OperatorCheck *Check);
+  void addUnaryCheckExcept(llvm::ArrayRef<clang::UnaryOperatorKind> Opcodes,
+                           OperatorCheck *Check);
+
+  // True if no check was added
+  bool empty() const { return Checks.empty(); }
+
+  // Time the checks, adding the seconds each one takes to Seconds[getID()]
+  // at the end of every translation unit
+  void enableProfiling(llvm::StringMap<double> &Seconds) {
+    ProfileSeconds = &Seconds;
+  }
+
+  // Visit the operators of Context and then end the translation unit of the
+  // checks
+  void run(clang::ASTContext &Context);
+
+  // Create an AST consumer that calls run() on the translation unit. The
+  // visitor is not owned by the consumer and must outlive it.
+  std::unique_ptr<clang::ASTConsumer> newASTConsumer();
+
+  void visitBinary(const clang::BinaryOperator &Op, clang::ASTContext &Context);
+  void visitUnary(const clang::UnaryOperator &Op, clang::ASTContext &Context);
+
+private:
+  void addCheck(OperatorCheck *Check);
+
+  std::vector<std::vector<OperatorCheck *>> BinaryChecks;
+  std::vector<std::vector<OperatorCheck *>> UnaryChecks;
+  // Every check, once, in the order they were added
+  std::vector<OperatorCheck *> Checks;
+  // Null unless profiling
+  llvm::StringMap<double> *ProfileSeconds = nullptr;
+  llvm::DenseMap<OperatorCheck *, double> CheckSeconds;
+};
+
+} // namespace misra
+
+#endif // MISRA_CHECK_OPERATORVISITOR_H
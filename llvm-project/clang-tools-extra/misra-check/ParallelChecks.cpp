@@ -0,0 +1,270 @@
+// Runs the AST checks of one translation unit in several worker processes
+#include "ParallelChecks.h"
+#include "WorkerPool.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/MultiplexConsumer.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Config/llvm-config.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace clang;
+using namespace llvm;
+
+namespace misra {
+
+namespace {
+
+// Records the diagnostics reported by the checks in a worker. Each one is a
+// line with its level, the raw encoding of its location and the size of its
+// text, followed by the text.
+class DiagnosticRecorder : public DiagnosticConsumer {
+public:
+  void HandleDiagnostic(DiagnosticsEngine::Level Level,
+                        const Diagnostic &Info) override {
+    DiagnosticConsumer::HandleDiagnostic(Level, Info);
+    SmallString<256> Message;
+    Info.FormatDiagnostic(Message);
+    Recorded += std::to_string(unsigned(Level)) + " " +
+                std::to_string(Info.getLocation().getRawEncoding()) + " " +
+                std::to_string(Message.size()) + "\n";
+    Recorded += Message.str();
+  }
+
+  std::string Recorded;
+};
+
+struct RecordedDiagnostic {
+  DiagnosticsEngine::Level Level;
+  SourceLocation Loc;
+  std::string Message;
+};
+
+// A diagnostic followed by its notes
+using DiagnosticGroup = std::vector<RecordedDiagnostic>;
+
+// Append the diagnostics recorded by a DiagnosticRecorder to Groups
+void decodeDiagnostics(StringRef Recorded,
+                       std::vector<DiagnosticGroup> &Groups) {
+  bool InGroup = false;
+  while (!Recorded.empty()) {
+    StringRef Line;
+    std::tie(Line, Recorded) = Recorded.split('\n');
+    SmallVector<StringRef, 3> Fields;
+    Line.split(Fields, ' ');
+    unsigned Level;
+    SourceLocation::UIntTy Loc;
+    size_t Size;
+    if (Fields.size() != 3 || Fields[0].getAsInteger(10, Level) ||
+        Fields[1].getAsInteger(10, Loc) || Fields[2].getAsInteger(10, Size) ||
+        Size > Recorded.size())
+      return;
+    RecordedDiagnostic Diagnostic{DiagnosticsEngine::Level(Level),
+                                  SourceLocation::getFromRawEncoding(Loc),
+                                  Recorded.take_front(Size).str()};
+    Recorded = Recorded.drop_front(Size);
+    if (Diagnostic.Level != DiagnosticsEngine::Note || !InGroup)
+      Groups.emplace_back();
+    Groups.back().push_back(std::move(Diagnostic));
+    InGroup = true;
+  }
+}
+
+// The declarations that the traversal of a DeclContext skips, since they are
+// traversed with the expression that declares them
+bool isTraversedWithExpression(const Decl *D) {
+  if (isa<BlockDecl>(D) || isa<CapturedDecl>(D))
+    return true;
+  if (const auto *Record = dyn_cast<CXXRecordDecl>(D))
+    return Record->isLambda();
+  return false;
+}
+
+// Add the declarations of Scope to Decls, with the translation unit, the
+// namespaces and the linkage specifications replaced by what they declare
+void addSplittableDecls(ArrayRef<Decl *> Scope, std::vector<Decl *> &Decls) {
+  for (Decl *D : Scope) {
+    if (!isa<TranslationUnitDecl>(D) && !isa<NamespaceDecl>(D) &&
+        !isa<LinkageSpecDecl>(D)) {
+      Decls.push_back(D);
+      continue;
+    }
+    std::vector<Decl *> Children;
+    for (Decl *Child : cast<DeclContext>(D)->decls())
+      if (!isTraversedWithExpression(Child))
+        Children.push_back(Child);
+    addSplittableDecls(Children, Decls);
+  }
+}
+
+// The size in bytes of the text of D, or 1 if it is not in one file
+uint64_t getSize(const Decl *D, const SourceManager &SM) {
+  SourceRange Range = D->getSourceRange();
+  if (Range.isInvalid())
+    return 1;
+  std::pair<FileID, unsigned> Begin =
+      SM.getDecomposedLoc(SM.getExpansionLoc(Range.getBegin()));
+  std::pair<FileID, unsigned> End =
+      SM.getDecomposedLoc(SM.getExpansionRange(Range.getEnd()).getEnd());
+  if (Begin.first != End.first || End.second < Begin.second)
+    return 1;
+  return End.second - Begin.second + 1;
+}
+
+// Split Decls in at most NumParts runs of declarations of about the same
+// size
+std::vector<std::vector<Decl *>> split(ArrayRef<Decl *> Decls,
+                                       unsigned NumParts,
+                                       const SourceManager &SM) {
+  std::vector<uint64_t> Sizes;
+  uint64_t Total = 0;
+  for (const Decl *D : Decls) {
+    Sizes.push_back(getSize(D, SM));
+    Total += Sizes.back();
+  }
+  std::vector<std::vector<Decl *>> Parts(1);
+  uint64_t Done = 0;
+  for (size_t I = 0; I < Decls.size(); ++I) {
+    // The next part starts once this one has its share of the total
+    if (!Parts.back().empty() && Parts.size() < NumParts &&
+        Done * NumParts >= Total * Parts.size())
+      Parts.emplace_back();
+    Parts.back().push_back(Decls[I]);
+    Done += Sizes[I];
+  }
+  return Parts;
+}
+
+// Run Checks on the declarations of Scope in a worker and return their
+// diagnostics, as recorded by a DiagnosticRecorder
+std::string runChecks(ASTConsumer &Checks, ArrayRef<Decl *> Scope,
+                      ASTContext &Context) {
+  DiagnosticsEngine &Diags = Context.getDiagnostics();
+  DiagnosticConsumer *Client = Diags.getClient();
+  std::unique_ptr<DiagnosticConsumer> OwnedClient = Diags.takeClient();
+  DiagnosticRecorder Recorder;
+  Diags.setClient(&Recorder, /*ShouldOwnClient=*/false);
+  Context.setTraversalScope(std::vector<Decl *>(Scope.begin(), Scope.end()));
+  Checks.HandleTranslationUnit(Context);
+  if (OwnedClient)
+    Diags.setClient(OwnedClient.release());
+  else
+    Diags.setClient(Client, /*ShouldOwnClient=*/false);
+  return std::move(Recorder.Recorded);
+}
+
+// Passes everything on to the checks, but runs them in the workers at the
+// end of the translation unit
+class ParallelASTConsumer : public MultiplexConsumer {
+public:
+  ParallelASTConsumer(std::vector<std::unique_ptr<ASTConsumer>> Consumers,
+                      ASTConsumer &Split, ASTConsumer *Whole,
+                      unsigned NumWorkers)
+      : MultiplexConsumer(std::move(Consumers)), Split(Split), Whole(Whole),
+        NumWorkers(NumWorkers) {}
+
+  void HandleTranslationUnit(ASTContext &Context) override;
+
+private:
+  ASTConsumer &Split;
+  ASTConsumer *Whole;
+  unsigned NumWorkers;
+};
+
+void ParallelASTConsumer::HandleTranslationUnit(ASTContext &Context) {
+  const SourceManager &SM = Context.getSourceManager();
+  std::vector<Decl *> Scope = Context.getTraversalScope();
+  std::vector<Decl *> Decls;
+  addSplittableDecls(Scope, Decls);
+  std::vector<std::vector<Decl *>> Parts = split(Decls, NumWorkers, SM);
+
+  // Task 0 runs Whole, if there is one, and each other task a part
+  size_t FirstPart = Whole ? 1 : 0;
+  size_t NumTasks = FirstPart + Parts.size();
+  auto Run = [&](size_t Task) {
+    if (Task < FirstPart) {
+      Decl *TU = Context.getTranslationUnitDecl();
+      return runChecks(*Whole, TU, Context);
+    }
+    return runChecks(Split, Parts[Task - FirstPart], Context);
+  };
+  bool InWorkers = NumTasks > 1;
+#ifndef LLVM_ON_UNIX
+  InWorkers = false;
+#endif
+  if (!InWorkers) {
+    if (Whole) {
+      Context.setTraversalScope({Context.getTranslationUnitDecl()});
+      Whole->HandleTranslationUnit(Context);
+      Context.setTraversalScope(Scope);
+    }
+    Split.HandleTranslationUnit(Context);
+    return;
+  }
+
+  std::vector<std::string> Recorded(NumTasks);
+  std::vector<DiagnosticGroup> Groups;
+  runInWorkers(
+      NumTasks, NumTasks, /*MemoryLimitMB=*/0, std::chrono::seconds(0), Run,
+      [&](size_t Task, std::string Result) {
+        Recorded[Task] = std::move(Result);
+      },
+      [&](size_t Task, StringRef Reason) {
+        std::string What =
+            Task < FirstPart
+                ? std::string("the rules on the whole translation unit")
+                : "part " + std::to_string(Task - FirstPart + 1) + " of " +
+                      std::to_string(Parts.size()) +
+                      " of the translation unit";
+        Groups.push_back({RecordedDiagnostic{
+            DiagnosticsEngine::Error, SourceLocation(),
+            "the worker process checking " + What + " " + Reason.str() +
+                ", its violations are not reported"}});
+      });
+
+  for (const std::string &Diagnostics : Recorded)
+    decodeDiagnostics(Diagnostics, Groups);
+  // The diagnostics without a location come first, like those of the
+  // workers that failed
+  std::stable_sort(Groups.begin(), Groups.end(),
+                   [&](const DiagnosticGroup &A, const DiagnosticGroup &B) {
+                     SourceLocation LHS = A.front().Loc;
+                     SourceLocation RHS = B.front().Loc;
+                     if (LHS.isInvalid() || RHS.isInvalid())
+                       return LHS.isInvalid() && RHS.isValid();
+                     return SM.isBeforeInTranslationUnit(LHS, RHS);
+                   });
+  DiagnosticsEngine &Diags = Context.getDiagnostics();
+  for (const DiagnosticGroup &Group : Groups)
+    for (const RecordedDiagnostic &Diagnostic : Group)
+      if (Diagnostic.Level != DiagnosticsEngine::Ignored)
+        Diags.Report(Diagnostic.Loc,
+                     Diags.getCustomDiagID(Diagnostic.Level, "%0"))
+            << Diagnostic.Message;
+}
+
+} // namespace
+
+std::unique_ptr<ASTConsumer>
+newParallelASTConsumer(std::unique_ptr<ASTConsumer> Split,
+                       std::unique_ptr<ASTConsumer> Whole,
+                       unsigned NumWorkers) {
+  ASTConsumer &SplitRef = *Split;
+  ASTConsumer *WholePtr = Whole.get();
+  std::vector<std::unique_ptr<ASTConsumer>> Consumers;
+  Consumers.push_back(std::move(Split));
+  if (Whole)
+    Consumers.push_back(std::move(Whole));
+  return std::make_unique<ParallelASTConsumer>(
+      std::move(Consumers), SplitRef, WholePtr, std::max(1u, NumWorkers));
+}
+
+} // namespace misra
@@ -0,0 +1,38 @@
+// Runs the AST checks of one translation unit in several worker processes
+#ifndef MISRA_CHECK_PARALLELCHECKS_H
+#define MISRA_CHECK_PARALLELCHECKS_H
+
+#include "clang/AST/ASTConsumer.h"
+#include <memory>
+
+namespace misra {
+
+// Wrap the AST checks Split and Whole so that, once the translation unit is
+// parsed, they run in worker processes forked from this one (see
+// WorkerPool.h). Split runs in NumWorkers workers, each on a part of the top
+// level declarations of the traversal scope, of about the same size in
+// bytes; the declarations of a namespace are split like those of the
+// translation unit. Whole, if not null, runs on the whole translation unit in
+// one more worker, whatever the traversal scope, e.g. that of a line filter:
+// it is for the rules whose violations may depend on more than one top level
+// declaration. Both must only look at the traversal scope of the ASTContext.
+//
+// Threads could not share the ASTContext: the checks fill its caches, e.g.
+// of the layouts of types, and load the declarations of a precompiled header
+// as they need them. Each worker has its own copy of the AST instead, from
+// the fork, and sends back the diagnostics of the checks, whose locations
+// mean the same in every copy of the source manager. They are reported here
+// once every worker is done, in the order of their locations, so the output
+// is the same for any number of workers. A worker that crashes fails its
+// part with an error.
+//
+// The process must have no other thread, see runInWorkers(). Without
+// processes, or when there is nothing to split, the checks simply run here.
+std::unique_ptr<clang::ASTConsumer>
+newParallelASTConsumer(std::unique_ptr<clang::ASTConsumer> Split,
+                       std::unique_ptr<clang::ASTConsumer> Whole,
+                       unsigned NumWorkers);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_PARALLELCHECKS_H
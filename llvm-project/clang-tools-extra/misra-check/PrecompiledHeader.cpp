@@ -0,0 +1,317 @@
+// Precompiled header shared by the translation units that start with the
+// same heavy include
+#include "PrecompiledHeader.h"
+#include "ResultCache.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/Version.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace misra {
+
+// Its address locates the executable, and so the builtin headers, the same
+// way ClangTool does for the translation units
+static int ResourceDirAnchor;
+
+PCHManager::PCHManager(StringRef Header, StringRef Dir) : Dir(Dir) {
+  SmallString<256> Path;
+  if (sys::fs::real_path(Header, Path)) {
+    Path = Header;
+    sys::fs::make_absolute(Path);
+  }
+  this->Header = std::string(Path.str());
+}
+
+// The compile flags of Command without its input, output and dependency
+// files, i.e. the flags that the precompiled header must be built with
+static std::vector<std::string> getFlags(const CompileCommand &Command) {
+  SmallString<256> AbsoluteFile(Command.Filename);
+  sys::fs::make_absolute(Command.Directory, AbsoluteFile);
+
+  CommandLineArguments Args = getClangStripDependencyFileAdjuster()(
+      Command.CommandLine, Command.Filename);
+  std::vector<std::string> Flags;
+  for (size_t I = 0; I < Args.size(); ++I) {
+    StringRef Arg = Args[I];
+    if (Arg == "-o") {
+      ++I;
+      continue;
+    }
+    if (I > 0 && (Arg == Command.Filename || Arg == AbsoluteFile ||
+                  Arg == "-c" || Arg == "-S" || Arg == "-E" ||
+                  Arg == "-fsyntax-only"))
+      continue;
+    Flags.push_back(Args[I]);
+  }
+  return Flags;
+}
+
+Optional<PCHInfo> PCHManager::get(const CompileCommand &Command, bool IsC) {
+  // A file compiled with a precompiled header of its own keeps it
+  if (llvm::is_contained(Command.CommandLine, "-include-pch"))
+    return None;
+
+  SmallString<256> File(Command.Filename);
+  sys::fs::make_absolute(Command.Directory, File);
+  if (!startsWithHeader(Command, File))
+    return None;
+
+  std::vector<std::string> Flags = getFlags(Command);
+  SHA1 Hasher;
+  auto Add = [&Hasher](StringRef S) {
+    Hasher.update(S);
+    Hasher.update(StringRef("\0", 1));
+  };
+  Add(getClangFullVersion());
+  Add(Header);
+  Add(Command.Directory);
+  // The same flags may compile a file as C or as C++, e.g. after -x
+  Add(IsC ? "c" : "c++");
+  for (const std::string &Flag : Flags)
+    Add(Flag);
+  std::string Key = toHex(Hasher.final(), /*LowerCase=*/true);
+
+  Entry *E;
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    std::unique_ptr<Entry> &Slot = Entries[Key];
+    if (!Slot)
+      Slot = std::make_unique<Entry>();
+    E = Slot.get();
+  }
+
+  // Other threads that need the same header wait until it is built
+  std::lock_guard<std::mutex> Lock(E->Mutex);
+  if (!E->Done) {
+    E->Done = true;
+    SmallString<256> Path(Dir);
+    sys::path::append(Path, "misra-check-" + Key + ".pch");
+    E->Info = load(Path);
+    if (!E->Info)
+      E->Info = build(Flags, Command, IsC, Path);
+  }
+  return E->Info;
+}
+
+// Size and modification time of a file, as written in the .deps files
+static Optional<std::string> getFileStamp(StringRef Path) {
+  sys::fs::file_status Status;
+  if (sys::fs::status(Path, Status))
+    return None;
+  return std::to_string(Status.getSize()) + " " +
+         std::to_string(sys::toTimeT(Status.getLastModificationTime()));
+}
+
+Optional<PCHInfo> PCHManager::load(StringRef Path) {
+  if (!sys::fs::exists(Path))
+    return None;
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Deps =
+      MemoryBuffer::getFile(Path + ".deps");
+  if (!Deps)
+    return None;
+
+  // One line "<size> <modification time> <path>" per file
+  PCHInfo Info;
+  Info.Path = Path.str();
+  SmallVector<StringRef, 0> Lines;
+  (*Deps)->getBuffer().split(Lines, '\n', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+  for (StringRef Line : Lines) {
+    StringRef Size, Time, File;
+    std::tie(Size, Line) = Line.split(' ');
+    std::tie(Time, File) = Line.split(' ');
+    Optional<std::string> Stamp = getFileStamp(File);
+    if (!Stamp || *Stamp != (Size + " " + Time).str())
+      return None;
+    Info.Dependencies.push_back(File.str());
+  }
+  if (Info.Dependencies.empty())
+    return None;
+  return std::move(Info);
+}
+
+Optional<PCHInfo> PCHManager::build(const std::vector<std::string> &Flags,
+                                    const CompileCommand &Command, bool IsC,
+                                    StringRef Path) {
+  std::vector<std::string> Args = Flags;
+  if (!llvm::any_of(Args, [](StringRef Arg) {
+        return Arg.startswith("-resource-dir");
+      }))
+    Args.insert(Args.begin() + 1,
+                "-resource-dir=" + CompilerInvocation::GetResourcesPath(
+                                       "clang_tool", &ResourceDirAnchor));
+  StringRef Language = IsC ? "c-header" : "c++-header";
+  Args.insert(Args.end(), {"-x", Language.str(), Header, "-o", Path.str()});
+
+  // The file system of the build has the working directory of the command
+  IntrusiveRefCntPtr<vfs::FileSystem> FS(
+      vfs::createPhysicalFileSystem().release());
+  FS->setCurrentWorkingDirectory(Command.Directory);
+  IntrusiveRefCntPtr<FileManager> Files(
+      new FileManager(FileSystemOptions(), FS));
+
+  std::vector<std::string> Dependencies;
+  std::unique_ptr<FrontendActionFactory> Factory =
+      newDependencyRecordingActionFactory(
+          newFrontendActionFactory<GeneratePCHAction>(), Dependencies);
+  ToolInvocation Invocation(Args, Factory->create(), Files.get());
+  // If the header has errors, the files that include it report them when
+  // they are parsed without the precompiled header
+  IgnoringDiagConsumer Diags;
+  Invocation.setDiagnosticConsumer(&Diags);
+  if (!Invocation.run() || Dependencies.empty()) {
+    errs() << "misra-check: cannot build a precompiled header from " << Header
+           << ", it is parsed in every file\n";
+    return None;
+  }
+
+  std::string Deps;
+  raw_string_ostream OS(Deps);
+  for (const std::string &File : Dependencies) {
+    Optional<std::string> Stamp = getFileStamp(File);
+    if (!Stamp)
+      return None;
+    OS << *Stamp << ' ' << File << '\n';
+  }
+  OS.flush();
+
+  // Written after the .pch file, a reader never finds a .deps file that
+  // describes a header that is not complete
+  Expected<sys::fs::TempFile> Temp =
+      sys::fs::TempFile::create(Path + ".deps-%%%%%%%%");
+  if (!Temp) {
+    consumeError(Temp.takeError());
+    return None;
+  }
+  {
+    raw_fd_ostream DepsFile(Temp->FD, /*shouldClose=*/false);
+    DepsFile << Deps;
+    DepsFile.flush();
+    // The stream would abort the process if it were destroyed with its
+    // error, e.g. when the disk is full
+    if (DepsFile.has_error()) {
+      DepsFile.clear_error();
+      consumeError(Temp->discard());
+      return None;
+    }
+  }
+  if (Error E = Temp->keep(Path + ".deps")) {
+    consumeError(std::move(E));
+    return None;
+  }
+  return PCHInfo{Path.str(), std::move(Dependencies)};
+}
+
+// The directories searched for an #include in File, the input of Command, in
+// the order of the compiler: for #include "..." the directory of File and the
+// -iquote directories, then the -I and the -isystem ones. The directories the
+// compiler adds itself are left out.
+static std::vector<std::string> getIncludeDirs(const CompileCommand &Command,
+                                               StringRef File, bool Quoted) {
+  auto Absolute = [&](StringRef Path) {
+    SmallString<256> Result(Path);
+    sys::fs::make_absolute(Command.Directory, Result);
+    return std::string(Result.str());
+  };
+  std::vector<std::string> Dirs;
+  std::vector<std::string> Isystem;
+  if (Quoted)
+    Dirs.push_back(sys::path::parent_path(File).str());
+  const std::vector<std::string> &Args = Command.CommandLine;
+  for (size_t I = 1; I < Args.size(); ++I) {
+    StringRef Arg = Args[I];
+    // The value of an option either joined to it or in the next argument
+    auto GetValue = [&](StringRef Option) -> Optional<StringRef> {
+      if (!Arg.startswith(Option))
+        return None;
+      if (Arg.size() > Option.size())
+        return Arg.drop_front(Option.size());
+      if (I + 1 < Args.size())
+        return StringRef(Args[++I]);
+      return None;
+    };
+
+    if (Optional<StringRef> Value = GetValue("-iquote")) {
+      if (Quoted)
+        Dirs.push_back(Absolute(*Value));
+    } else if (Optional<StringRef> Value = GetValue("-isystem")) {
+      Isystem.push_back(Absolute(*Value));
+    } else if (Optional<StringRef> Value = GetValue("-I")) {
+      Dirs.push_back(Absolute(*Value));
+    }
+  }
+  Dirs.insert(Dirs.end(), Isystem.begin(), Isystem.end());
+  return Dirs;
+}
+
+bool PCHManager::startsWithHeader(const CompileCommand &Command,
+                                  StringRef File) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFile(File);
+  if (!Buffer)
+    return false;
+
+  // Skip the white space and the comments before the first directive. Nothing
+  // else may come before it, or the header would not be a prefix of the file.
+  StringRef Text = (*Buffer)->getBuffer();
+  while (true) {
+    Text = Text.ltrim();
+    if (Text.consume_front("//"))
+      Text = Text.drop_until([](char C) { return C == '\n'; });
+    else if (Text.consume_front("/*")) {
+      size_t End = Text.find("*/");
+      Text = End == StringRef::npos ? StringRef() : Text.drop_front(End + 2);
+    } else
+      break;
+  }
+
+  if (!Text.consume_front("#"))
+    return false;
+  Text = Text.ltrim(" \t");
+  if (!Text.consume_front("include"))
+    return false;
+  Text = Text.ltrim(" \t");
+  char Close;
+  if (Text.consume_front("\""))
+    Close = '"';
+  else if (Text.consume_front("<"))
+    Close = '>';
+  else
+    return false;
+  StringRef Name =
+      Text.take_until([Close](char C) { return C == Close || C == '\n'; });
+
+  if (Name.empty())
+    return false;
+
+  // The file the compiler would include, the first one found
+  std::vector<std::string> Dirs;
+  if (sys::path::is_absolute(Name))
+    Dirs.push_back("");
+  else
+    Dirs = getIncludeDirs(Command, File, Close == '"');
+  for (const std::string &Dir : Dirs) {
+    SmallString<256> Path(Dir);
+    sys::path::append(Path, Name);
+    if (!sys::fs::is_regular_file(Path))
+      continue;
+    SmallString<256> RealPath;
+    return !sys::fs::real_path(Path, RealPath) && RealPath == Header;
+  }
+  return false;
+}
+
+} // namespace misra
@@ -0,0 +1,80 @@
+// Precompiled header shared by the translation units that start with the
+// same heavy include
+#ifndef MISRA_CHECK_PRECOMPILEDHEADER_H
+#define MISRA_CHECK_PRECOMPILEDHEADER_H
+
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace misra {
+
+// A precompiled header that can be used for a translation unit
+struct PCHInfo {
+  // Path of the .pch file, for -include-pch
+  std::string Path;
+  // Absolute paths of the files it was built from
+  std::vector<std::string> Dependencies;
+};
+
+// Builds a precompiled header from Header for each set of compile flags and
+// reuses it for every translation unit whose first directive includes Header.
+// The headers are stored in a directory so that later runs reuse them too.
+//
+// Next to each .pch file, a .deps file lists the size and modification time of
+// every file it was built from, which are the properties clang checks when it
+// loads the header. A precompiled header whose inputs changed is built again.
+class PCHManager {
+public:
+  // Dir must already exist
+  PCHManager(llvm::StringRef Header, llvm::StringRef Dir);
+
+  // Return the precompiled header to use for the file of Command, building it
+  // if needed. IsC tells whether the file is compiled as C rather than C++,
+  // as the driver decided from its compile commands. Returns None if the file
+  // does not start with an include of the header, or if the header could not
+  // be built; the file is then parsed as usual.
+  llvm::Optional<PCHInfo> get(const clang::tooling::CompileCommand &Command,
+                              bool IsC);
+
+private:
+  // The state of the precompiled header of one set of compile flags. Each
+  // one is built at most once per run, by the first thread that needs it.
+  struct Entry {
+    std::mutex Mutex;
+    bool Done = false;
+    llvm::Optional<PCHInfo> Info;
+  };
+
+  // Return true if the first directive of File, the input of Command, is an
+  // include that resolves to Header. The include is looked up like the
+  // compiler does in the directory of File and the -iquote, -I and -isystem
+  // directories of Command, and the real path of the first match is compared
+  // to that of Header. An include not found there is not taken as Header.
+  bool startsWithHeader(const clang::tooling::CompileCommand &Command,
+                        llvm::StringRef File);
+
+  // Return the header at Path if it exists and none of the files it was
+  // built from has changed
+  llvm::Optional<PCHInfo> load(llvm::StringRef Path);
+
+  // Build the header at Path, with the Flags of Command, as a C header if IsC
+  // or else as a C++ header
+  llvm::Optional<PCHInfo> build(const std::vector<std::string> &Flags,
+                                const clang::tooling::CompileCommand &Command,
+                                bool IsC, llvm::StringRef Path);
+
+  std::string Header;
+  std::string Dir;
+  std::mutex Mutex;
+  llvm::StringMap<std::unique_ptr<Entry>> Entries;
+};
+
+} // namespace misra
+
+#endif // MISRA_CHECK_PRECOMPILEDHEADER_H
@@ -0,0 +1,575 @@
+// Cheap scan of the text of a translation unit that rules out rules
+#include "Prefilter.h"
+#include "MisraRule.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Path.h"
+#include <cassert>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+// AVX2 is used when the processor has it, whatever the target of the build
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MISRA_CHECK_AVX2_DISPATCH
+#endif
+
+using namespace llvm;
+
+namespace misra {
+
+// Stop scanning, and run every rule, past these many headers or bytes. The
+// scan is meant to be much cheaper than preprocessing.
+static const unsigned MaxFiles = 1000;
+static const uint64_t MaxBytes = 32 << 20;
+
+static bool isIdentifierChar(char C) {
+  // Bytes of UTF-8 sequences may be part of identifiers
+  return isAlnum(C) || C == '_' || C == '$' ||
+         static_cast<unsigned char>(C) >= 0x80;
+}
+
+static unsigned getWordFeatures(StringRef Word) {
+  // The floating point macros predefined by clang and the builtins, some of
+  // which return a floating type
+  if (Word.startswith("__FLT") || Word.startswith("__DBL") ||
+      Word.startswith("__LDBL") || Word.startswith("__builtin") ||
+      Word.startswith("_Float"))
+    return SF_Floating;
+  // The macros predefined by clang for the unsigned types, which expand to
+  // the unsigned keyword
+  if (Word.startswith("__UINT") || Word.startswith("__SIZE_TYPE") ||
+      Word.startswith("__CHAR16_TYPE") || Word.startswith("__CHAR32_TYPE"))
+    return SF_Unsigned;
+  return StringSwitch<unsigned>(Word)
+      .Case("typedef", SF_Typedef)
+      .Case("enum", SF_Enum)
+      .Cases("float", "double", "__fp16", "__bf16", "__float128", "__ibm128",
+             SF_Floating)
+      .Case("unsigned", SF_Unsigned)
+      .Cases("if", "while", "for", "do", SF_Condition)
+      // The alternative tokens of the operators
+      .Cases("not", "and", "or", SF_Logical | SF_Condition)
+      .Cases("bitand", "bitor", "xor", "compl", "and_eq", "or_eq", "xor_eq",
+             SF_Bitwise)
+      .Default(0);
+}
+
+static unsigned getNumberFeatures(StringRef Number) {
+  unsigned Features = 0;
+  bool Hex = Number.size() >= 2 && Number[0] == '0' &&
+             (Number[1] == 'x' || Number[1] == 'X');
+  if (Number.size() >= 2 && Number[0] == '0')
+    Features |= SF_ZeroPrefixedNumber;
+  if (Hex)
+    Features |= SF_HexNumber;
+  if (Number.back() >= 'a' && Number.back() <= 'z')
+    Features |= SF_LowerCaseEnd;
+  if (Number.find_first_of(Hex ? "pP" : ".eE") != StringRef::npos)
+    Features |= SF_Floating;
+  return Features;
+}
+
+// The end of the preprocessing number that starts at Start, which includes
+// the suffixes and the digit separators, as the lexer sees it
+static size_t getNumberEnd(StringRef Text, size_t Start) {
+  size_t I = Start + 1, N = Text.size();
+  while (I < N) {
+    char D = Text[I];
+    if (isIdentifierChar(D) || D == '.')
+      ++I;
+    else if ((D == '+' || D == '-') && StringRef("eEpP").contains(Text[I - 1]))
+      ++I;
+    else if (D == '\'' && I + 1 < N && isIdentifierChar(Text[I + 1]))
+      ++I;
+    else
+      break;
+  }
+  return I;
+}
+
+unsigned scanFeatures(StringRef Text) {
+  unsigned Features = 0;
+  size_t I = 0, N = Text.size();
+  while (I < N) {
+    char C = Text[I];
+    char Next = I + 1 < N ? Text[I + 1] : 0;
+
+    if (isDigit(C) || (C == '.' && isDigit(Next))) {
+      size_t Start = I;
+      I = getNumberEnd(Text, Start);
+      Features |= getNumberFeatures(Text.slice(Start, I));
+      continue;
+    }
+
+    if (isIdentifierChar(C)) {
+      size_t Start = I;
+      while (I < N && isIdentifierChar(Text[I]))
+        ++I;
+      Features |= getWordFeatures(Text.slice(Start, I));
+      continue;
+    }
+
+    switch (C) {
+    case '#':
+      // Token pasting may make any identifier or number, e.g. 0 ## 17
+      if (Next == '#')
+        return SF_All;
+      break;
+    case '%':
+      // The digraph of ##
+      if (Text.substr(I, 4) == "%:%:")
+        return SF_All;
+      break;
+    case '?':
+      // A trigraph may be any of the operators, e.g. ??! is |
+      if (Next == '?')
+        return SF_All;
+      Features |= SF_Conditional;
+      break;
+    case '-':
+      Features |= SF_Minus;
+      break;
+    case '!':
+      Features |= SF_Logical | SF_Condition;
+      break;
+    case '&':
+    case '|':
+      Features |= SF_Bitwise;
+      if (Next == C)
+        Features |= SF_Logical | SF_Condition;
+      break;
+    case '^':
+    case '~':
+      Features |= SF_Bitwise;
+      break;
+    case '<':
+    case '>':
+      if (Next == C)
+        Features |= SF_Bitwise;
+      break;
+    default:
+      break;
+    }
+    ++I;
+  }
+  return Features;
+}
+
+namespace {
+
+// The text of a file with its lines spliced, as the lexer sees it: a
+// backslash at the end of a line, possibly followed by spaces, joins it with
+// the next one, even inside a token or a directive
+class SplicedText {
+public:
+  explicit SplicedText(StringRef Text) {
+    if (!Text.contains('\\')) {
+      Spliced = Text;
+      return;
+    }
+    Storage.reserve(Text.size());
+    for (size_t I = 0; I < Text.size(); ++I) {
+      if (Text[I] == '\\') {
+        size_t J = I + 1;
+        while (J < Text.size() && (Text[J] == ' ' || Text[J] == '\t'))
+          ++J;
+        if (J < Text.size() && Text[J] == '\r')
+          ++J;
+        if (J < Text.size() && Text[J] == '\n') {
+          I = J;
+          continue;
+        }
+      }
+      Storage += Text[I];
+    }
+    Spliced = Storage;
+  }
+
+  StringRef str() const { return Spliced; }
+
+private:
+  std::string Storage;
+  StringRef Spliced;
+};
+
+struct IncludeDirective {
+  StringRef Name;
+  bool Quoted;
+};
+
+// Find the #include and #import directives of Text, in skipped blocks and
+// comments too. Returns false if there may be a directive that is not
+// understood, e.g. one that names a macro.
+bool findIncludes(StringRef Text, SmallVectorImpl<IncludeDirective> &Includes) {
+  SmallVector<StringRef, 0> Lines;
+  Text.split(Lines, '\n');
+  for (StringRef Line : Lines) {
+    StringRef Rest = Line.ltrim(" \t\f\v\r");
+    if (Rest.consume_front("#") || Rest.consume_front("%:")) {
+      Rest = Rest.ltrim(" \t\f\v");
+    } else {
+      // A comment before the # of a directive, possibly the end of one that
+      // started on an earlier line
+      size_t End = Rest.rfind("*/");
+      if (End == StringRef::npos)
+        continue;
+      StringRef After = Rest.drop_front(End + 2).ltrim(" \t\f\v");
+      if (After.startswith("#") || After.startswith("%:"))
+        return false;
+      continue;
+    }
+    // A comment between the # and the name of the directive
+    if (Rest.startswith("/*"))
+      return false;
+
+    StringRef Directive = Rest.take_while(isIdentifierChar);
+    if (Directive != "include" && Directive != "import" &&
+        Directive != "include_next")
+      continue;
+    // #include_next continues the search where the includer was found, which
+    // may be a directory the compiler adds itself
+    if (Directive == "include_next")
+      return false;
+    Rest = Rest.drop_front(Directive.size()).ltrim(" \t\f\v");
+    char Close = Rest.startswith("\"") ? '"' : Rest.startswith("<") ? '>' : 0;
+    size_t End = Close ? Rest.find(Close, 1) : StringRef::npos;
+    if (End == StringRef::npos)
+      return false;
+    Includes.push_back({Rest.slice(1, End), Close == '"'});
+  }
+  return true;
+}
+
+// The directories searched for the headers, in the order of the compiler
+struct SearchPath {
+  // -iquote, only for #include "..."
+  std::vector<std::string> Quoted;
+  // -I, then -isystem
+  std::vector<std::string> Angled;
+};
+
+// The path of the header named by an #include in a file of directory
+// IncluderDir, or an empty string if it is not found in the SearchPath
+std::string findHeader(StringRef Name, bool Quoted, StringRef IncluderDir,
+                       const SearchPath &Search) {
+  auto Find = [&](StringRef Dir) -> std::string {
+    SmallString<256> Path;
+    if (sys::path::is_absolute(Name))
+      Path = Name;
+    else {
+      Path = Dir;
+      sys::path::append(Path, Name);
+    }
+    if (!sys::fs::is_regular_file(Path))
+      return "";
+    return std::string(Path.str());
+  };
+  if (sys::path::is_absolute(Name))
+    return Find("");
+  if (Quoted) {
+    std::string Path = Find(IncluderDir);
+    for (size_t I = 0; Path.empty() && I < Search.Quoted.size(); ++I)
+      Path = Find(Search.Quoted[I]);
+    if (!Path.empty())
+      return Path;
+  }
+  for (const std::string &Dir : Search.Angled) {
+    std::string Path = Find(Dir);
+    if (!Path.empty())
+      return Path;
+  }
+  return "";
+}
+
+} // namespace
+
+Optional<SourceScan> scanTranslationUnit(StringRef File, StringRef Directory,
+                                         ArrayRef<std::string> CommandLine) {
+  auto Absolute = [&](StringRef Path) {
+    SmallString<256> Result(Path);
+    sys::fs::make_absolute(Directory, Result);
+    sys::path::remove_dots(Result, /*remove_dot_dot=*/true);
+    return std::string(Result.str());
+  };
+
+  // The options that change what the compiler reads. Any other option that
+  // adds directories or files may make it read a header that is not scanned.
+  SearchPath Search;
+  std::vector<std::string> Isystem;
+  std::vector<std::string> ForcedIncludes;
+  std::string Defines;
+  for (size_t I = 1; I < CommandLine.size(); ++I) {
+    StringRef Arg = CommandLine[I];
+    // The value of an option either joined to it or in the next argument
+    auto GetValue = [&](StringRef Option) -> Optional<StringRef> {
+      if (!Arg.startswith(Option))
+        return None;
+      if (Arg.size() > Option.size())
+        return Arg.drop_front(Option.size());
+      if (I + 1 < CommandLine.size())
+        return StringRef(CommandLine[++I]);
+      return None;
+    };
+
+    if (Arg.startswith("@") || Arg.startswith("--driver-mode") ||
+        Arg.startswith("-F") || Arg.startswith("-fmodules") ||
+        Arg.startswith("-fcxx-modules") || Arg.startswith("--include") ||
+        Arg == "-I-")
+      return None;
+    // A precompiled header is built from a header that the file includes,
+    // and the directories after the system ones are never searched first
+    if (GetValue("-include-pch") || GetValue("-isysroot") ||
+        GetValue("-idirafter"))
+      continue;
+    if (Optional<StringRef> Value = GetValue("-include")) {
+      ForcedIncludes.push_back(Value->str());
+    } else if (Optional<StringRef> Value = GetValue("-imacros")) {
+      ForcedIncludes.push_back(Value->str());
+    } else if (Optional<StringRef> Value = GetValue("-iquote")) {
+      Search.Quoted.push_back(Absolute(*Value));
+    } else if (Optional<StringRef> Value = GetValue("-isystem")) {
+      Isystem.push_back(Absolute(*Value));
+    } else if (Arg.startswith("-i")) {
+      // Other directories, prefixes and overlays of the file system
+      return None;
+    } else if (Optional<StringRef> Value = GetValue("-I")) {
+      Search.Angled.push_back(Absolute(*Value));
+    } else if (Optional<StringRef> Value = GetValue("-D")) {
+      Defines += *Value;
+      Defines += '\n';
+    }
+  }
+  Search.Angled.insert(Search.Angled.end(), Isystem.begin(), Isystem.end());
+
+  SourceScan Scan;
+  Scan.Features = scanFeatures(Defines);
+  // The files to scan, as the compiler names them, in the order they are
+  // found, and the real paths of those already scanned
+  std::vector<std::string> Worklist{Absolute(File)};
+  for (const std::string &Forced : ForcedIncludes) {
+    // Like #include "..." in a file of the working directory
+    std::string Path = findHeader(Forced, /*Quoted=*/true, Directory, Search);
+    if (Path.empty())
+      return None;
+    Worklist.push_back(Path);
+  }
+  StringSet<> Seen;
+  uint64_t Bytes = 0;
+  for (size_t Next = 0; Next < Worklist.size(); ++Next) {
+    std::string Path = Worklist[Next];
+    SmallString<256> RealPath;
+    if (sys::fs::real_path(Path, RealPath))
+      return None;
+    if (!Seen.insert(RealPath).second)
+      continue;
+    if (Seen.size() > MaxFiles)
+      return None;
+    Scan.Files.push_back(std::string(RealPath.str()));
+
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+        MemoryBuffer::getFile(Path, /*IsText=*/false,
+                              /*RequiresNullTerminator=*/false);
+    if (!Buffer)
+      return None;
+    Bytes += (*Buffer)->getBufferSize();
+    if (Bytes > MaxBytes)
+      return None;
+
+    SplicedText Text((*Buffer)->getBuffer());
+    Scan.Features |= scanFeatures(Text.str());
+    // Nothing can be ruled out anymore
+    if (Scan.Features == SF_All)
+      return None;
+
+    SmallVector<IncludeDirective, 16> Includes;
+    if (!findIncludes(Text.str(), Includes))
+      return None;
+    StringRef Dir = sys::path::parent_path(Path);
+    for (const IncludeDirective &Include : Includes) {
+      std::string Header =
+          findHeader(Include.Name, Include.Quoted, Dir, Search);
+      if (Header.empty())
+        return None;
+      Worklist.push_back(std::move(Header));
+    }
+  }
+  return Scan;
+}
+
+namespace {
+
+// Which of the bytes of a block are digits and which may be part of an
+// identifier, one bit per byte, as isDigit() and isIdentifierChar() say
+struct ByteMasks {
+  uint32_t Digits;
+  uint32_t Identifier;
+};
+
+ByteMasks getByteMasks(const char *P, unsigned Count) {
+  ByteMasks Masks{0, 0};
+  for (unsigned I = 0; I < Count; ++I) {
+    if (isDigit(P[I]))
+      Masks.Digits |= uint32_t(1) << I;
+    if (isIdentifierChar(P[I]))
+      Masks.Identifier |= uint32_t(1) << I;
+  }
+  return Masks;
+}
+
+ByteMasks getByteMasks16(const char *P) { return getByteMasks(P, 16); }
+
+#if defined(__SSE2__)
+ByteMasks getByteMasksSSE2(const char *P) {
+  __m128i Bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(P));
+  // A byte is in [Low, Low + Size] if B - Low, wrapped, is at most Size
+  auto InRange = [](__m128i B, char Low, char Size) {
+    __m128i Offset = _mm_sub_epi8(B, _mm_set1_epi8(Low));
+    return _mm_cmpeq_epi8(_mm_min_epu8(Offset, _mm_set1_epi8(Size)), Offset);
+  };
+  __m128i Digits = InRange(Bytes, '0', 9);
+  __m128i Letters = InRange(_mm_or_si128(Bytes, _mm_set1_epi8(0x20)), 'a', 25);
+  __m128i Others = _mm_or_si128(_mm_cmpeq_epi8(Bytes, _mm_set1_epi8('_')),
+                                _mm_cmpeq_epi8(Bytes, _mm_set1_epi8('$')));
+  __m128i Identifier = _mm_or_si128(_mm_or_si128(Digits, Letters), Others);
+  // The bytes of UTF-8 sequences have their top bit set
+  return {uint32_t(_mm_movemask_epi8(Digits)),
+          uint32_t(_mm_movemask_epi8(Identifier) | _mm_movemask_epi8(Bytes))};
+}
+#endif
+
+#if defined(MISRA_CHECK_AVX2_DISPATCH)
+// A lambda would not be compiled for AVX2
+__attribute__((target("avx2"))) inline __m256i
+inRangeAVX2(__m256i Bytes, char Low, char Size) {
+  __m256i Offset = _mm256_sub_epi8(Bytes, _mm256_set1_epi8(Low));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(Offset, _mm256_set1_epi8(Size)),
+                           Offset);
+}
+
+__attribute__((target("avx2"))) ByteMasks getByteMasksAVX2(const char *P) {
+  __m256i Bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(P));
+  __m256i Digits = inRangeAVX2(Bytes, '0', 9);
+  __m256i Letters =
+      inRangeAVX2(_mm256_or_si256(Bytes, _mm256_set1_epi8(0x20)), 'a', 25);
+  __m256i Others =
+      _mm256_or_si256(_mm256_cmpeq_epi8(Bytes, _mm256_set1_epi8('_')),
+                      _mm256_cmpeq_epi8(Bytes, _mm256_set1_epi8('$')));
+  __m256i Identifier =
+      _mm256_or_si256(_mm256_or_si256(Digits, Letters), Others);
+  return {uint32_t(_mm256_movemask_epi8(Digits)),
+          uint32_t(_mm256_movemask_epi8(Identifier)) |
+              uint32_t(_mm256_movemask_epi8(Bytes))};
+}
+#endif
+
+// Finds the numbers of a text from the digits that do not follow an
+// identifier character, Width bytes at a time, and adds up their features
+template <unsigned Width, ByteMasks (*GetMasks)(const char *)>
+class NumberScanner {
+public:
+  explicit NumberScanner(StringRef Text) : Text(Text) {}
+
+  unsigned scan() {
+    size_t I = 0, N = Text.size();
+    for (; I + Width <= N; I += Width)
+      if (!addBlock(I, GetMasks(Text.data() + I), Width))
+        return Features;
+    if (I < N)
+      addBlock(I, getByteMasks(Text.data() + I, N - I), N - I);
+    return Features;
+  }
+
+private:
+  // Add the numbers that start in the Count bytes at Offset. Returns false
+  // once every feature of the numbers has been found.
+  bool addBlock(size_t Offset, ByteMasks Masks, unsigned Count) {
+    uint32_t Starts =
+        Masks.Digits & ~((Masks.Identifier << 1) | PreviousIdentifier);
+    PreviousIdentifier = (Masks.Identifier >> (Count - 1)) & 1;
+    while (Starts) {
+      size_t Start = Offset + countTrailingZeros(Starts);
+      Starts &= Starts - 1;
+      // A digit inside the number before, e.g. after its decimal point
+      if (Start < Resume)
+        continue;
+      // A number may also start with a decimal point, e.g. .5f
+      if (Start > Resume && Text[Start - 1] == '.')
+        --Start;
+      Resume = getNumberEnd(Text, Start);
+      Features |= getNumberFeatures(Text.slice(Start, Resume));
+      if ((Features & SF_Numbers) == SF_Numbers)
+        return false;
+    }
+    return true;
+  }
+
+  StringRef Text;
+  unsigned Features = 0;
+  // The end of the last number found
+  size_t Resume = 0;
+  // Whether the byte before the block may be part of an identifier
+  uint32_t PreviousIdentifier = 0;
+};
+
+} // namespace
+
+unsigned scanNumberFeatures(StringRef Text) {
+  if (hasNumberScanBlocks(NumberScanBlocks::AVX2))
+    return scanNumberFeatures(Text, NumberScanBlocks::AVX2);
+  if (hasNumberScanBlocks(NumberScanBlocks::SSE2))
+    return scanNumberFeatures(Text, NumberScanBlocks::SSE2);
+  return scanNumberFeatures(Text, NumberScanBlocks::Scalar);
+}
+
+bool hasNumberScanBlocks(NumberScanBlocks Blocks) {
+  switch (Blocks) {
+  case NumberScanBlocks::Scalar:
+    return true;
+  case NumberScanBlocks::SSE2:
+#if defined(__SSE2__)
+    return true;
+#else
+    return false;
+#endif
+  case NumberScanBlocks::AVX2: {
+#if defined(MISRA_CHECK_AVX2_DISPATCH)
+    static const bool HasAVX2 = __builtin_cpu_supports("avx2");
+    return HasAVX2;
+#else
+    return false;
+#endif
+  }
+  }
+  llvm_unreachable("unknown blocks");
+}
+
+unsigned scanNumberFeatures(StringRef Text, NumberScanBlocks Blocks) {
+  assert(hasNumberScanBlocks(Blocks) && "blocks not available");
+  SplicedText Spliced(Text);
+  switch (Blocks) {
+#if defined(MISRA_CHECK_AVX2_DISPATCH)
+  case NumberScanBlocks::AVX2:
+    return NumberScanner<32, getByteMasksAVX2>(Spliced.str()).scan() &
+           SF_Numbers;
+#endif
+#if defined(__SSE2__)
+  case NumberScanBlocks::SSE2:
+    return NumberScanner<16, getByteMasksSSE2>(Spliced.str()).scan() &
+           SF_Numbers;
+#endif
+  default:
+    return NumberScanner<16, getByteMasks16>(Spliced.str()).scan() &
+           SF_Numbers;
+  }
+}
+
+} // namespace misra
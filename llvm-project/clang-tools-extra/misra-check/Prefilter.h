@@ -0,0 +1,66 @@
+// Cheap scan of the text of a translation unit that rules out rules
+#ifndef MISRA_CHECK_PREFILTER_H
+#define MISRA_CHECK_PREFILTER_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <vector>
+
+namespace misra {
+
+// The result of the scan of a translation unit
+struct SourceScan {
+  // The SourceFeatures found in the text
+  unsigned Features = 0;
+  // The real paths of the files scanned, the main file first. Every file
+  // the compiler may read is among them, headers in skipped conditional
+  // blocks included.
+  std::vector<std::string> Files;
+};
+
+// Scan the text of a file and of every header it includes, directly or not,
+// for the SourceFeatures of the rules. The text is not preprocessed: macros
+// are not expanded, comments, strings and skipped blocks are scanned as code,
+// and every header named by an #include is scanned. The macros predefined for
+// the floating and the unsigned types count as these types, and token pasting
+// and trigraphs as every feature. The features found are
+// thus a superset of those of the tokens the compiler sees, provided all the
+// text it reads was scanned. So the scan gives up, and returns None, when it
+// cannot be sure of that: when an #include names a macro, or a header that is
+// not found in the directory of the file or in the -iquote, -I and -isystem
+// directories of CommandLine, since it may be in a directory that the
+// compiler adds itself, such as those of the standard library.
+//
+// CommandLine is the compile command of File, and relative paths are
+// resolved against Directory. The -include and -imacros files are scanned
+// too, and the values of the -D options.
+llvm::Optional<SourceScan>
+scanTranslationUnit(llvm::StringRef File, llvm::StringRef Directory,
+                    llvm::ArrayRef<std::string> CommandLine);
+
+// The SourceFeatures of Text, e.g. of the contents of one file
+unsigned scanFeatures(llvm::StringRef Text);
+
+// The SF_Numbers features of Text, the same as those of scanFeatures() but
+// for token pasting and trigraphs, which the raw lexer does not do. Most bytes
+// cannot start a number, so the scan looks for the candidates, the digits that
+// do not follow an identifier character, 32 bytes at a time with AVX2 or 16
+// with SSE2, and only looks at the text around them. Without a number, a file
+// has nothing for the literal rules.
+unsigned scanNumberFeatures(llvm::StringRef Text);
+
+// How scanNumberFeatures() looks for the candidates of a block
+enum class NumberScanBlocks { Scalar, SSE2, AVX2 };
+
+// Whether this build, on this processor, can scan with Blocks
+bool hasNumberScanBlocks(NumberScanBlocks Blocks);
+
+// scanNumberFeatures() with the given Blocks, which must be available, so
+// that the benchmark can compare them. The other one uses the widest.
+unsigned scanNumberFeatures(llvm::StringRef Text, NumberScanBlocks Blocks);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_PREFILTER_H
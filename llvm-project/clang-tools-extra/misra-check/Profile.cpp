@@ -0,0 +1,179 @@
+// Time spent in each phase and rule of a run, for --profile
+#include "Profile.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/MultiplexConsumer.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/TimeProfiler.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace misra {
+
+void RunProfile::add(const ProfileTimes &Times) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  for (const auto &Entry : Times)
+    Totals[Entry.getKey()] += Entry.getValue();
+  ++NumFiles;
+}
+
+void RunProfile::print(raw_ostream &OS) const {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  std::vector<std::pair<StringRef, double>> Rows;
+  double Total = 0;
+  for (const auto &Entry : Totals) {
+    // E.g. a rule without a traversal of its own
+    if (Entry.getValue() == 0)
+      continue;
+    Rows.emplace_back(Entry.getKey(), Entry.getValue());
+    Total += Entry.getValue();
+  }
+  llvm::sort(Rows, [](const std::pair<StringRef, double> &A,
+                      const std::pair<StringRef, double> &B) {
+    return A.second > B.second || (A.second == B.second && A.first < B.first);
+  });
+
+  OS << "misra-check profile of " << NumFiles << " translation unit"
+     << (NumFiles == 1 ? "" : "s") << ":\n";
+  OS << "   time (s)   share   phase or rule\n";
+  for (const auto &Row : Rows)
+    OS << format("%11.3f %6.1f%%   ", Row.second,
+                 Total > 0 ? Row.second * 100 / Total : 0.0)
+       << Row.first << "\n";
+  OS << format("%11.3f %6.1f%%   ", Total, Total > 0 ? 100.0 : 0.0)
+     << "total\n";
+}
+
+void ProfiledTokenRule::startTranslationUnit(Preprocessor &PP) {
+  auto Start = std::chrono::steady_clock::now();
+  Rule.startTranslationUnit(PP);
+  Seconds += secondsSince(Start);
+}
+
+void ProfiledTokenRule::handleToken(const Token &Tok, Preprocessor &PP) {
+  auto Start = std::chrono::steady_clock::now();
+  Rule.handleToken(Tok, PP);
+  Seconds += secondsSince(Start);
+}
+
+void ProfiledTokenRule::endTranslationUnit(Preprocessor &PP) {
+  auto Start = std::chrono::steady_clock::now();
+  Rule.endTranslationUnit(PP);
+  double Time = secondsSince(Start);
+  Seconds += Time;
+  EndSeconds += Time;
+}
+
+namespace {
+
+// What the two markers of a timed consumer share
+struct TimedRegion {
+  TimedRegion(StringRef Name, StringRef Detail, double &Seconds)
+      : Name(Name), Detail(Detail), Seconds(Seconds) {}
+
+  std::string Name;
+  std::string Detail;
+  double &Seconds;
+  std::chrono::steady_clock::time_point Start;
+};
+
+// Starts the time of a region when it is given the translation unit
+class RegionStartConsumer : public ASTConsumer {
+public:
+  explicit RegionStartConsumer(std::shared_ptr<TimedRegion> Region)
+      : Region(std::move(Region)) {}
+
+  void HandleTranslationUnit(ASTContext &Context) override {
+    if (timeTraceProfilerEnabled())
+      timeTraceProfilerBegin(Region->Name, Region->Detail);
+    Region->Start = std::chrono::steady_clock::now();
+  }
+
+private:
+  std::shared_ptr<TimedRegion> Region;
+};
+
+// Ends the time of a region when it is given the translation unit
+class RegionEndConsumer : public ASTConsumer {
+public:
+  explicit RegionEndConsumer(std::shared_ptr<TimedRegion> Region)
+      : Region(std::move(Region)) {}
+
+  void HandleTranslationUnit(ASTContext &Context) override {
+    Region->Seconds += secondsSince(Region->Start);
+    if (timeTraceProfilerEnabled())
+      timeTraceProfilerEnd();
+  }
+
+private:
+  std::shared_ptr<TimedRegion> Region;
+};
+
+// Time the HandleTranslationUnit of Inner. The MultiplexConsumer passes every
+// other call on to Inner unchanged.
+std::unique_ptr<ASTConsumer>
+newTimedConsumer(std::unique_ptr<ASTConsumer> Inner, StringRef Name,
+                 StringRef Detail, double &Seconds) {
+  auto Region = std::make_shared<TimedRegion>(Name, Detail, Seconds);
+  std::vector<std::unique_ptr<ASTConsumer>> Consumers;
+  Consumers.push_back(std::make_unique<RegionStartConsumer>(Region));
+  Consumers.push_back(std::move(Inner));
+  Consumers.push_back(std::make_unique<RegionEndConsumer>(Region));
+  return std::make_unique<MultiplexConsumer>(std::move(Consumers));
+}
+
+class ProfilingAction : public WrapperFrontendAction {
+public:
+  ProfilingAction(std::unique_ptr<FrontendAction> Wrapped, double &Seconds)
+      : WrapperFrontendAction(std::move(Wrapped)), Seconds(Seconds) {}
+
+protected:
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
+                                                 StringRef InFile) override {
+    std::unique_ptr<ASTConsumer> Inner =
+        WrapperFrontendAction::CreateASTConsumer(CI, InFile);
+    if (!Inner)
+      return nullptr;
+    return newTimedConsumer(std::move(Inner), "AST rules", InFile, Seconds);
+  }
+
+private:
+  double &Seconds;
+};
+
+class ProfilingActionFactory : public FrontendActionFactory {
+public:
+  ProfilingActionFactory(std::unique_ptr<FrontendActionFactory> Inner,
+                         double &Seconds)
+      : Inner(std::move(Inner)), Seconds(Seconds) {}
+
+  std::unique_ptr<FrontendAction> create() override {
+    return std::make_unique<ProfilingAction>(Inner->create(), Seconds);
+  }
+
+private:
+  std::unique_ptr<FrontendActionFactory> Inner;
+  double &Seconds;
+};
+
+} // namespace
+
+std::unique_ptr<ASTConsumer> ProfiledASTRule::newASTConsumer() {
+  std::unique_ptr<ASTConsumer> Inner = Rule.newASTConsumer();
+  if (!Inner)
+    return nullptr;
+  return newTimedConsumer(std::move(Inner), "Rule", Name, Seconds);
+}
+
+std::unique_ptr<FrontendActionFactory>
+newProfilingActionFactory(std::unique_ptr<FrontendActionFactory> Inner,
+                          double &Seconds) {
+  return std::make_unique<ProfilingActionFactory>(std::move(Inner), Seconds);
+}
+
+} // namespace misra
@@ -0,0 +1,102 @@
+// Time spent in each phase and rule of a run, for --profile
+#ifndef MISRA_CHECK_PROFILE_H
+#define MISRA_CHECK_PROFILE_H
+
+#include "MisraRule.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace misra {
+
+// Seconds spent in each phase of the check of a translation unit and in each
+// rule, by name, e.g. "frontend" or "rule 2.10.3 (matchers)"
+using ProfileTimes = llvm::StringMap<double>;
+
+// Seconds elapsed since Start
+inline double secondsSince(std::chrono::steady_clock::time_point Start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       Start)
+      .count();
+}
+
+// Adds up the times of all the translation units checked in a run and prints
+// them as a table, longest first. The threads that check the translation
+// units add their times as they finish.
+class RunProfile {
+public:
+  void add(const ProfileTimes &Times);
+  void print(llvm::raw_ostream &OS) const;
+
+private:
+  mutable std::mutex Mutex;
+  ProfileTimes Totals;
+  unsigned NumFiles = 0;
+};
+
+// A token rule that forwards everything to Rule and adds the time Rule takes
+// to Seconds. The time is measured around each call, since the tokens are
+// handed to the rules one by one while they are lexed. The time of
+// endTranslationUnit() is also added to EndSeconds: with AST rules it runs
+// among the AST consumers rather than while lexing.
+class ProfiledTokenRule : public TokenRule {
+public:
+  ProfiledTokenRule(TokenRule &Rule, double &Seconds, double &EndSeconds)
+      : Rule(Rule), Seconds(Seconds), EndSeconds(EndSeconds) {}
+
+  // The patterns are run by the TokenPatternSet, so their time is not the
+  // time of Rule
+  void registerPatterns(TokenPatternSet &Patterns) override {
+    Rule.registerPatterns(Patterns);
+  }
+
+  void startTranslationUnit(clang::Preprocessor &PP) override;
+  void handleToken(const clang::Token &Tok, clang::Preprocessor &PP) override;
+  void endTranslationUnit(clang::Preprocessor &PP) override;
+
+private:
+  TokenRule &Rule;
+  double &Seconds;
+  double &EndSeconds;
+};
+
+// An AST rule that forwards everything to Rule and adds the time the
+// consumer of Rule takes to Seconds. The consumer also shows up in the time
+// trace as "Rule <Name>".
+class ProfiledASTRule : public ASTRule {
+public:
+  ProfiledASTRule(ASTRule &Rule, llvm::StringRef Name, double &Seconds)
+      : Rule(Rule), Name(Name), Seconds(Seconds) {}
+
+  void registerMatchers(clang::ast_matchers::MatchFinder &Finder) override {
+    Rule.registerMatchers(Finder);
+  }
+
+  void registerOperatorChecks(OperatorVisitor &Visitor) override {
+    Rule.registerOperatorChecks(Visitor);
+  }
+
+  std::unique_ptr<clang::ASTConsumer> newASTConsumer() override;
+
+private:
+  ASTRule &Rule;
+  std::string Name;
+  double &Seconds;
+};
+
+// Wrap the actions created by Inner so that the time their AST consumer
+// takes, once the translation unit is parsed, is added to Seconds. It also
+// shows up in the time trace as "AST rules".
+std::unique_ptr<clang::tooling::FrontendActionFactory>
+newProfilingActionFactory(
+    std::unique_ptr<clang::tooling::FrontendActionFactory> Inner,
+    double &Seconds);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_PROFILE_H
@@ -0,0 +1,93 @@
+// Lex loop of --raw-lex, shared by all token rules
+#include "RawTokenLexer.h"
+#include "TokenPattern.h"
+#include "clang/Basic/DiagnosticCommon.h"
+#include "clang/Basic/DiagnosticIDs.h"
+#include "clang/Basic/FileSystemOptions.h"
+#include "clang/Lex/HeaderSearchOptions.h"
+#include "clang/Lex/Lexer.h"
+#include "clang/Lex/PreprocessorOptions.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/TimeProfiler.h"
+
+using namespace clang;
+using namespace llvm;
+
+namespace misra {
+
+// The options the lexer depends on: comments, digraphs, digit separators and
+// the keywords
+static LangOptions getLexerOptions(bool IsC) {
+  LangOptions Opts;
+  if (IsC) {
+    Opts.C99 = Opts.C11 = Opts.C17 = 1;
+  } else {
+    Opts.CPlusPlus = Opts.CPlusPlus11 = Opts.CPlusPlus14 = 1;
+    Opts.CPlusPlus17 = Opts.Bool = Opts.WChar = 1;
+  }
+  Opts.LineComment = Opts.Digraphs = 1;
+  return Opts;
+}
+
+RawTokenLexer::RawTokenLexer(StringRef File, bool IsC,
+                             DiagnosticConsumer &Consumer)
+    : LangOpts(getLexerOptions(IsC)),
+      Diags(new DiagnosticIDs(), new DiagnosticOptions(), &Consumer,
+            /*ShouldOwnClient=*/false),
+      Files(FileSystemOptions()), Sources(Diags, Files),
+      Headers(std::make_shared<HeaderSearchOptions>(), Sources, Diags,
+              LangOpts, /*Target=*/nullptr) {
+  PP = std::make_unique<Preprocessor>(std::make_shared<PreprocessorOptions>(),
+                                      Diags, LangOpts, Sources, Headers,
+                                      Modules);
+  // The constructor leaves the keywords to Preprocessor::Initialize(), which
+  // needs a target and is not called here, so the identifiers would all stay
+  // identifiers
+  PP->getIdentifierTable().AddKeywords(LangOpts);
+  Consumer.BeginSourceFile(LangOpts, PP.get());
+  Expected<FileEntryRef> Entry = Files.getFileRef(File);
+  if (!Entry) {
+    Diags.Report(diag::err_cannot_open_file)
+        << File << toString(Entry.takeError());
+    return;
+  }
+  MainFile = Sources.createFileID(*Entry, SourceLocation(), SrcMgr::C_User);
+  Sources.setMainFileID(MainFile);
+}
+
+RawTokenLexer::~RawTokenLexer() { Diags.getClient()->EndSourceFile(); }
+
+Optional<StringRef> RawTokenLexer::getText() const {
+  if (MainFile.isInvalid())
+    return None;
+  return Sources.getBufferDataOrNone(MainFile);
+}
+
+void RawTokenLexer::run(ArrayRef<TokenRule *> Rules,
+                        TokenAutomaton &Automaton) {
+  Optional<MemoryBufferRef> Buffer = Sources.getBufferOrNone(MainFile);
+  if (!Buffer)
+    return;
+  TimeTraceScope TimeScope("Raw token rules", Buffer->getBufferIdentifier());
+  TokenPatternSet Patterns(Automaton);
+  std::vector<TokenRule *> AllRules = addTokenPatterns(Rules, Patterns);
+  for (TokenRule *Rule : AllRules)
+    Rule->startTranslationUnit(*PP);
+
+  Lexer Raw(MainFile, *Buffer, Sources, LangOpts);
+  Token Tok;
+  while (true) {
+    Raw.LexFromRawLexer(Tok);
+    if (Tok.is(tok::eof))
+      break;
+    // Turn the identifiers into keywords where they are one
+    if (Tok.is(tok::raw_identifier))
+      PP->LookUpIdentifierInfo(Tok);
+    for (TokenRule *Rule : AllRules)
+      Rule->handleToken(Tok, *PP);
+  }
+  for (TokenRule *Rule : AllRules)
+    Rule->endTranslationUnit(*PP);
+}
+
+} // namespace misra
@@ -0,0 +1,62 @@
+// Token rules run on the raw tokens of a main file, for --raw-lex
+#ifndef MISRA_CHECK_RAWTOKENLEXER_H
+#define MISRA_CHECK_RAWTOKENLEXER_H
+
+#include "MisraRule.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/LangOptions.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/HeaderSearch.h"
+#include "clang/Lex/ModuleLoader.h"
+#include "clang/Lex/Preprocessor.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+#include <memory>
+
+namespace misra {
+
+class TokenAutomaton;
+
+// Lexes one file in raw mode, without a compile command, include processing,
+// macro expansion or header search, and gives its tokens to the token rules.
+// The file is read through the FileManager, which maps it into memory unless
+// it is small enough to be read faster. The identifiers are looked up in the
+// keyword table, so the rules see kw_unsigned as usual. The rules are given a
+// preprocessor that is never entered: only its source manager, diagnostics
+// and identifiers are set up.
+//
+// Compared with the preprocessed tokens, the rules only see the main file,
+// and they also see the tokens of the directives, of the macro definitions
+// and of the blocks skipped by #if, but not those that macros expand to.
+class RawTokenLexer {
+public:
+  // Open File, lexed as C if IsC and as C++17 otherwise. The diagnostics of
+  // the rules, and the error if the file cannot be read, go to Consumer.
+  RawTokenLexer(llvm::StringRef File, bool IsC,
+                clang::DiagnosticConsumer &Consumer);
+  ~RawTokenLexer();
+
+  // The text of the file, or None if it could not be read
+  llvm::Optional<llvm::StringRef> getText() const;
+
+  // Give every token of the file to each of Rules, then end them. The
+  // patterns of the rules run on Automaton.
+  void run(llvm::ArrayRef<TokenRule *> Rules, TokenAutomaton &Automaton);
+
+private:
+  clang::LangOptions LangOpts;
+  clang::DiagnosticsEngine Diags;
+  clang::FileManager Files;
+  clang::SourceManager Sources;
+  clang::HeaderSearch Headers;
+  clang::TrivialModuleLoader Modules;
+  std::unique_ptr<clang::Preprocessor> PP;
+  clang::FileID MainFile;
+};
+
+} // namespace misra
+
+#endif // MISRA_CHECK_RAWTOKENLEXER_H
@@ -0,0 +1,246 @@
+// On-disk cache of the diagnostics of translation units
+#include "ResultCache.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Basic/Version.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace misra {
+
+// Change this whenever a rule changes what it reports, so that the results of
+// an older misra-check are not replayed
+static const char RuleSetVersion[] = "1";
+
+// First line of every entry, change it with the layout of the entries
+static const char EntryMagic[] = "misra-check-cache 1";
+
+std::string ResultCache::getKey(const CompilationDatabase &Compilations,
+                                StringRef File, const RuleSelection &Rules,
+                                StringRef Options) {
+  SmallString<256> AbsolutePath(File);
+  sys::fs::make_absolute(AbsolutePath);
+
+  SHA1 Hasher;
+  // Every string is followed by a zero byte, so that two different lists of
+  // strings never hash the same
+  auto Add = [&Hasher](StringRef S) {
+    Hasher.update(S);
+    Hasher.update(StringRef("\0", 1));
+  };
+  Add(RuleSetVersion);
+  Add(getClangFullVersion());
+  for (const ASTRuleInfo *Info : Rules.ASTRules)
+    Add(Info->Name);
+  Add("--");
+  for (const TokenRuleInfo *Info : Rules.TokenRules)
+    Add(Info->Name);
+  Add("--");
+  Add(Options);
+  for (const CompileCommand &Command :
+       Compilations.getCompileCommands(AbsolutePath)) {
+    Add(Command.Directory);
+    for (const std::string &Arg : Command.CommandLine)
+      Add(Arg);
+    Add("--");
+  }
+  Add(AbsolutePath);
+  Add(hashFile(AbsolutePath));
+  return toHex(Hasher.final(), /*LowerCase=*/true);
+}
+
+Optional<CachedResult> ResultCache::lookup(StringRef Key) {
+  std::string EntryPath = getEntryPath(Key);
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+      MemoryBuffer::getFile(EntryPath);
+  if (!Buffer)
+    return None;
+
+  StringRef Rest = (*Buffer)->getBuffer();
+  StringRef Line;
+  std::tie(Line, Rest) = Rest.split('\n');
+  if (Line != EntryMagic)
+    return None;
+
+  // deps <count>, then one line "<hash> <path>" per dependency
+  CachedResult Result;
+  unsigned NumDeps;
+  std::tie(Line, Rest) = Rest.split('\n');
+  if (!Line.consume_front("deps ") || Line.getAsInteger(10, NumDeps))
+    return None;
+  for (unsigned I = 0; I < NumDeps; ++I) {
+    std::tie(Line, Rest) = Rest.split('\n');
+    StringRef Hash, Path;
+    std::tie(Hash, Path) = Line.split(' ');
+    if (Hash.empty() || Hash != hashFile(Path))
+      return None;
+    Result.Dependencies.push_back(Path.str());
+  }
+
+  // status <exit status>
+  std::tie(Line, Rest) = Rest.split('\n');
+  if (!Line.consume_front("status ") || Line.getAsInteger(10, Result.Status))
+    return None;
+
+  // output <size>, then the diagnostics as they were printed
+  size_t Size;
+  std::tie(Line, Rest) = Rest.split('\n');
+  if (!Line.consume_front("output ") || Line.getAsInteger(10, Size) ||
+      Rest.size() != Size)
+    return None;
+
+  // Mark the entry as used, pruning removes the least recently used ones
+  int FD;
+  if (!sys::fs::openFileForRead(EntryPath, FD)) {
+    sys::fs::setLastAccessAndModificationTime(
+        FD, std::chrono::system_clock::now());
+    sys::Process::SafelyCloseFileDescriptor(FD);
+  }
+  Result.Output = Rest.str();
+  return std::move(Result);
+}
+
+Error ResultCache::store(StringRef Key, const CachedResult &Result) {
+  std::string Data;
+  raw_string_ostream OS(Data);
+  OS << EntryMagic << '\n' << "deps " << Result.Dependencies.size() << '\n';
+  for (const std::string &Path : Result.Dependencies) {
+    std::string Hash = hashFile(Path);
+    // Without the hash of a file the entry could never be validated
+    if (Hash.empty())
+      return createStringError(inconvertibleErrorCode(),
+                               "cannot hash " + Path);
+    OS << Hash << ' ' << Path << '\n';
+  }
+  OS << "status " << Result.Status << '\n';
+  OS << "output " << Result.Output.size() << '\n' << Result.Output;
+  OS.flush();
+
+  // The temporary file does not match llvmcache-*, so pruning never removes
+  // an entry that is still being written
+  Expected<sys::fs::TempFile> Temp =
+      sys::fs::TempFile::create(Dir + "/tmp-%%%%%%%%%%%%");
+  if (!Temp)
+    return Temp.takeError();
+  {
+    raw_fd_ostream File(Temp->FD, /*shouldClose=*/false);
+    File << Data;
+    File.flush();
+    // The stream would abort the process if it were destroyed with its
+    // error, e.g. when the disk is full
+    if (File.has_error()) {
+      std::error_code EC = File.error();
+      File.clear_error();
+      consumeError(Temp->discard());
+      return createFileError(Temp->TmpName, EC);
+    }
+  }
+  return Temp->keep(getEntryPath(Key));
+}
+
+void ResultCache::prune(const CachePruningPolicy &Policy) {
+  pruneCache(Dir, Policy);
+}
+
+std::string ResultCache::hashFile(StringRef Path) {
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    auto It = FileHashes.find(Path);
+    if (It != FileHashes.end())
+      return It->second;
+  }
+
+  // Hash outside of the lock, two threads may hash the same file but they
+  // get the same result
+  std::string Hash;
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFile(Path);
+  if (Buffer) {
+    StringRef Contents = (*Buffer)->getBuffer();
+    Hash = toHex(SHA1::hash(arrayRefFromStringRef(Contents)),
+                 /*LowerCase=*/true);
+  }
+
+  std::lock_guard<std::mutex> Lock(Mutex);
+  FileHashes[Path] = Hash;
+  return Hash;
+}
+
+std::string ResultCache::getEntryPath(StringRef Key) const {
+  // pruneCache only considers files named llvmcache-*
+  SmallString<256> Path(Dir);
+  sys::path::append(Path, "llvmcache-" + Key);
+  return std::string(Path.str());
+}
+
+namespace {
+
+// Runs the wrapped action and, once the source file is done, records every
+// file that the source manager has loaded
+class DependencyRecordingAction : public WrapperFrontendAction {
+public:
+  DependencyRecordingAction(std::unique_ptr<FrontendAction> Wrapped,
+                            std::vector<std::string> &Dependencies)
+      : WrapperFrontendAction(std::move(Wrapped)), Dependencies(Dependencies) {
+  }
+
+protected:
+  void EndSourceFileAction() override {
+    CompilerInstance &CI = getCompilerInstance();
+    SourceManager &SM = CI.getSourceManager();
+    for (auto It = SM.fileinfo_begin(), End = SM.fileinfo_end(); It != End;
+         ++It) {
+      // Prefer the real path, which is also the form git reports
+      SmallString<256> Path(It->first->tryGetRealPathName());
+      if (Path.empty()) {
+        Path = It->first->getName();
+        CI.getFileManager().makeAbsolutePath(Path);
+        sys::path::remove_dots(Path, /*remove_dot_dot=*/true);
+      }
+      Dependencies.push_back(std::string(Path.str()));
+    }
+    WrapperFrontendAction::EndSourceFileAction();
+  }
+
+private:
+  std::vector<std::string> &Dependencies;
+};
+
+class DependencyRecordingActionFactory : public FrontendActionFactory {
+public:
+  DependencyRecordingActionFactory(std::unique_ptr<FrontendActionFactory> Inner,
+                                   std::vector<std::string> &Dependencies)
+      : Inner(std::move(Inner)), Dependencies(Dependencies) {}
+
+  std::unique_ptr<FrontendAction> create() override {
+    return std::make_unique<DependencyRecordingAction>(Inner->create(),
+                                                       Dependencies);
+  }
+
+private:
+  std::unique_ptr<FrontendActionFactory> Inner;
+  std::vector<std::string> &Dependencies;
+};
+
+} // namespace
+
+std::unique_ptr<FrontendActionFactory> newDependencyRecordingActionFactory(
+    std::unique_ptr<FrontendActionFactory> Inner,
+    std::vector<std::string> &Dependencies) {
+  return std::make_unique<DependencyRecordingActionFactory>(std::move(Inner),
+                                                            Dependencies);
+}
+
+} // namespace misra
@@ -0,0 +1,84 @@
+// On-disk cache of the diagnostics of translation units
+#ifndef MISRA_CHECK_RESULTCACHE_H
+#define MISRA_CHECK_RESULTCACHE_H
+
+#include "Driver.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/Error.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace misra {
+
+// What is replayed for a translation unit found in the cache
+struct CachedResult {
+  // Exit status of the check, non zero when a rule reported a violation
+  int Status;
+  // Diagnostics as they were printed
+  std::string Output;
+  // Absolute paths of the files read by the compiler
+  std::vector<std::string> Dependencies;
+};
+
+// Each entry of the cache holds the diagnostics printed for one translation
+// unit, together with the hash of every file that was read to produce them.
+// An entry is found by a key that hashes everything known before the file is
+// preprocessed: the rule set, the compile command and the main file. It is
+// only replayed if all the headers it lists are unchanged, so a change to a
+// header invalidates the entries of every file that included it.
+//
+// Entries are written to a temporary file and renamed into place, so several
+// processes can share a cache directory and a reader never sees a partial
+// entry.
+class ResultCache {
+public:
+  // Dir must already exist
+  explicit ResultCache(llvm::StringRef Dir) : Dir(Dir) {}
+
+  // Compute the key of File for the selected rules. Options describes the
+  // other options of the run that change the diagnostics.
+  std::string getKey(const clang::tooling::CompilationDatabase &Compilations,
+                     llvm::StringRef File, const RuleSelection &Rules,
+                     llvm::StringRef Options);
+
+  // Return the cached result of Key, if there is one and all the files it
+  // depends on are unchanged
+  llvm::Optional<CachedResult> lookup(llvm::StringRef Key);
+
+  // Store the result of a translation unit that was compiled without errors.
+  // Returns an error if the entry could not be written, which leaves the
+  // cache as it was.
+  llvm::Error store(llvm::StringRef Key, const CachedResult &Result);
+
+  // Remove entries as given by Policy, the least recently used ones first
+  void prune(const llvm::CachePruningPolicy &Policy);
+
+private:
+  // SHA1 of the contents of a file in hex, or "" if the file cannot be read.
+  // Most headers are read by many translation units, so the hashes are kept
+  // for the lifetime of the cache object.
+  std::string hashFile(llvm::StringRef Path);
+
+  std::string getEntryPath(llvm::StringRef Key) const;
+
+  std::string Dir;
+  std::mutex Mutex;
+  llvm::StringMap<std::string> FileHashes;
+};
+
+// Wrap the actions created by Inner so that the absolute paths of all the
+// files read by the compiler are added to Dependencies
+std::unique_ptr<clang::tooling::FrontendActionFactory>
+newDependencyRecordingActionFactory(
+    std::unique_ptr<clang::tooling::FrontendActionFactory> Inner,
+    std::vector<std::string> &Dependencies);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_RESULTCACHE_H
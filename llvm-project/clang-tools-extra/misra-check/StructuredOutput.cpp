@@ -0,0 +1,171 @@
+// Diagnostics as JSON Lines or SARIF instead of text
+#include "StructuredOutput.h"
+#include "Driver.h"
+#include "clang/Basic/DiagnosticIDs.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+
+using namespace clang;
+using namespace llvm;
+
+namespace misra {
+
+Optional<OutputFormat> parseOutputFormat(StringRef Name) {
+  if (Name == "text")
+    return OutputFormat::Text;
+  if (Name == "jsonl")
+    return OutputFormat::JSONLines;
+  if (Name == "sarif")
+    return OutputFormat::SARIF;
+  return None;
+}
+
+// The rule number in a message such as "MISRA C++ Rule 2.10.3 Violation!"
+static StringRef getRuleFromMessage(StringRef Message) {
+  size_t Start = Message.find("Rule ");
+  if (Start == StringRef::npos)
+    return StringRef();
+  StringRef Rule = Message.drop_front(Start + 5);
+  return Rule.take_while([](char C) { return isDigit(C) || C == '.'; })
+      .rtrim('.');
+}
+
+static StringRef getLevelName(DiagnosticsEngine::Level Level,
+                              OutputFormat Format) {
+  switch (Level) {
+  case DiagnosticsEngine::Fatal:
+  case DiagnosticsEngine::Error:
+    return "error";
+  case DiagnosticsEngine::Warning:
+    return "warning";
+  case DiagnosticsEngine::Remark:
+    return Format == OutputFormat::SARIF ? "note" : "remark";
+  default:
+    return "note";
+  }
+}
+
+// An absolute file URI, as SARIF expects
+static std::string getFileURI(StringRef File) {
+  SmallString<256> Path(File);
+  sys::fs::make_absolute(Path);
+  sys::path::native(Path, sys::path::Style::posix);
+  std::string URI = "file://";
+  if (!Path.startswith("/"))
+    URI += '/';
+  for (char C : Path) {
+    if (isAlnum(C) || StringRef("/-._~:").contains(C))
+      URI += C;
+    else
+      URI += "%" + utohexstr(static_cast<unsigned char>(C), /*LowerCase=*/false,
+                             /*Width=*/2);
+  }
+  return URI;
+}
+
+void StructuredDiagnosticConsumer::HandleDiagnostic(
+    DiagnosticsEngine::Level Level, const Diagnostic &Info) {
+  // Keep the error count of the base class, ClangTool uses it for the exit
+  // status
+  DiagnosticConsumer::HandleDiagnostic(Level, Info);
+
+  SmallString<256> Message;
+  Info.FormatDiagnostic(Message);
+
+  std::string Rule;
+  if (DiagnosticIDs::isBuiltinDiag(Info.getID())) {
+    StringRef Flag = DiagnosticIDs::getWarningOptionForDiag(Info.getID());
+    Rule = ("clang-diagnostic-" +
+            (Flag.empty() ? getLevelName(Level, Format) : Flag))
+               .str();
+  } else {
+    Rule = getRuleFromMessage(Message).str();
+  }
+
+  std::string File;
+  unsigned Line = 0, Column = 0;
+  if (Info.getLocation().isValid() && Info.hasSourceManager()) {
+    const SourceManager &SM = Info.getSourceManager();
+    PresumedLoc PLoc =
+        SM.getPresumedLoc(SM.getExpansionLoc(Info.getLocation()));
+    if (PLoc.isValid()) {
+      File = PLoc.getFilename();
+      Line = PLoc.getLine();
+      Column = PLoc.getColumn();
+    }
+  }
+
+  json::Value Record = nullptr;
+  if (Format == OutputFormat::SARIF) {
+    json::Object Result{
+        {"ruleId", Rule},
+        {"level", getLevelName(Level, Format)},
+        {"message", json::Object{{"text", json::fixUTF8(Message)}}}};
+    if (!File.empty())
+      Result["locations"] = json::Array{json::Object{
+          {"physicalLocation",
+           json::Object{
+               {"artifactLocation",
+                json::Object{{"uri", json::fixUTF8(getFileURI(File))}}},
+               {"region", json::Object{{"startLine", Line},
+                                       {"startColumn", Column}}}}}}};
+    Record = std::move(Result);
+  } else {
+    Record = json::Object{{"file", json::fixUTF8(File)},
+                          {"line", Line},
+                          {"column", Column},
+                          {"level", getLevelName(Level, Format)},
+                          {"rule", Rule},
+                          {"message", json::fixUTF8(Message)}};
+  }
+  // A JSON value without pretty printing has no line break, so each record
+  // is exactly one line
+  OS << Record << "\n";
+}
+
+void StructuredOutputWriter::begin(const RuleSelection &Selection) {
+  if (Format != OutputFormat::SARIF)
+    return;
+  json::Array Rules;
+  for (const ASTRuleInfo *Info : Selection.ASTRules)
+    Rules.push_back(json::Object{{"id", Info->Name}});
+  for (const TokenRuleInfo *Info : Selection.TokenRules)
+    Rules.push_back(json::Object{{"id", Info->Name}});
+  json::Object Driver{{"name", "misra-check"}, {"rules", std::move(Rules)}};
+  // The results are streamed, so the log is written by hand around them
+  OS << "{\"version\":\"2.1.0\","
+     << "\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+     << "\"runs\":[{\"tool\":{\"driver\":"
+     << json::Value(std::move(Driver)) << "},\"results\":[\n";
+}
+
+void StructuredOutputWriter::write(StringRef Lines) {
+  // Each file is on disk as soon as it is written, for the readers that
+  // follow the output
+  if (Format != OutputFormat::SARIF) {
+    OS << Lines;
+    OS.flush();
+    return;
+  }
+  SmallVector<StringRef, 16> Results;
+  Lines.split(Results, '\n', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+  for (StringRef Result : Results) {
+    if (!FirstResult)
+      OS << ",\n";
+    OS << Result;
+    FirstResult = false;
+  }
+  OS.flush();
+}
+
+void StructuredOutputWriter::end() {
+  if (Format == OutputFormat::SARIF)
+    OS << (FirstResult ? "" : "\n") << "]}]}\n";
+  OS.flush();
+}
+
+} // namespace misra
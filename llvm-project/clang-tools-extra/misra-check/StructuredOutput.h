@@ -0,0 +1,63 @@
+// Diagnostics as JSON Lines or SARIF instead of text
+#ifndef MISRA_CHECK_STRUCTUREDOUTPUT_H
+#define MISRA_CHECK_STRUCTUREDOUTPUT_H
+
+#include "clang/Basic/Diagnostic.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace misra {
+
+struct RuleSelection;
+
+enum class OutputFormat { Text, JSONLines, SARIF };
+
+// Parse the value of --format: text, jsonl or sarif
+llvm::Optional<OutputFormat> parseOutputFormat(llvm::StringRef Name);
+
+// Writes each diagnostic as one line of JSON. In the JSONLines format a
+// line is a complete record:
+//   {"file":"a.cpp","line":3,"column":5,"level":"error","rule":"5.0.5",
+//    "message":"MISRA C++ Rule 5.0.5 Violation! ..."}
+// In the SARIF format it is a SARIF result object, and StructuredOutputWriter
+// puts the results of all the files in one SARIF log. The rule of a
+// diagnostic is taken from its message, "MISRA C++ Rule X", or is
+// clang-diagnostic-<flag> for the diagnostics of the compiler. Each
+// translation unit has its own consumer and its own stream, so the threads
+// share nothing while they check their files.
+class StructuredDiagnosticConsumer : public clang::DiagnosticConsumer {
+public:
+  StructuredDiagnosticConsumer(llvm::raw_ostream &OS, OutputFormat Format)
+      : OS(OS), Format(Format) {}
+
+  void HandleDiagnostic(clang::DiagnosticsEngine::Level Level,
+                        const clang::Diagnostic &Info) override;
+
+private:
+  llvm::raw_ostream &OS;
+  OutputFormat Format;
+};
+
+// Writes the lines of StructuredDiagnosticConsumer for all the files to one
+// output. For SARIF, begin() and end() write the rest of the log around the
+// results.
+class StructuredOutputWriter {
+public:
+  StructuredOutputWriter(llvm::raw_ostream &OS, OutputFormat Format)
+      : OS(OS), Format(Format) {}
+
+  void begin(const RuleSelection &Rules);
+  // Add the lines written for one translation unit
+  void write(llvm::StringRef Lines);
+  void end();
+
+private:
+  llvm::raw_ostream &OS;
+  OutputFormat Format;
+  bool FirstResult = true;
+};
+
+} // namespace misra
+
+#endif // MISRA_CHECK_STRUCTUREDOUTPUT_H
@@ -0,0 +1,350 @@
+// Token patterns and the automaton that runs them
+#include "TokenPattern.h"
+#include "llvm/Support/ErrorHandling.h"
+#include <algorithm>
+#include <utility>
+
+using namespace clang;
+using namespace llvm;
+
+namespace misra {
+namespace token_patterns {
+
+TokenProperty kind(tok::TokenKind Kind) {
+  return {std::string("kind ") + tok::getTokenName(Kind),
+          [Kind](const Token &Tok) { return Tok.is(Kind); }};
+}
+
+TokenProperty literal(StringRef Name, std::function<bool(StringRef)> Test) {
+  return {Name.str(), [Test](const Token &Tok) {
+            if (!Tok.isOneOf(tok::numeric_constant, tok::char_constant) ||
+                !Tok.getLiteralData())
+              return false;
+            return Test(StringRef(Tok.getLiteralData(), Tok.getLength()));
+          }};
+}
+
+TokenProperty zeroPrefixedLiteral() {
+  return literal("literal 0...", [](StringRef Spelling) {
+    return Spelling.size() >= 2 && Spelling[0] == '0';
+  });
+}
+
+TokenProperty hexLiteral() {
+  return literal("literal 0x...", [](StringRef Spelling) {
+    return Spelling.size() >= 2 && Spelling[0] == '0' &&
+           (Spelling[1] == 'x' || Spelling[1] == 'X');
+  });
+}
+
+TokenProperty literalEndsWith(char C) {
+  return literal(std::string("literal ...") + C, [C](StringRef Spelling) {
+    return !Spelling.empty() && Spelling.back() == C;
+  });
+}
+
+TokenProperty literalEndsWithLowerCase() {
+  return literal("literal ...[a-z]", [](StringRef Spelling) {
+    return !Spelling.empty() && Spelling.back() >= 'a' &&
+           Spelling.back() <= 'z';
+  });
+}
+
+struct TokenClass::Node {
+  enum NodeKind { AnyToken, HasProperty, Not, And, Or } Kind;
+  TokenProperty Property;
+  std::shared_ptr<const Node> LHS, RHS;
+};
+
+TokenClass::TokenClass(TokenProperty Property)
+    : Root(std::make_shared<Node>(
+          Node{Node::HasProperty, std::move(Property), nullptr, nullptr})) {}
+
+TokenClass anyToken() {
+  return TokenClass(std::make_shared<TokenClass::Node>(TokenClass::Node{
+      TokenClass::Node::AnyToken, TokenProperty(), nullptr, nullptr}));
+}
+
+static TokenClass combine(TokenClass::Node::NodeKind Kind, TokenClass A,
+                          TokenClass B) {
+  return TokenClass(std::make_shared<TokenClass::Node>(TokenClass::Node{
+      Kind, TokenProperty(), std::make_shared<TokenClass::Node>(A.getRoot()),
+      std::make_shared<TokenClass::Node>(B.getRoot())}));
+}
+
+TokenClass allOf(TokenClass A, TokenClass B) {
+  return combine(TokenClass::Node::And, std::move(A), std::move(B));
+}
+
+TokenClass anyOf(TokenClass A, TokenClass B) {
+  return combine(TokenClass::Node::Or, std::move(A), std::move(B));
+}
+
+TokenClass unless(TokenClass C) {
+  return TokenClass(std::make_shared<TokenClass::Node>(
+      TokenClass::Node{TokenClass::Node::Not, TokenProperty(),
+                       std::make_shared<TokenClass::Node>(C.getRoot()),
+                       nullptr}));
+}
+
+struct TokenPattern::Node {
+  enum NodeKind { OneToken, Sequence, Alternatives, ZeroOrMore } Kind;
+  // The class of a OneToken
+  std::vector<TokenClass> Class;
+  std::vector<TokenPattern> Operands;
+};
+
+TokenPattern::TokenPattern(TokenClass Class)
+    : Root(std::make_shared<Node>(
+          Node{Node::OneToken, {std::move(Class)}, {}})) {}
+
+TokenPattern sequence(std::initializer_list<TokenPattern> Patterns) {
+  return TokenPattern(std::make_shared<TokenPattern::Node>(
+      TokenPattern::Node{TokenPattern::Node::Sequence, {}, Patterns}));
+}
+
+TokenPattern alternatives(std::initializer_list<TokenPattern> Patterns) {
+  return TokenPattern(std::make_shared<TokenPattern::Node>(
+      TokenPattern::Node{TokenPattern::Node::Alternatives, {}, Patterns}));
+}
+
+TokenPattern zeroOrMore(TokenPattern Pattern) {
+  return TokenPattern(std::make_shared<TokenPattern::Node>(TokenPattern::Node{
+      TokenPattern::Node::ZeroOrMore, {}, {std::move(Pattern)}}));
+}
+
+} // namespace token_patterns
+
+using namespace token_patterns;
+
+// The properties of a token are a bit set, and the transitions of the
+// automaton are cached in a DenseMap keyed by it, whose reserved keys are the
+// largest values
+static const unsigned MaxProperties = 30;
+
+TokenAutomaton::TokenAutomaton() = default;
+TokenAutomaton::~TokenAutomaton() = default;
+
+unsigned TokenAutomaton::getProperty(const TokenProperty &Property) {
+  auto Inserted = PropertyIndex.try_emplace(Property.Name, Properties.size());
+  if (Inserted.second) {
+    if (Properties.size() == MaxProperties)
+      report_fatal_error("too many token properties in the token patterns");
+    Properties.push_back(Property);
+  }
+  return Inserted.first->getValue();
+}
+
+unsigned TokenAutomaton::compileClass(const TokenClass::Node &Class) {
+  Formula F{Formula::AnyToken, 0, 0, 0};
+  switch (Class.Kind) {
+  case TokenClass::Node::AnyToken:
+    break;
+  case TokenClass::Node::HasProperty:
+    F.Kind = Formula::HasProperty;
+    F.Property = getProperty(Class.Property);
+    break;
+  case TokenClass::Node::Not:
+    F.Kind = Formula::Not;
+    F.LHS = compileClass(*Class.LHS);
+    break;
+  case TokenClass::Node::And:
+  case TokenClass::Node::Or:
+    F.Kind = Class.Kind == TokenClass::Node::And ? Formula::And : Formula::Or;
+    F.LHS = compileClass(*Class.LHS);
+    F.RHS = compileClass(*Class.RHS);
+    break;
+  }
+  Formulas.push_back(F);
+  return Formulas.size() - 1;
+}
+
+bool TokenAutomaton::matches(unsigned Class, uint32_t TokenProperties) const {
+  const Formula &F = Formulas[Class];
+  switch (F.Kind) {
+  case Formula::AnyToken:
+    return true;
+  case Formula::HasProperty:
+    return TokenProperties & (uint32_t(1) << F.Property);
+  case Formula::Not:
+    return !matches(F.LHS, TokenProperties);
+  case Formula::And:
+    return matches(F.LHS, TokenProperties) && matches(F.RHS, TokenProperties);
+  case Formula::Or:
+    return matches(F.LHS, TokenProperties) || matches(F.RHS, TokenProperties);
+  }
+  llvm_unreachable("unknown formula");
+}
+
+unsigned TokenAutomaton::newPosition() {
+  Positions.emplace_back();
+  return Positions.size() - 1;
+}
+
+// The first and the last position of the pattern. Nothing leaves the last
+// position yet.
+std::pair<unsigned, unsigned>
+TokenAutomaton::compilePattern(const TokenPattern::Node &Pattern) {
+  unsigned First = newPosition();
+  unsigned Last;
+  switch (Pattern.Kind) {
+  case TokenPattern::Node::OneToken: {
+    int Class = compileClass(Pattern.Class.front().getRoot());
+    Last = newPosition();
+    Positions[First].Class = Class;
+    Positions[First].Next = Last;
+    break;
+  }
+  case TokenPattern::Node::Sequence:
+    Last = First;
+    for (const TokenPattern &Operand : Pattern.Operands) {
+      std::pair<unsigned, unsigned> Part = compilePattern(Operand.getRoot());
+      Positions[Last].Epsilon.push_back(Part.first);
+      Last = Part.second;
+    }
+    break;
+  case TokenPattern::Node::Alternatives:
+    Last = newPosition();
+    for (const TokenPattern &Operand : Pattern.Operands) {
+      std::pair<unsigned, unsigned> Part = compilePattern(Operand.getRoot());
+      Positions[First].Epsilon.push_back(Part.first);
+      Positions[Part.second].Epsilon.push_back(Last);
+    }
+    break;
+  case TokenPattern::Node::ZeroOrMore: {
+    std::pair<unsigned, unsigned> Part =
+        compilePattern(Pattern.Operands.front().getRoot());
+    Last = newPosition();
+    Positions[First].Epsilon.push_back(Part.first);
+    Positions[First].Epsilon.push_back(Last);
+    Positions[Part.second].Epsilon.push_back(Part.first);
+    Positions[Part.second].Epsilon.push_back(Last);
+    break;
+  }
+  }
+  return {First, Last};
+}
+
+void TokenAutomaton::addPattern(const TokenPattern &Pattern) {
+  std::pair<unsigned, unsigned> Part = compilePattern(Pattern.getRoot());
+  Positions[Part.second].Accepts = Starts.size();
+  Starts.push_back(Part.first);
+  // The automaton built so far does not know the new pattern
+  States.clear();
+  StateIndex.clear();
+}
+
+// The state of the set of positions Set and of all those reached from them
+// without a token
+unsigned TokenAutomaton::getState(std::vector<unsigned> Set) {
+  std::vector<bool> Seen(Positions.size());
+  for (unsigned P : Set)
+    Seen[P] = true;
+  for (size_t I = 0; I < Set.size(); ++I)
+    for (unsigned Next : Positions[Set[I]].Epsilon)
+      if (!Seen[Next]) {
+        Seen[Next] = true;
+        Set.push_back(Next);
+      }
+  // Only the positions that take a token and those that accept tell the
+  // states apart
+  Set.erase(std::remove_if(Set.begin(), Set.end(),
+                           [this](unsigned P) {
+                             return Positions[P].Class < 0 &&
+                                    Positions[P].Accepts < 0;
+                           }),
+            Set.end());
+  llvm::sort(Set);
+
+  auto Inserted = StateIndex.emplace(Set, States.size());
+  if (!Inserted.second)
+    return Inserted.first->second;
+  State New;
+  for (unsigned P : Set)
+    if (Positions[P].Accepts >= 0)
+      New.Accepts.push_back(Positions[P].Accepts);
+  llvm::sort(New.Accepts);
+  New.Accepts.erase(std::unique(New.Accepts.begin(), New.Accepts.end()),
+                    New.Accepts.end());
+  New.Positions = std::move(Set);
+  States.push_back(std::move(New));
+  return States.size() - 1;
+}
+
+unsigned TokenAutomaton::getStartState() {
+  if (States.empty())
+    getState(Starts);
+  return 0;
+}
+
+unsigned TokenAutomaton::getNextState(unsigned From, const Token &Tok) {
+  uint32_t TokenProperties = 0;
+  for (size_t I = 0; I < Properties.size(); ++I)
+    if (Properties[I].Test(Tok))
+      TokenProperties |= uint32_t(1) << I;
+  auto Cached = States[From].Next.find(TokenProperties);
+  if (Cached != States[From].Next.end())
+    return Cached->second;
+  // A match may start at every token
+  std::vector<unsigned> Set(Starts);
+  for (unsigned P : States[From].Positions)
+    if (Positions[P].Class >= 0 &&
+        matches(Positions[P].Class, TokenProperties))
+      Set.push_back(Positions[P].Next);
+  unsigned To = getState(std::move(Set));
+  // getState() may have moved the states
+  States[From].Next[TokenProperties] = To;
+  return To;
+}
+
+TokenAutomaton &
+TokenAutomatonCache::get(ArrayRef<const TokenRuleInfo *> Rules) {
+  std::string Names;
+  for (const TokenRuleInfo *Info : Rules) {
+    Names += Info->Name;
+    Names += ',';
+  }
+  std::lock_guard<std::mutex> Lock(Mutex);
+  std::unique_ptr<TokenAutomaton> &Automaton =
+      Automata[{std::this_thread::get_id(), Names}];
+  if (!Automaton) {
+    Automaton = std::make_unique<TokenAutomaton>();
+    // Rules of their own compile the patterns, their callbacks are dropped
+    TokenPatternSet Patterns(*Automaton);
+    std::vector<std::unique_ptr<TokenRule>> Created;
+    for (const TokenRuleInfo *Info : Rules) {
+      Created.push_back(Info->Create());
+      Created.back()->registerPatterns(Patterns);
+    }
+  }
+  return *Automaton;
+}
+
+void TokenPatternSet::addPattern(const TokenPattern &Pattern,
+                                 TokenPatternCallback *Callback) {
+  if (Callbacks.size() == Automaton.getNumPatterns())
+    Automaton.addPattern(Pattern);
+  Callbacks.push_back(Callback);
+}
+
+void TokenPatternSet::startTranslationUnit(Preprocessor &PP) {
+  Current = Automaton.getStartState();
+}
+
+void TokenPatternSet::handleToken(const Token &Tok, Preprocessor &PP) {
+  Current = Automaton.getNextState(Current, Tok);
+  for (unsigned Pattern : Automaton.getAccepts(Current))
+    Callbacks[Pattern]->run(Tok, PP);
+}
+
+std::vector<TokenRule *> addTokenPatterns(ArrayRef<TokenRule *> Rules,
+                                          TokenPatternSet &Patterns) {
+  std::vector<TokenRule *> All(Rules.begin(), Rules.end());
+  for (TokenRule *Rule : Rules)
+    Rule->registerPatterns(Patterns);
+  if (!Patterns.empty())
+    All.push_back(&Patterns);
+  return All;
+}
+
+} // namespace misra
@@ -0,0 +1,246 @@
+// Declarative patterns over the token stream, run by one automaton
+#ifndef MISRA_CHECK_TOKENPATTERN_H
+#define MISRA_CHECK_TOKENPATTERN_H
+
+#include "MisraRule.h"
+#include "clang/Basic/TokenKinds.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Lex/Token.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace misra {
+
+// The builders of token patterns, in the style of the AST matchers: a
+// pattern is a regular expression over the tokens, whose letters are classes
+// of tokens, which are built from properties of one token. For example
+// Rule-2.13.3 reports
+//
+//   sequence({kind(tok::kw_unsigned),
+//             zeroOrMore(unless(zeroPrefixedLiteral())),
+//             allOf(zeroPrefixedLiteral(), unless(literalEndsWith('U')))})
+//
+// that is an octal literal without a U suffix, when the unsigned keyword
+// came after the octal literal before it.
+namespace token_patterns {
+
+// A property of one token. Properties are told apart by name: the patterns
+// of all the rules share those with the same name, and each one is tested
+// once per token.
+struct TokenProperty {
+  std::string Name;
+  std::function<bool(const clang::Token &)> Test;
+};
+
+// Tokens of the given kind
+TokenProperty kind(clang::tok::TokenKind Kind);
+// Numeric and character literals whose spelling satisfies Test, which is
+// called Name in the table of properties
+TokenProperty literal(llvm::StringRef Name,
+                      std::function<bool(llvm::StringRef)> Test);
+// Literals of two characters or more starting with 0, e.g. 017 or 0x1F
+TokenProperty zeroPrefixedLiteral();
+// Literals starting with 0x or 0X
+TokenProperty hexLiteral();
+// Literals whose last character is C, or a lower case letter
+TokenProperty literalEndsWith(char C);
+TokenProperty literalEndsWithLowerCase();
+
+// A set of tokens, given by a boolean formula over token properties
+class TokenClass {
+public:
+  TokenClass(TokenProperty Property);
+
+  struct Node;
+  explicit TokenClass(std::shared_ptr<const Node> Root)
+      : Root(std::move(Root)) {}
+  const Node &getRoot() const { return *Root; }
+
+private:
+  std::shared_ptr<const Node> Root;
+};
+
+// Any token
+TokenClass anyToken();
+// The tokens in all, or in any, of the classes
+TokenClass allOf(TokenClass A, TokenClass B);
+TokenClass anyOf(TokenClass A, TokenClass B);
+// The tokens not in the class
+TokenClass unless(TokenClass C);
+
+// A regular expression over the token stream
+class TokenPattern {
+public:
+  // One token of the class
+  TokenPattern(TokenClass Class);
+  TokenPattern(TokenProperty Property) : TokenPattern(TokenClass(Property)) {}
+
+  struct Node;
+  explicit TokenPattern(std::shared_ptr<const Node> Root)
+      : Root(std::move(Root)) {}
+  const Node &getRoot() const { return *Root; }
+
+private:
+  std::shared_ptr<const Node> Root;
+};
+
+// The patterns one after the other
+TokenPattern sequence(std::initializer_list<TokenPattern> Patterns);
+// Any one of the patterns
+TokenPattern alternatives(std::initializer_list<TokenPattern> Patterns);
+// The pattern any number of times, none included
+TokenPattern zeroOrMore(TokenPattern Pattern);
+
+} // namespace token_patterns
+
+// Called at the last token of each match of a pattern
+class TokenPatternCallback {
+public:
+  virtual ~TokenPatternCallback() = default;
+
+  virtual void run(const clang::Token &Tok, clang::Preprocessor &PP) = 0;
+};
+
+// The automaton of the patterns of the token rules. The patterns are compiled
+// into one nondeterministic automaton, whose states are the positions in all
+// the patterns. The deterministic automaton is built from it as the tokens
+// come: each of its states is a set of positions, and its transitions are
+// cached by the set of properties of the token, so once the states reached by
+// the files are known, a token costs the tests of the properties and one
+// lookup, whatever the number of patterns. A match may start at any token.
+//
+// The states are kept from one translation unit to the next, so an automaton
+// is meant to be built once for a selection of rules and used by the
+// TokenPatternSet of each of their translation units. It is not thread safe:
+// each thread needs its own, see TokenAutomatonCache.
+class TokenAutomaton {
+public:
+  TokenAutomaton();
+  ~TokenAutomaton();
+
+  // Compile Pattern, whose index is the number of patterns before it
+  void addPattern(const token_patterns::TokenPattern &Pattern);
+
+  size_t getNumPatterns() const { return Starts.size(); }
+
+  // The state before the first token
+  unsigned getStartState();
+
+  // The state after Tok in state From
+  unsigned getNextState(unsigned From, const clang::Token &Tok);
+
+  // The sorted indices of the patterns that a match ends with in State
+  llvm::ArrayRef<unsigned> getAccepts(unsigned State) const {
+    return States[State].Accepts;
+  }
+
+private:
+  // A TokenClass over the indices of the properties. The operands are
+  // indices in Formulas.
+  struct Formula {
+    enum FormulaKind { AnyToken, HasProperty, Not, And, Or } Kind;
+    unsigned Property;
+    unsigned LHS;
+    unsigned RHS;
+  };
+
+  // A position in the patterns: it either takes one token of a class to its
+  // next position, or goes to other positions without a token
+  struct Position {
+    // Index in Formulas, or -1
+    int Class = -1;
+    unsigned Next = 0;
+    std::vector<unsigned> Epsilon;
+    // The index of the pattern that ends here, or -1
+    int Accepts = -1;
+  };
+
+  struct State {
+    std::vector<unsigned> Positions;
+    std::vector<unsigned> Accepts;
+    llvm::DenseMap<uint32_t, unsigned> Next;
+  };
+
+  unsigned getProperty(const token_patterns::TokenProperty &Property);
+  unsigned compileClass(const token_patterns::TokenClass::Node &Class);
+  std::pair<unsigned, unsigned>
+  compilePattern(const token_patterns::TokenPattern::Node &Pattern);
+  unsigned newPosition();
+  unsigned getState(std::vector<unsigned> Set);
+  bool matches(unsigned Class, uint32_t TokenProperties) const;
+
+  std::vector<token_patterns::TokenProperty> Properties;
+  llvm::StringMap<unsigned> PropertyIndex;
+  std::vector<Formula> Formulas;
+  std::vector<Position> Positions;
+  // The first position of each pattern
+  std::vector<unsigned> Starts;
+  // The deterministic automaton, built as the tokens come
+  std::vector<State> States;
+  std::map<std::vector<unsigned>, unsigned> StateIndex;
+};
+
+// The automata of the token rule selections of a run, so that the files
+// checked with the same token rules share the states built for the files
+// before them. Each thread gets its own automata, as they are not thread
+// safe. The selections of the files differ, since the C files and the
+// prefilter leave out some rules, but there are few of them.
+class TokenAutomatonCache {
+public:
+  // The automaton of the patterns of Rules for the calling thread, built on
+  // first use
+  TokenAutomaton &get(llvm::ArrayRef<const TokenRuleInfo *> Rules);
+
+private:
+  std::mutex Mutex;
+  std::map<std::pair<std::thread::id, std::string>,
+           std::unique_ptr<TokenAutomaton>>
+      Automata;
+};
+
+// Runs the patterns of the token rules of one translation unit in one pass
+// over the tokens, with an automaton that may be shared with the sets of the
+// same rules in other translation units. The callback of a pattern is called
+// once at each token where at least one match of the pattern ends.
+class TokenPatternSet : public TokenRule {
+public:
+  explicit TokenPatternSet(TokenAutomaton &Automaton) : Automaton(Automaton) {}
+
+  // Call Callback at the end of each match of Pattern. The callback is not
+  // owned by the set. The automaton compiles the patterns it does not have
+  // yet, so all the sets of an automaton must add the same patterns in the
+  // same order, which the same rules do.
+  void addPattern(const token_patterns::TokenPattern &Pattern,
+                  TokenPatternCallback *Callback);
+
+  bool empty() const { return Callbacks.empty(); }
+
+  void startTranslationUnit(clang::Preprocessor &PP) override;
+  void handleToken(const clang::Token &Tok, clang::Preprocessor &PP) override;
+
+private:
+  TokenAutomaton &Automaton;
+  std::vector<TokenPatternCallback *> Callbacks;
+  unsigned Current = 0;
+};
+
+// Add the patterns of Rules to Patterns, and return Rules followed by
+// Patterns, unless none of the rules has one
+std::vector<TokenRule *> addTokenPatterns(llvm::ArrayRef<TokenRule *> Rules,
+                                          TokenPatternSet &Patterns);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_TOKENPATTERN_H
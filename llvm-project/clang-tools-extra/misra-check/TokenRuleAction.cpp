@@ -0,0 +1,65 @@
+// Single lex loop shared by all token rules
+#include "TokenRuleAction.h"
+#include "TokenPattern.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "llvm/Support/TimeProfiler.h"
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace misra {
+
+void TokenRuleAction::ExecuteAction() {
+  TimeTraceScope TimeScope("Token rules", getCurrentFile());
+  Preprocessor &PP = getCompilerInstance().getPreprocessor();
+  // The patterns of all the rules are run as one more rule
+  TokenPatternSet Patterns(Automaton);
+  std::vector<TokenRule *> AllRules = addTokenPatterns(Rules, Patterns);
+  for (TokenRule *Rule : AllRules)
+    Rule->startTranslationUnit(PP);
+
+  // Tokenize the input source file once for all the rules
+  PP.EnterMainSourceFile();
+  Token Tok;
+  while (true) {
+    PP.Lex(Tok);
+    if (Tok.is(tok::eof))
+      break;
+    for (TokenRule *Rule : AllRules)
+      Rule->handleToken(Tok, PP);
+  }
+  for (TokenRule *Rule : AllRules)
+    Rule->endTranslationUnit(PP);
+}
+
+namespace {
+class TokenRuleActionFactory : public FrontendActionFactory {
+public:
+  TokenRuleActionFactory(ArrayRef<TokenRule *> Rules,
+                         TokenAutomaton *Automaton)
+      : Rules(Rules.begin(), Rules.end()), Automaton(Automaton) {
+    if (!Automaton) {
+      OwnedAutomaton = std::make_unique<TokenAutomaton>();
+      this->Automaton = OwnedAutomaton.get();
+    }
+  }
+
+  std::unique_ptr<FrontendAction> create() override {
+    return std::make_unique<TokenRuleAction>(Rules, *Automaton);
+  }
+
+private:
+  std::vector<TokenRule *> Rules;
+  TokenAutomaton *Automaton;
+  std::unique_ptr<TokenAutomaton> OwnedAutomaton;
+};
+} // namespace
+
+std::unique_ptr<FrontendActionFactory>
+newTokenRuleActionFactory(ArrayRef<TokenRule *> Rules,
+                          TokenAutomaton *Automaton) {
+  return std::make_unique<TokenRuleActionFactory>(Rules, Automaton);
+}
+
+} // namespace misra
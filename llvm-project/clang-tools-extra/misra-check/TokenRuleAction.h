@@ -0,0 +1,39 @@
+// Frontend action which runs all token rules in a single pass over the tokens
+#ifndef MISRA_CHECK_TOKENRULEACTION_H
+#define MISRA_CHECK_TOKENRULEACTION_H
+
+#include "MisraRule.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Tooling/Tooling.h"
+#include <memory>
+#include <vector>
+
+namespace misra {
+
+class TokenAutomaton;
+
+// Preprocess the main file once and feed every token to each of the rules.
+// The patterns of the rules run on Automaton.
+class TokenRuleAction : public clang::PreprocessorFrontendAction {
+public:
+  TokenRuleAction(llvm::ArrayRef<TokenRule *> Rules, TokenAutomaton &Automaton)
+      : Rules(Rules.begin(), Rules.end()), Automaton(Automaton) {}
+
+protected:
+  void ExecuteAction() override;
+
+private:
+  std::vector<TokenRule *> Rules;
+  TokenAutomaton &Automaton;
+};
+
+// Create a factory for ClangTool::run that runs the given token rules. The
+// rules and Automaton are not owned by the factory and must outlive it.
+// Without an automaton, the factory makes one for all its actions.
+std::unique_ptr<clang::tooling::FrontendActionFactory>
+newTokenRuleActionFactory(llvm::ArrayRef<TokenRule *> Rules,
+                          TokenAutomaton *Automaton = nullptr);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_TOKENRULEACTION_H
@@ -0,0 +1,40 @@
+// Compact records of the violations found by a rule in a translation unit
+#include "ViolationRecorder.h"
+#include "clang/Basic/DiagnosticIDs.h"
+#include "llvm/ADT/SmallVector.h"
+
+using namespace clang;
+using namespace llvm;
+
+namespace misra {
+
+void ViolationRecorder::report(DiagnosticsEngine &Diags,
+                               const SourceManager &SM) {
+  if (Records.empty())
+    return;
+  if (Diags.getSuppressAllDiagnostics()) {
+    Records.clear();
+    return;
+  }
+
+  // Each DiagnosticsEngine needs its own IDs, but they are registered once
+  // per translation unit rather than once per violation
+  SmallVector<unsigned, 4> IDs;
+  SmallVector<bool, 4> NeedsLine;
+  for (StringRef Message : Messages) {
+    IDs.push_back(Diags.getDiagnosticIDs()->getCustomDiagID(
+        DiagnosticIDs::Error, Message));
+    NeedsLine.push_back(Message.contains("%0"));
+  }
+
+  for (const Record &R : Records) {
+    DiagnosticBuilder Builder = Diags.Report(R.Loc, IDs[R.Kind]);
+    // The records are mostly in the order of the source, so the source
+    // manager mostly scans its line table forward from the previous lookup
+    if (NeedsLine[R.Kind])
+      Builder << SM.getSpellingLineNumber(R.Loc);
+  }
+  Records.clear();
+}
+
+} // namespace misra
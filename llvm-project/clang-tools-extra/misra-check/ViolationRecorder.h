@@ -0,0 +1,54 @@
+// Compact records of the violations found by a rule in a translation unit
+#ifndef MISRA_CHECK_VIOLATIONRECORDER_H
+#define MISRA_CHECK_VIOLATIONRECORDER_H
+
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/StringRef.h"
+#include <initializer_list>
+#include <vector>
+
+namespace misra {
+
+// Collects the violations of a rule while a translation unit is checked and
+// reports them all at its end. A violation is only an 8 byte record: which
+// message of the rule, and the SourceLocation, which encodes the FileID and
+// the offset. Nothing is formatted when a violation is found: the diagnostic
+// IDs are registered, the line numbers looked up and the diagnostics reported
+// in one pass by report(), which does nothing if diagnostics are suppressed.
+// The text, the carets and the snippets are then only rendered by the
+// diagnostic consumers that want them.
+class ViolationRecorder {
+public:
+  // The format strings of the diagnostics of the rule, one per kind of
+  // violation. %0 in a message is replaced by the spelling line of the
+  // violation. The strings must outlive the recorder.
+  ViolationRecorder(std::initializer_list<const char *> Messages)
+      : Messages(Messages.begin(), Messages.end()) {}
+
+  // Record a violation of the given kind, an index in the messages
+  void add(clang::SourceLocation Loc, unsigned Kind = 0) {
+    Records.push_back({Kind, Loc});
+  }
+
+  // Report the recorded violations to Diags in the order they were found,
+  // and forget them
+  void report(clang::DiagnosticsEngine &Diags,
+              const clang::SourceManager &SM);
+
+private:
+  struct Record {
+    unsigned Kind;
+    clang::SourceLocation Loc;
+  };
+
+  std::vector<llvm::StringRef> Messages;
+  // Cleared but not freed after each translation unit, so the memory is
+  // reused by the next one
+  std::vector<Record> Records;
+};
+
+} // namespace misra
+
+#endif // MISRA_CHECK_VIOLATIONRECORDER_H
@@ -0,0 +1,307 @@
+// Worker processes that run the tasks of a run
+#include "WorkerPool.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Errno.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <system_error>
+#include <vector>
+
+#ifdef LLVM_ON_UNIX
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace llvm;
+
+namespace misra {
+
+#ifdef LLVM_ON_UNIX
+
+namespace {
+
+bool writeAll(int FD, const void *Data, size_t Size) {
+  const char *Ptr = static_cast<const char *>(Data);
+  while (Size) {
+    ssize_t Written = sys::RetryAfterSignal(-1, ::write, FD, Ptr, Size);
+    if (Written <= 0)
+      return false;
+    Ptr += Written;
+    Size -= Written;
+  }
+  return true;
+}
+
+// Returns false at the end of the pipe
+bool readAll(int FD, void *Data, size_t Size) {
+  char *Ptr = static_cast<char *>(Data);
+  while (Size) {
+    ssize_t Read = sys::RetryAfterSignal(-1, ::read, FD, Ptr, Size);
+    if (Read <= 0)
+      return false;
+    Ptr += Read;
+    Size -= Read;
+  }
+  return true;
+}
+
+// A worker process, as seen by the calling process. The indices of the tasks
+// are sent to the worker as 8 byte integers, and it answers each one with
+// the 8 byte size of the result followed by the result.
+struct Worker {
+  pid_t Pid;
+  // Where the tasks are written, -1 once there is no task left
+  int TaskFD;
+  // Where the results are read
+  int ResultFD;
+  // The task the worker is running, if any, and when it was given
+  Optional<size_t> Task;
+  std::chrono::steady_clock::time_point Started;
+};
+
+[[noreturn]] void runWorker(int TaskFD, int ResultFD, uint64_t MemoryLimitMB,
+                            const WorkerTask &Task) {
+  if (MemoryLimitMB) {
+    rlimit Limit;
+    Limit.rlim_cur = Limit.rlim_max = rlim_t(MemoryLimitMB) << 20;
+    ::setrlimit(RLIMIT_AS, &Limit);
+  }
+  uint64_t Index;
+  while (readAll(TaskFD, &Index, sizeof(Index))) {
+    std::string Result = Task(Index);
+    uint64_t Size = Result.size();
+    if (!writeAll(ResultFD, &Size, sizeof(Size)) ||
+        !writeAll(ResultFD, Result.data(), Result.size()))
+      break;
+  }
+  // The static objects belong to the calling process, which destroys them
+  ::_exit(0);
+}
+
+// How a worker ended, from its status given by waitpid()
+std::string describeExit(int Status) {
+  if (WIFSIGNALED(Status)) {
+    int Signal = WTERMSIG(Status);
+    return ("crashed with signal " + Twine(Signal) + " (" +
+            ::strsignal(Signal) + ")")
+        .str();
+  }
+  if (WIFEXITED(Status))
+    return ("exited with status " + Twine(WEXITSTATUS(Status))).str();
+  return "ended";
+}
+
+class WorkerPool {
+public:
+  WorkerPool(uint64_t MemoryLimitMB, const WorkerTask &Task)
+      : MemoryLimitMB(MemoryLimitMB), Task(Task) {}
+
+  ~WorkerPool() {
+    // A worker that still has its task pipe is running a task
+    for (Worker &W : Workers)
+      stop(W, /*Kill=*/W.TaskFD >= 0);
+  }
+
+  // Fork a new worker
+  std::error_code start() {
+    int Tasks[2], Results[2];
+    if (::pipe(Tasks))
+      return std::error_code(errno, std::generic_category());
+    if (::pipe(Results)) {
+      std::error_code EC(errno, std::generic_category());
+      ::close(Tasks[0]);
+      ::close(Tasks[1]);
+      return EC;
+    }
+    pid_t Pid = ::fork();
+    if (Pid < 0) {
+      std::error_code EC(errno, std::generic_category());
+      for (int FD : {Tasks[0], Tasks[1], Results[0], Results[1]})
+        ::close(FD);
+      return EC;
+    }
+    if (Pid == 0) {
+      // A worker only keeps its own pipes, or the other workers would not
+      // see the end of their task pipe when it is closed
+      for (const Worker &Other : Workers) {
+        if (Other.TaskFD >= 0)
+          ::close(Other.TaskFD);
+        ::close(Other.ResultFD);
+      }
+      ::close(Tasks[1]);
+      ::close(Results[0]);
+      runWorker(Tasks[0], Results[1], MemoryLimitMB, Task);
+    }
+    ::close(Tasks[0]);
+    ::close(Results[1]);
+    Workers.push_back(Worker{Pid, Tasks[1], Results[0], None, {}});
+    return std::error_code();
+  }
+
+  // Close the pipes of a worker and wait for it to end. Returns how it ended.
+  std::string stop(Worker &W, bool Kill) {
+    if (W.TaskFD >= 0)
+      ::close(W.TaskFD);
+    ::close(W.ResultFD);
+    if (Kill)
+      ::kill(W.Pid, SIGKILL);
+    int Status = 0;
+    sys::RetryAfterSignal(-1, ::waitpid, W.Pid, &Status, 0);
+    return describeExit(Status);
+  }
+
+  std::vector<Worker> Workers;
+
+private:
+  uint64_t MemoryLimitMB;
+  const WorkerTask &Task;
+};
+
+} // namespace
+
+void runInWorkers(size_t NumTasks, unsigned NumWorkers,
+                  uint64_t MemoryLimitMB, std::chrono::seconds TaskTimeout,
+                  WorkerTask Task, WorkerResultHandler Done,
+                  WorkerFailureHandler Failed) {
+  if (!NumTasks)
+    return;
+  outs().flush();
+  errs().flush();
+
+  // Writing a task to a worker that is gone fails with EPIPE instead of
+  // killing this process, and reading its result then reports it
+  struct sigaction Ignore, Previous;
+  std::memset(&Ignore, 0, sizeof(Ignore));
+  Ignore.sa_handler = SIG_IGN;
+  ::sigaction(SIGPIPE, &Ignore, &Previous);
+
+  {
+    WorkerPool Pool(MemoryLimitMB, Task);
+    // Why the tasks left cannot be run
+    std::error_code Error;
+    size_t Next = 0;
+    // Give the next task to a worker, or close its task pipe, which makes it
+    // exit, when there is none left
+    auto Assign = [&](Worker &W) {
+      if (Next == NumTasks) {
+        ::close(W.TaskFD);
+        W.TaskFD = -1;
+        return;
+      }
+      W.Task = Next++;
+      W.Started = std::chrono::steady_clock::now();
+      uint64_t Index = *W.Task;
+      writeAll(W.TaskFD, &Index, sizeof(Index));
+    };
+
+    for (unsigned I = 0; I < std::max(1u, NumWorkers) && I < NumTasks; ++I)
+      if ((Error = Pool.start()))
+        break;
+    for (Worker &W : Pool.Workers)
+      Assign(W);
+
+    while (true) {
+      // Wait for a result, or for the first task to run out of time
+      std::vector<pollfd> Busy;
+      int Timeout = -1;
+      auto Now = std::chrono::steady_clock::now();
+      for (const Worker &W : Pool.Workers) {
+        if (!W.Task)
+          continue;
+        Busy.push_back(pollfd{W.ResultFD, POLLIN, 0});
+        if (TaskTimeout.count()) {
+          auto Left = std::chrono::duration_cast<std::chrono::milliseconds>(
+              W.Started + TaskTimeout - Now);
+          int LeftMS = int(std::min<int64_t>(
+              std::max<int64_t>(0, Left.count() + 1), INT_MAX));
+          Timeout = Timeout < 0 ? LeftMS : std::min(Timeout, LeftMS);
+        }
+      }
+      if (Busy.empty())
+        break;
+      if (sys::RetryAfterSignal(-1, ::poll, Busy.data(), Busy.size(),
+                                Timeout) < 0) {
+        Error = std::error_code(errno, std::generic_category());
+        for (Worker &W : Pool.Workers)
+          if (W.Task)
+            Failed(*W.Task, "was stopped: " + Error.message());
+        break;
+      }
+
+      for (const pollfd &Ready : Busy) {
+        if (!Ready.revents)
+          continue;
+        auto It = llvm::find_if(Pool.Workers, [&](const Worker &W) {
+          return W.ResultFD == Ready.fd;
+        });
+        size_t Index = *It->Task;
+        It->Task.reset();
+        uint64_t Size;
+        std::string Result;
+        if (readAll(It->ResultFD, &Size, sizeof(Size))) {
+          Result.resize(Size);
+          if (readAll(It->ResultFD, &Result[0], Size)) {
+            Done(Index, std::move(Result));
+            Assign(*It);
+            continue;
+          }
+        }
+        // The worker ended during the task, another one takes its place
+        std::string Reason = Pool.stop(*It, /*Kill=*/false);
+        Pool.Workers.erase(It);
+        Failed(Index, Reason);
+        if (Next < NumTasks && !(Error = Pool.start()))
+          Assign(Pool.Workers.back());
+      }
+
+      if (!TaskTimeout.count())
+        continue;
+      Now = std::chrono::steady_clock::now();
+      for (size_t I = 0; I < Pool.Workers.size();) {
+        Worker &W = Pool.Workers[I];
+        if (!W.Task || Now < W.Started + TaskTimeout) {
+          ++I;
+          continue;
+        }
+        size_t Index = *W.Task;
+        Pool.stop(W, /*Kill=*/true);
+        Pool.Workers.erase(Pool.Workers.begin() + I);
+        Failed(Index, ("was stopped after " + Twine(TaskTimeout.count()) +
+                       " seconds")
+                          .str());
+        if (Next < NumTasks && !(Error = Pool.start()))
+          Assign(Pool.Workers.back());
+      }
+    }
+
+    // The tasks left when no worker can be started
+    for (; Next < NumTasks; ++Next)
+      Failed(Next, "could not be started: " + Error.message());
+  }
+
+  ::sigaction(SIGPIPE, &Previous, nullptr);
+}
+
+#else // LLVM_ON_UNIX
+
+void runInWorkers(size_t NumTasks, unsigned NumWorkers,
+                  uint64_t MemoryLimitMB, std::chrono::seconds TaskTimeout,
+                  WorkerTask Task, WorkerResultHandler Done,
+                  WorkerFailureHandler Failed) {
+  for (size_t Index = 0; Index < NumTasks; ++Index)
+    Failed(Index, "could not be started: worker processes need Unix");
+}
+
+#endif // LLVM_ON_UNIX
+
+} // namespace misra
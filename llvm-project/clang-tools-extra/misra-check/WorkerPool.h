@@ -0,0 +1,53 @@
+// Worker processes that run the tasks of a run, so that one that crashes or
+// runs out of memory only fails its own task
+#ifndef MISRA_CHECK_WORKERPOOL_H
+#define MISRA_CHECK_WORKERPOOL_H
+
+#include "llvm/ADT/StringRef.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace misra {
+
+// Runs task Index in a worker process and returns its result
+using WorkerTask = std::function<std::string(size_t Index)>;
+// Called in the calling process with the result of a task
+using WorkerResultHandler =
+    std::function<void(size_t Index, std::string Result)>;
+// Called in the calling process for a task whose worker ended before giving
+// its result. Reason tells how, e.g. "crashed with signal 11 (Segmentation
+// fault)".
+using WorkerFailureHandler =
+    std::function<void(size_t Index, llvm::StringRef Reason)>;
+
+// Run the tasks 0 to NumTasks - 1 in NumWorkers processes forked from this
+// one. Each worker runs one task at a time and sends its result back through
+// a pipe, and Done is called with it as soon as it arrives. A worker that
+// crashes or exits during a task is replaced by a new one, and Failed is
+// called for the task, which is not run again.
+//
+// If MemoryLimitMB is not 0, the address space of each worker is limited to
+// that many megabytes with setrlimit(RLIMIT_AS), which makes its allocations
+// fail, and the worker abort, rather than the machine swap. RLIMIT_RSS is not
+// enforced by Linux. The limit counts the memory the worker shares with the
+// calling process too.
+//
+// If TaskTimeout is not 0, a worker that is still running a task that long
+// after it was given is killed, and its task fails too.
+//
+// The workers are forked from the calling thread, so there must be no other
+// thread at that point: a worker would never see the locks that another
+// thread held at the fork released, e.g. that of malloc. outs() and errs()
+// are flushed before the fork, the other buffered streams of the caller must
+// be flushed by it, or a worker that calls exit() writes their buffer again.
+// Only the processes of Unix are supported; elsewhere every task fails.
+void runInWorkers(size_t NumTasks, unsigned NumWorkers,
+                  uint64_t MemoryLimitMB, std::chrono::seconds TaskTimeout,
+                  WorkerTask Task,
+                  WorkerResultHandler Done, WorkerFailureHandler Failed);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_WORKERPOOL_H
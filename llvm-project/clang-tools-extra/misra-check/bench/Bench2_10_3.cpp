@@ -0,0 +1,101 @@
+// Measure how the time of Rule-2.10.3 grows with the number of declarations
+#include "MisraRule.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <string>
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace clang::tooling;
+using namespace llvm;
+
+static cl::opt<unsigned> MaxDecls(
+    "max", cl::desc("Largest number of declarations to check"),
+    cl::init(1000000));
+
+static cl::opt<unsigned> DeclsPerFunction(
+    "per-function", cl::desc("Number of declarations in each function body"),
+    cl::init(1000));
+
+// Generate a file with NumDecls local declarations. Every tenth one is a
+// typedef and every hundredth one is a typedef, in a nested block, that reuses
+// the name of the variable declared just before it. So the rule has both
+// lookups that miss and lookups that report a violation.
+static std::string generate(unsigned NumDecls) {
+  std::string Code;
+  raw_string_ostream OS(Code);
+  for (unsigned I = 0; I < NumDecls; ++I) {
+    if (I % DeclsPerFunction == 0)
+      OS << (I ? "}\n" : "") << "void f" << I << "() {\n";
+    if (I % 100 == 99)
+      OS << "  { typedef int v" << I - 1 << "; }\n";
+    else if (I % 10 == 9)
+      OS << "  typedef int t" << I << ";\n";
+    else
+      OS << "  int v" << I << ";\n";
+  }
+  if (NumDecls)
+    OS << "}\n";
+  return OS.str();
+}
+
+int main(int argc, const char **argv) {
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Scaling benchmark of MISRA C++ Rule 2.10.3\n");
+
+  outs() << "   decls   parse (ms)   rule (ms)   rule (ns/decl)\n";
+  for (unsigned N = 1000; N <= MaxDecls; N *= 10) {
+    // The violations are counted by the rule but not printed
+    IgnoringDiagConsumer Diags;
+    auto ParseStart = std::chrono::steady_clock::now();
+    std::unique_ptr<ASTUnit> AST = buildASTFromCodeWithArgs(
+        generate(N), {"-fsyntax-only"}, "bench.cpp", "misra-bench",
+        std::make_shared<PCHContainerOperations>(),
+        getClangStripDependencyFileAdjuster(), FileContentMappings(), &Diags);
+    if (!AST) {
+      errs() << "misra-bench: failed to parse the generated file\n";
+      return 1;
+    }
+
+    auto Rule = misra::createRule2_10_3();
+    MatchFinder Finder;
+    Rule->registerMatchers(Finder);
+    auto RuleStart = std::chrono::steady_clock::now();
+    Finder.matchAST(AST->getASTContext());
+    auto End = std::chrono::steady_clock::now();
+
+    double ParseMs =
+        std::chrono::duration<double, std::milli>(RuleStart - ParseStart)
+            .count();
+    double RuleMs =
+        std::chrono::duration<double, std::milli>(End - RuleStart).count();
+    outs() << format("%8u %12.1f %11.1f %16.1f\n", N, ParseMs, RuleMs,
+                     RuleMs * 1e6 / N);
+  }
+  return 0;
+}
+
+                                  //DOCUMENTATION
+/*
+misra-bench-2.10.3 checks that the time taken by Rule-2.10.3 grows linearly
+with the number of declarations in a translation unit. For 1000, 10000, ...
+up to --max declarations (1000000 by default) it generates a file of local
+variable and typedef declarations, parses it with buildASTFromCodeWithArgs and
+then runs only the matchers of the rule on the AST with MatchFinder::matchAST.
+Parsing and matching are timed separately.
+
+The last column is the matching time divided by the number of declarations.
+Since the rule looks every name up in a DenseMap keyed by its IdentifierInfo,
+this column should stay about the same from one line to the next. With the
+old linear scan over vectors of strings it grew with the number of
+declarations.
+
+Example:
+  misra-bench-2.10.3 --max=1000000 --per-function=1000
+*/
@@ -0,0 +1,121 @@
+// Measure how the time of Rule-5.0.13 grows with the nesting of statements
+#include "MisraRule.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <string>
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+static cl::opt<unsigned> MaxDepth(
+    "max-depth", cl::desc("Deepest nesting of statements to check"),
+    cl::init(512));
+
+static cl::opt<unsigned> ConditionsPerLevel(
+    "per-level",
+    cl::desc("Number of if statements beside the nested one at each level"),
+    cl::init(10));
+
+// Generate a function whose body nests if, while, for and do statements, in
+// turn, Depth times. Every condition is an int, so each one is a violation,
+// and at each level there are more if statements beside the nested one. No
+// variable is declared inside the statements, so the rule cannot skip any of
+// them and has to look at every enclosing statement of every condition.
+static std::string generate(unsigned Depth) {
+  std::string Code;
+  raw_string_ostream OS(Code);
+  OS << "void f(int v) {\n";
+  for (unsigned I = 0; I < Depth; ++I) {
+    for (unsigned J = 0; J < ConditionsPerLevel; ++J)
+      OS << "if (v) {}\n";
+    switch (I % 4) {
+    case 0:
+      OS << "if (v) {\n";
+      break;
+    case 1:
+      OS << "while (v) {\n";
+      break;
+    case 2:
+      OS << "for (; v;) {\n";
+      break;
+    case 3:
+      OS << "do {\n";
+      break;
+    }
+  }
+  for (unsigned I = Depth; I > 0; --I)
+    OS << ((I - 1) % 4 == 3 ? "} while (v);\n" : "}\n");
+  OS << "}\n";
+  return OS.str();
+}
+
+int main(int argc, const char **argv) {
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Nesting benchmark of MISRA C++ Rule 5.0.13\n");
+
+  // Clang stops at 256 nested brackets by default
+  std::string BracketDepth =
+      "-fbracket-depth=" + std::to_string(MaxDepth + 16);
+
+  outs() << "   depth   conditions   parse (ms)   rule (ms)   rule (ns/cond)\n";
+  for (unsigned Depth = 16; Depth <= MaxDepth; Depth *= 2) {
+    unsigned Conditions = Depth * (ConditionsPerLevel + 1);
+    // The violations are counted by the rule but not printed
+    IgnoringDiagConsumer Diags;
+    auto ParseStart = std::chrono::steady_clock::now();
+    std::unique_ptr<ASTUnit> AST = buildASTFromCodeWithArgs(
+        generate(Depth), {"-fsyntax-only", BracketDepth}, "bench.cpp",
+        "misra-bench", std::make_shared<PCHContainerOperations>(),
+        getClangStripDependencyFileAdjuster(), FileContentMappings(), &Diags);
+    if (!AST) {
+      errs() << "misra-bench: failed to parse the generated file\n";
+      return 1;
+    }
+
+    // Only the condition checker of the rule runs, not its operator checks
+    auto Rule = misra::createRule5_0_13();
+    std::unique_ptr<ASTConsumer> Consumer = Rule->newASTConsumer();
+    auto RuleStart = std::chrono::steady_clock::now();
+    Consumer->HandleTranslationUnit(AST->getASTContext());
+    auto End = std::chrono::steady_clock::now();
+
+    double ParseMs =
+        std::chrono::duration<double, std::milli>(RuleStart - ParseStart)
+            .count();
+    double RuleMs =
+        std::chrono::duration<double, std::milli>(End - RuleStart).count();
+    outs() << format("%8u %12u %12.1f %11.1f %16.1f\n", Depth, Conditions,
+                     ParseMs, RuleMs, RuleMs * 1e6 / Conditions);
+  }
+  return 0;
+}
+
+                                  //DOCUMENTATION
+/*
+misra-bench-5.0.13 checks that the time taken by the condition checker of
+Rule-5.0.13 grows linearly with the number of conditions, however deeply the
+statements are nested. For a nesting depth of 16, 32, ... up to --max-depth
+(512 by default) it generates one function that nests if, while, for and
+do-while statements in turn, with --per-level more if statements beside the
+nested one at each level. All the conditions are ints and no variable is
+declared inside the statements, so every condition is a violation. The file is
+parsed with buildASTFromCodeWithArgs, with -fbracket-depth raised to allow the
+nesting, and then only the ASTConsumer of the rule is run on the AST. Parsing
+and checking are timed separately.
+
+The last column is the checking time divided by the number of conditions. The
+checker walks the AST once and keeps each cast once, so this column should stay
+about the same from one line to the next. With the earlier matcher, every cast
+looked at all its enclosing statements and searched the subtree of each of them
+for a variable declaration, so the column grew with the depth.
+
+Example:
+  misra-bench-5.0.13 --max-depth=1024 --per-level=10
+*/
@@ -0,0 +1,116 @@
+// Check that the block scans of the numbers agree with scanFeatures(), then
+// measure their throughput
+#include "MisraRule.h"
+#include "Prefilter.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <random>
+#include <string>
+
+using namespace misra;
+using namespace llvm;
+
+static cl::opt<unsigned> NumBuffers(
+    "buffers", cl::desc("Number of random buffers to check"),
+    cl::init(100000));
+
+static cl::opt<unsigned> Seed("seed", cl::desc("Seed of the random buffers"),
+                              cl::init(1));
+
+static cl::opt<unsigned> MegaBytes(
+    "size", cl::desc("Size in MiB of the text whose scan is timed"),
+    cl::init(64));
+
+struct ScanPath {
+  const char *Name;
+  NumberScanBlocks Blocks;
+};
+
+static const ScanPath Paths[] = {{"scalar", NumberScanBlocks::Scalar},
+                                 {"sse2", NumberScanBlocks::SSE2},
+                                 {"avx2", NumberScanBlocks::AVX2}};
+
+// The bytes of the random buffers: the characters of numbers, of identifiers
+// and of UTF-8 sequences. There is no #, %: or ??, for which scanFeatures()
+// gives up, and no backslash, since only scanNumberFeatures() splices lines.
+static const char Alphabet[] = "0123456789.xXeEpP+-'uUlLfFaAbB_$ \n;(\xc3\xa9";
+
+// Literals of every feature, and a digit that is part of an identifier
+static const char *const Literals[] = {"0x1Fu", "017",    "1.5e-3f", "1'000ul",
+                                       ".5f",   "0X1p+3", "0b101",   "x9"};
+
+static bool check(const std::string &Text, unsigned &NumChecks) {
+  unsigned Expected = scanFeatures(Text) & SF_Numbers;
+  for (const ScanPath &Path : Paths) {
+    if (!hasNumberScanBlocks(Path.Blocks))
+      continue;
+    ++NumChecks;
+    unsigned Found = scanNumberFeatures(Text, Path.Blocks);
+    if (Found == Expected)
+      continue;
+    errs() << "misra-bench: the " << Path.Name << " scan found "
+           << format_hex(Found, 6) << " instead of " << format_hex(Expected, 6)
+           << " in \"";
+    errs().write_escaped(Text) << "\"\n";
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, const char **argv) {
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Check and benchmark of the prefilter scans\n");
+
+  unsigned NumChecks = 0;
+  // Every literal at every offset of buffers of up to three 32 byte blocks,
+  // so that some cross the ends of the 16 and 32 byte blocks and of the text,
+  // after spaces or after an identifier that it would continue
+  for (const char *Literal : Literals)
+    for (char Filler : {' ', 'a'})
+      for (size_t Size = 0; Size <= 96; ++Size)
+        for (size_t Offset = 0; Offset <= Size; ++Offset) {
+          std::string Text(Size, Filler);
+          Text.replace(Offset, StringRef(Literal).size(), Literal);
+          if (!check(Text, NumChecks))
+            return 1;
+        }
+
+  std::mt19937 Random(Seed);
+  std::uniform_int_distribution<size_t> Length(0, 80);
+  std::uniform_int_distribution<size_t> Char(0, sizeof(Alphabet) - 2);
+  for (unsigned I = 0; I < NumBuffers; ++I) {
+    std::string Text(Length(Random), ' ');
+    for (char &C : Text)
+      C = Alphabet[Char(Random)];
+    if (!check(Text, NumChecks))
+      return 1;
+  }
+  outs() << "checked " << NumChecks << " scans\n";
+
+  // Code where most bytes cannot start a number, with one now and then. The
+  // numbers have no suffix, so that no scan stops early.
+  std::string Text;
+  Text.reserve(size_t(MegaBytes) << 20);
+  for (unsigned I = 0; Text.size() < (size_t(MegaBytes) << 20); ++I)
+    Text += "  value_" + std::to_string(I) + " = compute(x1, y2) + " +
+            std::to_string(I % 1000) + ";\n";
+
+  outs() << "    scan   time (ms)   MiB/s\n";
+  for (const ScanPath &Path : Paths) {
+    if (!hasNumberScanBlocks(Path.Blocks))
+      continue;
+    auto Start = std::chrono::steady_clock::now();
+    unsigned Features = scanNumberFeatures(Text, Path.Blocks);
+    double Ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - Start)
+                    .count();
+    // Use the result, so that the scan is not optimized out
+    if (Features & SF_HexNumber)
+      errs() << "misra-bench: unexpected hexadecimal number\n";
+    outs() << format("%8s %11.1f %7.0f\n", Path.Name, Ms,
+                     Text.size() / 1048576.0 / (Ms / 1000));
+  }
+  return 0;
+}
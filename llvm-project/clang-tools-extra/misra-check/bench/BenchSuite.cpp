@@ -0,0 +1,455 @@
+// Measure the throughput and peak memory of every rule on a generated corpus
+#include "MisraRule.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<unsigned> NumFiles("files",
+                                  cl::desc("Number of files to generate"),
+                                  cl::init(20));
+
+static cl::opt<unsigned> LinesPerFile("lines",
+                                      cl::desc("Number of lines in each file"),
+                                      cl::init(2000));
+
+static cl::opt<double> Density(
+    "density",
+    cl::desc("Number of violations of each rule per 100 lines of code"),
+    cl::init(1.0));
+
+static cl::opt<unsigned> NestingDepth(
+    "nesting", cl::desc("Depth of the nested if statements in each file"),
+    cl::init(64));
+
+static cl::opt<unsigned> TableSize(
+    "table-size",
+    cl::desc("Number of hexadecimal literals in the table of each file"),
+    cl::init(1000));
+
+static cl::list<std::string> RuleNames(
+    "rules", cl::desc("Rules to measure, all of them by default"),
+    cl::CommaSeparated);
+
+static cl::opt<unsigned> Repeat(
+    "repeat", cl::desc("Number of runs of each rule, the fastest is kept"),
+    cl::init(1));
+
+static cl::opt<unsigned> Jobs("j", cl::desc("Jobs given to misra-check"),
+                              cl::init(1));
+
+static cl::opt<std::string>
+    MisraCheckPath("misra-check",
+                   cl::desc("misra-check executable, by default the one next "
+                            "to this executable"));
+
+static cl::opt<std::string> CorpusDir(
+    "corpus-dir",
+    cl::desc("Directory of the generated files, a temporary one if empty"));
+
+static cl::opt<std::string>
+    OutputFile("output", cl::desc("JSON file receiving the results"),
+               cl::init("misra-bench.json"));
+
+namespace {
+
+// Code that violates one rule, on one line inside a function whose parameters
+// are int a, unsigned int u, bool b1, bool b2 and float f. @ is replaced by a
+// number unique in the file.
+struct ViolationPattern {
+  const char *Rule;
+  const char *Code;
+};
+
+const ViolationPattern Patterns[] = {
+    {"2.10.3", "int t@ = a; { typedef int t@; }"},
+    {"2.13.2", "a = a + 017;"},
+    {"2.13.3", "u = u + 0x1f;"},
+    {"2.13.4", "u = u + 3u;"},
+    {"3.9.3", "a = a + 0x7f;"},
+    {"4.5.1", "a = b1 & b2;"},
+    {"4.5.2", "a = C1 * C2;"},
+    {"5.0.5", "a = f;"},
+    {"5.0.13", "if (a) { a--; }"},
+    {"5.0.14", "a = a ? 1 : 2;"},
+    {"5.0.21", "a = a | 1;"},
+    {"5.3.1", "if (!a) { a++; }"},
+    {"5.3.2", "u = -u;"},
+    {"7.1", "a = a + 013;"},
+};
+
+// Lines of the body of each generated function
+const unsigned LinesPerFunction = 50;
+
+// Writes the code of the corpus and counts its lines
+class CorpusWriter {
+public:
+  CorpusWriter(raw_ostream &OS, unsigned FileIndex)
+      : OS(OS), FileIndex(FileIndex) {}
+
+  void line(const Twine &Text) {
+    OS << Text << "\n";
+    ++NumLines;
+  }
+
+  unsigned getFileIndex() const { return FileIndex; }
+  unsigned getNumLines() const { return NumLines; }
+  unsigned newNumber() { return NextNumber++; }
+
+private:
+  raw_ostream &OS;
+  unsigned FileIndex;
+  unsigned NumLines = 0;
+  unsigned NextNumber = 0;
+};
+
+// A table of hexadecimal literals, all with their U suffix, as in the
+// generated lookup tables of embedded code. They are lexed by every token
+// rule but violate none.
+void writeTable(CorpusWriter &W) {
+  if (!TableSize)
+    return;
+  W.line("static const unsigned int table" + Twine(W.getFileIndex()) +
+         "[] = {");
+  for (unsigned I = 0; I < TableSize; I += 8) {
+    std::string Line = " ";
+    for (unsigned J = I; J < std::min(I + 8, unsigned(TableSize)); ++J)
+      Line += " 0x" + utohexstr(J * 2654435761u % 0x10000) + "U,";
+    W.line(Line);
+  }
+  W.line("};");
+}
+
+// Nested if statements with compliant conditions, which make the traversals
+// deep
+void writeNesting(CorpusWriter &W) {
+  if (!NestingDepth)
+    return;
+  W.line("void deep" + Twine(W.getFileIndex()) + "(int a) {");
+  for (unsigned I = 0; I < NestingDepth; ++I)
+    W.line("if (a > " + Twine(I) + ") {");
+  W.line("a = a + 1;");
+  for (unsigned I = 0; I < NestingDepth; ++I)
+    W.line("}");
+  W.line("}");
+}
+
+// Functions of compliant statements, with the violations of each rule spread
+// among them at the requested density, until the file has LinesPerFile lines
+void writeFunctions(CorpusWriter &W, ArrayRef<const ViolationPattern *> Used) {
+  // The violations of each rule are placed when their share of the lines
+  // written adds up to one. The shares start apart, so the violations of the
+  // rules do not all fall on the same lines.
+  std::vector<double> Due(Used.size());
+  for (size_t R = 0; R < Used.size(); ++R)
+    Due[R] = double(R) / Used.size();
+
+  for (unsigned F = 0; W.getNumLines() < LinesPerFile; ++F) {
+    W.line("void f" + Twine(W.getFileIndex()) + "_" + Twine(F) +
+           "(int a, unsigned int u, bool b1, bool b2, float f) {");
+    for (unsigned L = 0;
+         L < LinesPerFunction && W.getNumLines() + 1 < LinesPerFile; ++L) {
+      bool Violated = false;
+      for (size_t R = 0; R < Used.size(); ++R) {
+        Due[R] += Density.getValue() / 100;
+        if (Due[R] < 1)
+          continue;
+        Due[R] -= 1;
+        std::string Code = Used[R]->Code;
+        std::string Number = std::to_string(W.newNumber());
+        for (size_t At = Code.find('@'); At != std::string::npos;
+             At = Code.find('@', At + Number.size()))
+          Code.replace(At, 1, Number);
+        W.line(Code);
+        Violated = true;
+      }
+      if (!Violated)
+        W.line("a = a + " + Twine(L + 1) + ";");
+    }
+    W.line("}");
+  }
+}
+
+// The time and memory of the runs of misra-check for one rule, or for all
+struct RunResult {
+  std::string Rule;
+  double WallSeconds = 0;
+  double CPUSeconds = 0;
+  uint64_t PeakMemoryKiB = 0;
+  unsigned Matches = 0;
+  unsigned CompileErrors = 0;
+};
+
+// Count the violations and the compile errors in the JSON Lines output of
+// misra-check
+bool countDiagnostics(StringRef Path, RunResult &Result) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFile(Path);
+  if (!Buffer) {
+    errs() << "misra-bench: cannot read '" << Path
+           << "': " << Buffer.getError().message() << "\n";
+    return false;
+  }
+  SmallVector<StringRef, 0> Lines;
+  (*Buffer)->getBuffer().split(Lines, '\n', -1, /*KeepEmpty=*/false);
+  for (StringRef Line : Lines) {
+    Expected<json::Value> Record = json::parse(Line);
+    if (!Record) {
+      consumeError(Record.takeError());
+      continue;
+    }
+    const json::Object *Object = Record->getAsObject();
+    Optional<StringRef> Rule = Object ? Object->getString("rule") : None;
+    if (Rule && Rule->startswith("clang-diagnostic-")) {
+      Optional<StringRef> Level = Object->getString("level");
+      if (Level && *Level == "error")
+        ++Result.CompileErrors;
+    } else {
+      ++Result.Matches;
+    }
+  }
+  return true;
+}
+
+// Run misra-check Repeat times with Args and keep the fastest run
+bool runMisraCheck(StringRef Program, ArrayRef<std::string> Args,
+                   StringRef OutputPath, RunResult &Result) {
+  std::vector<StringRef> Argv{Program};
+  Argv.insert(Argv.end(), Args.begin(), Args.end());
+  // The diagnostics go to OutputPath, discard everything else
+  Optional<StringRef> Redirects[] = {None, StringRef(""), StringRef("")};
+
+  Result.WallSeconds = -1;
+  for (unsigned I = 0; I < std::max(1u, unsigned(Repeat)); ++I) {
+    Optional<sys::ProcessStatistics> Statistics;
+    std::string ErrorMessage;
+    auto Start = std::chrono::steady_clock::now();
+    // misra-check exits with 1 when it reports a violation, which is not a
+    // failure here
+    int Status = sys::ExecuteAndWait(Program, Argv, None, Redirects,
+                                     /*SecondsToWait=*/0, /*MemoryLimit=*/0,
+                                     &ErrorMessage, nullptr, &Statistics);
+    double Seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - Start)
+                         .count();
+    if (Status < 0) {
+      errs() << "misra-bench: running " << Program << " failed"
+             << (ErrorMessage.empty() ? "" : ": ") << ErrorMessage << "\n";
+      return false;
+    }
+    if (Result.WallSeconds >= 0 && Seconds >= Result.WallSeconds)
+      continue;
+    Result.WallSeconds = Seconds;
+    if (Statistics) {
+      Result.CPUSeconds = Statistics->TotalTime.count() / 1e6;
+      Result.PeakMemoryKiB = Statistics->PeakMemory;
+    }
+  }
+  Result.Matches = Result.CompileErrors = 0;
+  return countDiagnostics(OutputPath, Result);
+}
+
+} // namespace
+
+int main(int argc, const char **argv) {
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Throughput benchmark of the MISRA rules\n");
+
+  // The rules to measure, in the order of the registry
+  std::vector<std::string> Rules;
+  for (const misra::ASTRuleInfo &Info : misra::getASTRules())
+    Rules.push_back(Info.Name);
+  for (const misra::TokenRuleInfo &Info : misra::getTokenRules())
+    Rules.push_back(Info.Name);
+  if (!RuleNames.empty()) {
+    for (const std::string &Name : RuleNames)
+      if (!is_contained(Rules, Name)) {
+        errs() << "misra-bench: unknown rule '" << Name << "'\n";
+        return 1;
+      }
+    Rules.assign(RuleNames.begin(), RuleNames.end());
+  }
+
+  std::string Program = MisraCheckPath;
+  if (Program.empty()) {
+    // The address of main identifies this executable
+    void *MainAddr = (void *)(intptr_t)main;
+    SmallString<256> Path(sys::fs::getMainExecutable(argv[0], MainAddr));
+    sys::path::remove_filename(Path);
+    sys::path::append(Path, "misra-check");
+    Program = std::string(Path);
+  }
+  if (!sys::fs::can_execute(Program)) {
+    errs() << "misra-bench: cannot execute '" << Program
+           << "', see --misra-check\n";
+    return 1;
+  }
+
+  SmallString<256> Dir(CorpusDir);
+  bool TemporaryDir = Dir.empty();
+  std::error_code EC = TemporaryDir
+                           ? sys::fs::createUniqueDirectory("misra-bench", Dir)
+                           : sys::fs::create_directories(Dir);
+  if (EC) {
+    errs() << "misra-bench: cannot create the corpus directory: "
+           << EC.message() << "\n";
+    return 1;
+  }
+
+  // Every measured rule has its violations in the corpus, whichever rule is
+  // run, so all the runs check the same files
+  std::vector<const ViolationPattern *> Used;
+  for (const ViolationPattern &Pattern : Patterns)
+    if (is_contained(Rules, Pattern.Rule))
+      Used.push_back(&Pattern);
+
+  std::vector<std::string> Files;
+  uint64_t NumLines = 0;
+  for (unsigned I = 0; I < NumFiles; ++I) {
+    SmallString<256> Path(Dir);
+    sys::path::append(Path, "bench" + Twine(I) + ".cpp");
+    raw_fd_ostream OS(Path, EC, sys::fs::OF_Text);
+    if (EC) {
+      errs() << "misra-bench: cannot write '" << Path
+             << "': " << EC.message() << "\n";
+      return 1;
+    }
+    CorpusWriter W(OS, I);
+    W.line("// Generated by misra-bench");
+    W.line("enum Colour { C0, C1, C2 };");
+    writeTable(W);
+    writeNesting(W);
+    writeFunctions(W, Used);
+    NumLines += W.getNumLines();
+    Files.push_back(std::string(Path));
+  }
+
+  SmallString<256> OutputPath(Dir);
+  sys::path::append(OutputPath, "diagnostics.jsonl");
+  std::vector<std::string> Args{"-j", std::to_string(Jobs), "--format=jsonl",
+                                "--output=" + std::string(OutputPath)};
+  Args.insert(Args.end(), Files.begin(), Files.end());
+  Args.push_back("--");
+  Args.push_back("-std=c++14");
+  // Clang stops at 256 nested brackets by default
+  Args.push_back("-fbracket-depth=" + std::to_string(NestingDepth + 16));
+
+  // Each rule on its own, then all of them together
+  std::vector<std::string> Runs = Rules;
+  Runs.push_back("all");
+  std::vector<RunResult> Results;
+  outs() << format("corpus: %u files, %llu lines, %.2f violations per 100 "
+                   "lines of each rule\n",
+                   unsigned(NumFiles), (unsigned long long)NumLines,
+                   double(Density));
+  outs() << "    rule   wall (s)    cpu (s)    files/s      lines/s   "
+            "matches    matches/s   peak RSS (MiB)\n";
+  for (const std::string &Rule : Runs) {
+    std::vector<std::string> RunArgs = Args;
+    std::string Selected = Rule;
+    if (Rule == "all")
+      Selected = join(Rules, ",");
+    RunArgs.insert(RunArgs.begin(), "--rules=" + Selected);
+
+    RunResult Result;
+    Result.Rule = Rule;
+    if (!runMisraCheck(Program, RunArgs, OutputPath, Result))
+      return 1;
+    if (Result.CompileErrors)
+      errs() << "misra-bench: " << Result.CompileErrors
+             << " compile errors in the corpus with --rules=" << Rule << "\n";
+    double Seconds = std::max(Result.WallSeconds, 1e-9);
+    outs() << format("%8s %10.3f %10.3f %10.1f %12.0f %9u %12.0f %16.1f\n",
+                     Rule.c_str(), Result.WallSeconds, Result.CPUSeconds,
+                     NumFiles / Seconds, NumLines / Seconds, Result.Matches,
+                     Result.Matches / Seconds, Result.PeakMemoryKiB / 1024.0);
+    Results.push_back(std::move(Result));
+  }
+
+  raw_fd_ostream JSONFile(OutputFile, EC, sys::fs::OF_Text);
+  if (EC) {
+    errs() << "misra-bench: cannot write '" << OutputFile
+           << "': " << EC.message() << "\n";
+    return 1;
+  }
+  json::OStream J(JSONFile, /*IndentSize=*/2);
+  J.object([&] {
+    J.attributeObject("corpus", [&] {
+      J.attribute("files", NumFiles.getValue());
+      J.attribute("lines", int64_t(NumLines));
+      J.attribute("density", Density.getValue());
+      J.attribute("nesting", NestingDepth.getValue());
+      J.attribute("table_size", TableSize.getValue());
+    });
+    J.attribute("jobs", Jobs.getValue());
+    J.attribute("repeat", Repeat.getValue());
+    J.attributeArray("results", [&] {
+      for (const RunResult &Result : Results) {
+        double Seconds = std::max(Result.WallSeconds, 1e-9);
+        J.object([&] {
+          J.attribute("rule", Result.Rule);
+          J.attribute("wall_seconds", Result.WallSeconds);
+          J.attribute("cpu_seconds", Result.CPUSeconds);
+          J.attribute("files_per_second", NumFiles / Seconds);
+          J.attribute("lines_per_second", NumLines / Seconds);
+          J.attribute("matches", Result.Matches);
+          J.attribute("matches_per_second", Result.Matches / Seconds);
+          J.attribute("peak_rss_kib", int64_t(Result.PeakMemoryKiB));
+          J.attribute("compile_errors", Result.CompileErrors);
+        });
+      }
+    });
+  });
+  JSONFile << "\n";
+
+  if (TemporaryDir)
+    sys::fs::remove_directories(Dir);
+  return 0;
+}
+
+                                  //DOCUMENTATION
+/*
+misra-bench measures the throughput and the peak memory of every rule on a
+generated corpus, and writes the results to a JSON file (--output,
+misra-bench.json by default) so that releases can be compared.
+
+The corpus has --files files (20 by default) of --lines lines each (2000 by
+default). Each file starts with a table of --table-size hexadecimal literals
+(1000 by default), which every token rule has to look at, and a function of
+--nesting nested if statements (64 by default), which makes the traversals of
+the AST rules deep. The rest of the file is functions of compliant statements,
+among which a one-line violation of each measured rule is placed --density
+times per 100 lines (1 by default). The violations of the rules are spread
+over different lines. The corpus only depends on the options, so two runs with
+the same options check the same code.
+
+misra-check (the one next to misra-bench, or --misra-check) is then run on the
+corpus once for each rule, with --rules selecting only that rule, and once
+with all of them. Each rule runs in its own process, since that is the only
+way to know the peak memory of the rule: sys::ExecuteAndWait gives the peak
+resident set size and the CPU time of the child, and the wall time is measured
+around it. The diagnostics are written with --format=jsonl and counted; those
+of clang itself are compile errors of the corpus and are reported separately.
+With --repeat=N each rule is run N times and the fastest run is kept.
+
+The table printed to stdout and the JSON file have, for each run, the wall and
+CPU time, the files, lines and matches (reported violations) per second of wall
+time, and the peak resident set size.
+
+Example:
+  misra-bench --files=100 --lines=5000 --density=2 --repeat=3 \
+    --output=misra-bench-release.json
+*/
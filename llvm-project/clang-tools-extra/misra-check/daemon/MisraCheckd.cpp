@@ -0,0 +1,203 @@
+// Include necessary header files
+#include "Daemon.h"
+#include "Driver.h"
+#include "MisraRule.h"
+#include "Options.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Use these namespaces to simplify code
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+using namespace std;
+
+// Create an option category for the daemon
+static cl::OptionCategory MisraCheckdCategory("misra-checkd options");
+
+static cl::opt<string> SocketOption(
+    "socket",
+    cl::desc("Unix socket to listen on, by default the one that "
+             "misra-check --connect uses"),
+    cl::init(""), cl::cat(MisraCheckdCategory));
+
+static cl::opt<bool> StopOption(
+    "stop", cl::desc("Stop the daemon listening on the socket and exit"),
+    cl::init(false), cl::cat(MisraCheckdCategory));
+
+// The compilation databases loaded for the requests, by directory. Loading
+// and indexing a large compile_commands.json is done once, and again only
+// when the file changes.
+class CompilationsCache {
+public:
+  unique_ptr<CompilationDatabase> get(misra::CommandLineOptions &Options,
+                                      raw_ostream &Err) {
+    // The flags after "--" do not come from a file
+    if (Options.FixedCompilations)
+      return misra::loadCompilations(Options, Err);
+
+    // Look for the database where CommonOptionsParser would: in the -p
+    // directory, or in the parents of the first source file
+    SmallString<256> Start(Options.BuildPath.empty() ? Options.Files.front()
+                                                     : Options.BuildPath);
+    sys::fs::make_absolute(Start);
+    if (Options.BuildPath.empty())
+      sys::path::remove_filename(Start);
+    for (StringRef Dir = Start; !Dir.empty();
+         Dir = sys::path::parent_path(Dir)) {
+      Optional<sys::fs::file_status> Status = findDatabase(Dir);
+      if (!Status) {
+        if (!Options.BuildPath.empty())
+          break;
+        continue;
+      }
+
+      Entry &E = Entries[Dir];
+      if (!E.Compilations || E.Modified != Status->getLastModificationTime() ||
+          E.Size != Status->getSize()) {
+        string ErrorMessage;
+        E.Compilations =
+            CompilationDatabase::loadFromDirectory(Dir, ErrorMessage);
+        E.Modified = Status->getLastModificationTime();
+        E.Size = Status->getSize();
+        if (!E.Compilations)
+          break;
+      }
+      return misra::addExtraArgs(E.Compilations, Options);
+    }
+
+    // Let loadCompilations report the error and run without flags
+    return misra::loadCompilations(Options, Err);
+  }
+
+private:
+  struct Entry {
+    shared_ptr<CompilationDatabase> Compilations;
+    sys::TimePoint<> Modified;
+    uint64_t Size = 0;
+  };
+
+  // The status of the compilation database in Dir, if there is one
+  static Optional<sys::fs::file_status> findDatabase(StringRef Dir) {
+    for (StringRef Name : {"compile_commands.json", "compile_flags.txt"}) {
+      SmallString<256> Path(Dir);
+      sys::path::append(Path, Name);
+      sys::fs::file_status Status;
+      if (!sys::fs::status(Path, Status) && sys::fs::is_regular_file(Status))
+        return Status;
+    }
+    return None;
+  }
+
+  StringMap<Entry> Entries;
+};
+
+static CompilationsCache Compilations;
+
+// Run one command line of misra-check
+static int handleRequest(ArrayRef<string> Args, raw_ostream &OS) {
+  // These options print and exit, which would stop the daemon. misra-check
+  // handles them itself and never sends them.
+  for (const string &Arg : Args) {
+    if (Arg == "--")
+      break;
+    StringRef Name = StringRef(Arg).ltrim('-');
+    if (Name.startswith("help") || Name == "version" ||
+        Name.startswith("print-")) {
+      OS << "misra-checkd: " << Arg << " is not supported by the daemon\n";
+      return 1;
+    }
+  }
+
+  vector<const char *> Argv;
+  for (const string &Arg : Args)
+    Argv.push_back(Arg.c_str());
+  misra::CommandLineOptions Options;
+  if (!misra::parseCommandLine(int(Argv.size()), Argv.data(),
+                               misra::getASTRules(), misra::getTokenRules(),
+                               Options, OS))
+    return 1;
+  // The standard output of the daemon is not the one of the client
+  if (Options.Driver.Format != misra::OutputFormat::Text &&
+      (Options.Driver.OutputFile.empty() || Options.Driver.OutputFile == "-")) {
+    OS << "misra-checkd: --format=jsonl and --format=sarif need --output\n";
+    return 1;
+  }
+
+  unique_ptr<CompilationDatabase> Database = Compilations.get(Options, OS);
+  return misra::checkFiles(*Database, Options.Files, Options.Rules,
+                           Options.Driver, OS);
+}
+
+int main(int argc, const char **argv) {
+  cl::HideUnrelatedOptions(MisraCheckdCategory);
+  cl::ParseCommandLineOptions(argc, argv,
+                              "misra-checkd - runs misra-check requests in a "
+                              "persistent process\n");
+  // The options are parsed again for every request, so keep their values
+  string Socket =
+      SocketOption.empty() ? misra::getDefaultSocketPath() : SocketOption;
+
+  if (StopOption) {
+    if (Error E = misra::stopServer(Socket)) {
+      errs() << "misra-checkd: " << toString(std::move(E)) << "\n";
+      return 1;
+    }
+    return 0;
+  }
+
+  if (Error E = misra::runServer(Socket, handleRequest)) {
+    errs() << "misra-checkd: " << toString(std::move(E)) << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+                                  //DOCUMENTATION
+/*
+misra-checkd is a daemon that runs the command lines of misra-check, so that
+repeated runs, e.g. from an editor or a pre-commit hook, do not pay again for
+what does not change between them.
+
+It listens on a Unix socket, by default $XDG_RUNTIME_DIR/misra-checkd.sock or
+misra-checkd-<uid>.sock in the temporary directory. misra-check --connect
+parses its command line as usual, then sends it to the daemon with its current
+directory (see Daemon.h). The daemon changes to that directory, parses the
+command line again with parseCommandLine() from rules/Options.cpp and runs
+checkFiles(), sending the diagnostics back file by file as they are printed,
+followed by the exit status. Requests are handled one at a time.
+
+What stays warm between requests:
+  - the process itself, with the rule tables and the LLVM option registry;
+  - the compilation databases, by directory, loaded again only when the size
+    or the modification time of compile_commands.json or compile_flags.txt
+    changes;
+  - the precompiled headers of --pch-dir and the entries of --cache-dir, which
+    are on disk and are validated by every run;
+  - the operating system's page cache for the sources and headers.
+The FileManager, and with it the stat cache of the headers, is not kept: it
+would not see the changes made to the files between two requests. The
+PCHManager and the ResultCache are also created again for every request, since
+they remember the hashes and states of the files they have seen.
+
+The JSON Lines and SARIF output of --format can only be written to a file
+given with --output, since the daemon does not send its standard output.
+
+--help, --version and the --print- options are not accepted in a request,
+since they exit the process. misra-check handles them itself.
+
+Example:
+  misra-checkd &
+  misra-check --connect -p build src/a.cpp
+  misra-check --connect -p build --pch-header=sdk/include/sdk.h src/b.cpp
+  misra-checkd --stop
+*/
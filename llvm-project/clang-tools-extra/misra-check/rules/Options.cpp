@@ -0,0 +1,403 @@
+// Command line of misra-check, also parsed by misra-checkd for each request
+#include "Options.h"
+#include "StructuredOutput.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/CommonOptionsParser.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/CommandLine.h"
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace misra {
+
+static cl::OptionCategory MisraCheckCategory("misra-check options");
+
+// The options of CommonOptionsParser
+static cl::opt<std::string> BuildPathOption("p", cl::desc("Build path"),
+                                            cl::Optional,
+                                            cl::cat(MisraCheckCategory));
+
+// Checked in parseCommandLine rather than with cl::OneOrMore, so that
+// misra-checkd can parse its own options without any source file
+static cl::list<std::string> SourcePathsOption(
+    cl::Positional, cl::desc("<source0> [... <sourceN>]"), cl::ZeroOrMore,
+    cl::cat(MisraCheckCategory));
+
+static cl::list<std::string> ArgsAfterOption(
+    "extra-arg",
+    cl::desc("Additional argument to append to the compiler command line"),
+    cl::cat(MisraCheckCategory));
+
+static cl::list<std::string> ArgsBeforeOption(
+    "extra-arg-before",
+    cl::desc("Additional argument to prepend to the compiler command line"),
+    cl::cat(MisraCheckCategory));
+
+static cl::opt<std::string> RulesOption(
+    "rules",
+    cl::desc("Comma-separated list of rules to check, e.g. "
+             "--rules=2.10.3,5.0.5. All rules are checked by default."),
+    cl::init(""), cl::cat(MisraCheckCategory));
+
+static cl::opt<unsigned> JobsOption(
+    "j",
+    cl::desc("Number of translation units to check in parallel "
+             "(0 = one per core)"),
+    cl::init(1), cl::cat(MisraCheckCategory));
+
+static cl::opt<std::string> CacheDirOption(
+    "cache-dir",
+    cl::desc("Directory where the diagnostics of each translation unit are "
+             "cached. Unchanged files are not checked again."),
+    cl::init(""), cl::cat(MisraCheckCategory));
+
+static cl::opt<std::string> CachePolicyOption(
+    "cache-policy",
+    cl::desc("When to remove entries from the cache, e.g. "
+             "cache_size_bytes=1g:prune_after=168h:prune_interval=20m"),
+    cl::init("cache_size_bytes=1g"), cl::cat(MisraCheckCategory));
+
+static cl::opt<std::string> IncludeGraphOption(
+    "include-graph",
+    cl::desc("JSON file recording the headers included by each translation "
+             "unit. It is read and updated by every run."),
+    cl::init(""), cl::cat(MisraCheckCategory));
+
+static cl::opt<std::string> CostHistoryOption(
+    "cost-history",
+    cl::desc("JSON file recording the time each translation unit took. It is "
+             "read and updated by every run, and the slowest files are "
+             "started first."),
+    cl::init(""), cl::cat(MisraCheckCategory));
+
+static cl::opt<std::string> ChangedSinceOption(
+    "changed-since",
+    cl::desc("Only check the translation units affected by the changes since "
+             "this git revision. Needs --include-graph."),
+    cl::init(""), cl::cat(MisraCheckCategory));
+
+static cl::opt<std::string> LineFilterOption(
+    "line-filter",
+    cl::desc("Only check the given lines, in the same format as clang-tidy: "
+             "[{\"name\":\"file.cpp\",\"lines\":[[1,3],[5,7]]},...]"),
+    cl::init(""), cl::cat(MisraCheckCategory));
+
+static cl::opt<std::string> DiffOption(
+    "diff",
+    cl::desc("Only check the lines changed since this git revision"),
+    cl::init(""), cl::cat(MisraCheckCategory));
+
+static cl::opt<std::string> PCHHeaderOption(
+    "pch-header",
+    cl::desc("Header to precompile once for all the files whose first "
+             "directive includes it"),
+    cl::init(""), cl::cat(MisraCheckCategory));
+
+static cl::opt<std::string> PCHDirOption(
+    "pch-dir",
+    cl::desc("Directory where the precompiled headers are kept between runs"),
+    cl::init(""), cl::cat(MisraCheckCategory));
+
+static cl::opt<std::string> FormatOption(
+    "format",
+    cl::desc("Format of the diagnostics: text, jsonl (one JSON object per "
+             "diagnostic) or sarif (SARIF 2.1.0)"),
+    cl::init("text"), cl::cat(MisraCheckCategory));
+
+static cl::opt<std::string> OutputOption(
+    "output",
+    cl::desc("File receiving the jsonl or sarif output, stdout by default"),
+    cl::init(""), cl::cat(MisraCheckCategory));
+
+static cl::opt<std::string> ConnectOption(
+    "connect",
+    cl::desc("Send the command line to the misra-checkd daemon listening on "
+             "this socket, or on the default one"),
+    cl::ValueOptional, cl::init(""), cl::cat(MisraCheckCategory));
+
+static cl::opt<std::string> ProfileOption(
+    "profile",
+    cl::desc("Write a Chrome trace of the run to this file, "
+             "misra-check.trace.json by default, and print the time spent in "
+             "each phase and rule"),
+    cl::ValueOptional, cl::init(""), cl::cat(MisraCheckCategory));
+
+static cl::opt<bool> PrefilterOption(
+    "prefilter",
+    cl::desc("Scan the text of each file and of its headers first, and only "
+             "run the rules that can find a violation in it (default on)"),
+    cl::init(true), cl::cat(MisraCheckCategory));
+
+static cl::opt<bool> RawLexOption(
+    "raw-lex",
+    cl::desc("Only run the token rules, on the raw tokens of each file: no "
+             "preprocessing, headers or compile command. All the token rules "
+             "by default."),
+    cl::init(false), cl::cat(MisraCheckCategory));
+
+static cl::opt<bool> IsolateOption(
+    "isolate",
+    cl::desc("Check each translation unit in a worker process, -j of them at "
+             "a time, so that a file that crashes or runs out of memory only "
+             "fails itself"),
+    cl::init(false), cl::cat(MisraCheckCategory));
+
+static cl::opt<unsigned> WorkerMemoryLimitOption(
+    "worker-memory-limit",
+    cl::desc("With --isolate, the address space of each worker process in "
+             "megabytes. A file that needs more fails. No limit by default."),
+    cl::init(0), cl::cat(MisraCheckCategory));
+
+static cl::opt<unsigned> TUJobsOption(
+    "tu-jobs",
+    cl::desc("Split the AST checks of each translation unit over this many "
+             "worker processes (0 uses one per core). Needs -j 1 or "
+             "--isolate."),
+    cl::init(1), cl::cat(MisraCheckCategory));
+
+static cl::opt<unsigned> TUTimeoutOption(
+    "tu-timeout",
+    cl::desc("Stop the check of a translation unit after this many seconds "
+             "and report it as timed out. No limit by default."),
+    cl::init(0), cl::cat(MisraCheckCategory));
+
+static cl::opt<unsigned> DeadlineOption(
+    "deadline",
+    cl::desc("Stop the run this many seconds after it started: the files "
+             "being checked are stopped and those left fail, but for the "
+             "cached ones. The results so far are still written."),
+    cl::init(0), cl::cat(MisraCheckCategory));
+
+static cl::extrahelp CommonHelp(CommonOptionsParser::HelpMessage);
+
+static cl::extrahelp MoreHelp(
+    "\nAvailable rules: 2.10.3, 2.13.2, 2.13.3, 2.13.4, 3.9.3, 4.5.1, 4.5.2, "
+    "5.0.5, 5.0.13, 5.0.14, 5.0.21, 5.3.1, 5.3.2, 7.1\n");
+
+// Find the rules named in the --rules option, in both tables of rules.
+// Returns false and prints an error if one of the names is not a known rule.
+static bool selectRules(StringRef Spec, ArrayRef<ASTRuleInfo> ASTRules,
+                        ArrayRef<TokenRuleInfo> TokenRules,
+                        RuleSelection &Selection, raw_ostream &Err) {
+  if (Spec.trim().empty()) {
+    for (const ASTRuleInfo &Info : ASTRules)
+      Selection.ASTRules.push_back(&Info);
+    for (const TokenRuleInfo &Info : TokenRules)
+      Selection.TokenRules.push_back(&Info);
+    return true;
+  }
+
+  SmallVector<StringRef, 16> Names;
+  Spec.split(Names, ',', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+  for (StringRef Name : Names) {
+    Name = Name.trim();
+    // Also accept the directory name of the rule, e.g. Rule-2.10.3
+    Name.consume_front("Rule-");
+    bool Found = false;
+    for (const ASTRuleInfo &Info : ASTRules)
+      if (Name == Info.Name) {
+        Found = true;
+        // Ignore rules that are given more than once
+        if (!is_contained(Selection.ASTRules, &Info))
+          Selection.ASTRules.push_back(&Info);
+      }
+    for (const TokenRuleInfo &Info : TokenRules)
+      if (Name == Info.Name) {
+        Found = true;
+        if (!is_contained(Selection.TokenRules, &Info))
+          Selection.TokenRules.push_back(&Info);
+      }
+    if (!Found) {
+      Err << "misra-check: unknown rule '" << Name << "'\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool parseCommandLine(int Argc, const char **Argv,
+                      ArrayRef<ASTRuleInfo> ASTRules,
+                      ArrayRef<TokenRuleInfo> TokenRules,
+                      CommandLineOptions &Options, raw_ostream &Err) {
+  // The options keep the values of the previous command line, e.g. of the
+  // previous request in misra-checkd
+  cl::ResetAllOptionOccurrences();
+  cl::HideUnrelatedOptions(MisraCheckCategory);
+
+  // The flags after "--" are removed from the command line
+  std::string ErrorMessage;
+  Options.FixedCompilations =
+      FixedCompilationDatabase::loadFromCommandLine(Argc, Argv, ErrorMessage);
+  if (!ErrorMessage.empty()) {
+    Err << "misra-check: " << ErrorMessage << "\n";
+    return false;
+  }
+  if (!cl::ParseCommandLineOptions(Argc, Argv, "", &Err))
+    return false;
+
+  Options.Files.assign(SourcePathsOption.begin(), SourcePathsOption.end());
+  if (Options.Files.empty()) {
+    Err << "misra-check: no source files given\n";
+    return false;
+  }
+  Options.BuildPath = BuildPathOption;
+  Options.ArgsBefore.assign(ArgsBeforeOption.begin(), ArgsBeforeOption.end());
+  Options.ArgsAfter.assign(ArgsAfterOption.begin(), ArgsAfterOption.end());
+  if (ConnectOption.getNumOccurrences())
+    Options.Connect = ConnectOption.getValue();
+
+  if (!selectRules(RulesOption, ASTRules, TokenRules, Options.Rules, Err))
+    return false;
+  if (RawLexOption && RulesOption.trim().empty()) {
+    Options.Rules.ASTRules.clear();
+  } else if (RawLexOption && !Options.Rules.ASTRules.empty()) {
+    Err << "misra-check: rule " << Options.Rules.ASTRules.front()->Name
+        << " needs the AST, --raw-lex only runs token rules\n";
+    return false;
+  }
+
+  DriverOptions &Driver = Options.Driver;
+  Driver.Jobs = JobsOption;
+  Driver.CacheDir = CacheDirOption;
+  Expected<CachePruningPolicy> Policy =
+      parseCachePruningPolicy(CachePolicyOption);
+  if (!Policy) {
+    Err << "misra-check: invalid --cache-policy: "
+        << toString(Policy.takeError()) << "\n";
+    return false;
+  }
+  Driver.CachePolicy = *Policy;
+
+  if (!ChangedSinceOption.empty() && IncludeGraphOption.empty()) {
+    Err << "misra-check: --changed-since needs --include-graph\n";
+    return false;
+  }
+  Driver.IncludeGraphPath = IncludeGraphOption;
+  Driver.ChangedSince = ChangedSinceOption;
+  Driver.CostHistoryPath = CostHistoryOption;
+
+  if (!LineFilterOption.empty() && !DiffOption.empty()) {
+    Err << "misra-check: --line-filter and --diff cannot be used together\n";
+    return false;
+  }
+  Driver.LineFilterJSON = LineFilterOption;
+  Driver.DiffSince = DiffOption;
+  Driver.PCHHeader = PCHHeaderOption;
+  Driver.PCHDir = PCHDirOption;
+
+  Optional<OutputFormat> Format = parseOutputFormat(FormatOption);
+  if (!Format) {
+    Err << "misra-check: unknown --format '" << FormatOption << "'\n";
+    return false;
+  }
+  Driver.Format = *Format;
+  Driver.OutputFile = OutputOption;
+  if (ProfileOption.getNumOccurrences())
+    Driver.ProfileFile = ProfileOption.empty() ? "misra-check.trace.json"
+                                               : ProfileOption.getValue();
+  Driver.Prefilter = PrefilterOption;
+  Driver.RawLex = RawLexOption;
+
+  // The time of the rules would be recorded in the worker processes
+  if (IsolateOption && !Driver.ProfileFile.empty()) {
+    Err << "misra-check: --isolate and --profile cannot be used together\n";
+    return false;
+  }
+  if (WorkerMemoryLimitOption && !IsolateOption) {
+    Err << "misra-check: --worker-memory-limit needs --isolate\n";
+    return false;
+  }
+  // The workers are forked, which the threads of -j do not allow, and the
+  // time of the rules would be recorded in them
+  if (TUJobsOption != 1 && JobsOption != 1 && !IsolateOption) {
+    Err << "misra-check: --tu-jobs needs -j 1 or --isolate\n";
+    return false;
+  }
+  if (TUJobsOption != 1 && !Driver.ProfileFile.empty()) {
+    Err << "misra-check: --tu-jobs and --profile cannot be used together\n";
+    return false;
+  }
+  Driver.TUJobs = TUJobsOption;
+  Driver.Isolate = IsolateOption;
+  Driver.WorkerMemoryLimitMB = WorkerMemoryLimitOption;
+  Driver.TUTimeout = TUTimeoutOption;
+  Driver.Deadline = DeadlineOption;
+  return true;
+}
+
+std::unique_ptr<CompilationDatabase>
+loadCompilations(CommandLineOptions &Options, raw_ostream &Err) {
+  std::shared_ptr<CompilationDatabase> Compilations =
+      std::move(Options.FixedCompilations);
+  if (!Compilations) {
+    std::string ErrorMessage;
+    if (!Options.BuildPath.empty())
+      Compilations = CompilationDatabase::autoDetectFromDirectory(
+          Options.BuildPath, ErrorMessage);
+    else
+      Compilations = CompilationDatabase::autoDetectFromSource(
+          Options.Files.front(), ErrorMessage);
+    if (!Compilations) {
+      Err << "Error while trying to load a compilation database:\n"
+          << ErrorMessage << "Running without flags.\n";
+      Compilations = std::make_shared<FixedCompilationDatabase>(
+          ".", std::vector<std::string>());
+    }
+  }
+  return addExtraArgs(std::move(Compilations), Options);
+}
+
+namespace {
+
+// A compilation database that adjusts the commands of another one
+class AdjustingCompilations : public CompilationDatabase {
+public:
+  AdjustingCompilations(std::shared_ptr<CompilationDatabase> Base,
+                        ArgumentsAdjuster Adjuster)
+      : Base(std::move(Base)), Adjuster(std::move(Adjuster)) {}
+
+  std::vector<CompileCommand>
+  getCompileCommands(StringRef FilePath) const override {
+    return adjust(Base->getCompileCommands(FilePath));
+  }
+
+  std::vector<std::string> getAllFiles() const override {
+    return Base->getAllFiles();
+  }
+
+  std::vector<CompileCommand> getAllCompileCommands() const override {
+    return adjust(Base->getAllCompileCommands());
+  }
+
+private:
+  std::vector<CompileCommand>
+  adjust(std::vector<CompileCommand> Commands) const {
+    for (CompileCommand &Command : Commands)
+      Command.CommandLine = Adjuster(Command.CommandLine, Command.Filename);
+    return Commands;
+  }
+
+  std::shared_ptr<CompilationDatabase> Base;
+  ArgumentsAdjuster Adjuster;
+};
+
+} // namespace
+
+std::unique_ptr<CompilationDatabase>
+addExtraArgs(std::shared_ptr<CompilationDatabase> Base,
+             const CommandLineOptions &Options) {
+  ArgumentsAdjuster Adjuster = combineAdjusters(
+      getInsertArgumentAdjuster(Options.ArgsBefore,
+                                ArgumentInsertPosition::BEGIN),
+      getInsertArgumentAdjuster(Options.ArgsAfter,
+                                ArgumentInsertPosition::END));
+  return std::make_unique<AdjustingCompilations>(std::move(Base),
+                                                 std::move(Adjuster));
+}
+
+} // namespace misra
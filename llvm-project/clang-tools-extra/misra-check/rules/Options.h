@@ -0,0 +1,60 @@
+// Command line of misra-check, also parsed by misra-checkd for each request
+#ifndef MISRA_CHECK_OPTIONS_H
+#define MISRA_CHECK_OPTIONS_H
+
+#include "Driver.h"
+#include "MisraRule.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace misra {
+
+// Everything given on a misra-check command line
+struct CommandLineOptions {
+  // The source files to check
+  std::vector<std::string> Files;
+  RuleSelection Rules;
+  DriverOptions Driver;
+  // Directory of the compilation database, given with -p
+  std::string BuildPath;
+  // Compile flags given after "--", used for every file instead of a
+  // compilation database
+  std::unique_ptr<clang::tooling::CompilationDatabase> FixedCompilations;
+  // Arguments added to every compile command by --extra-arg-before and
+  // --extra-arg
+  std::vector<std::string> ArgsBefore;
+  std::vector<std::string> ArgsAfter;
+  // Socket of the misra-checkd daemon to send the command line to, given
+  // with --connect. It is empty for the default socket.
+  llvm::Optional<std::string> Connect;
+};
+
+// Parse a misra-check command line. The options are the same as those of
+// CommonOptionsParser, but the compilation database is not loaded yet, so a
+// client of misra-checkd never pays for it. The rules named by --rules are
+// looked up in the given tables. Returns false after printing the error to
+// Err if the command line is not valid.
+bool parseCommandLine(int Argc, const char **Argv,
+                      llvm::ArrayRef<ASTRuleInfo> ASTRules,
+                      llvm::ArrayRef<TokenRuleInfo> TokenRules,
+                      CommandLineOptions &Options, llvm::raw_ostream &Err);
+
+// Find the compilation database of Options like CommonOptionsParser does:
+// from the flags after "--", from -p, or in the parents of the first file
+std::unique_ptr<clang::tooling::CompilationDatabase>
+loadCompilations(CommandLineOptions &Options, llvm::raw_ostream &Err);
+
+// Add the arguments of --extra-arg-before and --extra-arg to the compile
+// commands of Base
+std::unique_ptr<clang::tooling::CompilationDatabase>
+addExtraArgs(std::shared_ptr<clang::tooling::CompilationDatabase> Base,
+             const CommandLineOptions &Options);
+
+} // namespace misra
+
+#endif // MISRA_CHECK_OPTIONS_H
@@ -0,0 +1,43 @@
+// Table of the rules that can be selected in misra-check
+#include "MisraRule.h"
+
+using namespace llvm;
+
+namespace misra {
+
+// Keep the entries in the same order as the rule directories. The features a
+// rule requires must be found in the text of every translation unit in which
+// it can report a violation, or the prefilter would hide the violation.
+static const ASTRuleInfo ASTRules[] = {
+    // Compares the names of the variables and typedefs declared by the
+    // statements of the function bodies, across the translation unit
+    {"2.10.3", createRule2_10_3, SF_Typedef, RL_CXX,
+     /*WholeTranslationUnit=*/true},
+    // Any comparison gives a bool operand, so nothing rules it out
+    {"4.5.1", createRule4_5_1},
+    {"4.5.2", createRule4_5_2, SF_Enum},
+    // Conversions between floating and integral types
+    {"5.0.5", createRule5_0_5, SF_Floating},
+    {"5.0.13", createRule5_0_13, SF_Condition},
+    {"5.0.14", createRule5_0_14, SF_Conditional},
+    {"5.0.21", createRule5_0_21, SF_Bitwise},
+    {"5.3.1", createRule5_3_1, SF_Logical},
+    {"5.3.2", createRule5_3_2, SF_Minus},
+};
+
+// The octal rules report every number of two characters or more that starts
+// with 0, whatever its base
+static const TokenRuleInfo TokenRules[] = {
+    {"2.13.2", createRule2_13_2, SF_ZeroPrefixedNumber},
+    {"2.13.3", createRule2_13_3, SF_ZeroPrefixedNumber | SF_Unsigned},
+    {"2.13.4", createRule2_13_4, SF_LowerCaseEnd},
+    {"3.9.3", createRule3_9_3, SF_HexNumber},
+    // The MISRA C rule, kept on C++ files as before
+    {"7.1", createRule7_1, SF_ZeroPrefixedNumber, RL_C | RL_CXX},
+};
+
+ArrayRef<ASTRuleInfo> getASTRules() { return ASTRules; }
+
+ArrayRef<TokenRuleInfo> getTokenRules() { return TokenRules; }
+
+} // namespace misra
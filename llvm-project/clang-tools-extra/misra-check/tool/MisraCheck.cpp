@@ -0,0 +1,272 @@
+// Include necessary header files
+#include "Daemon.h"
+#include "Driver.h"
+#include "MisraRule.h"
+#include "Options.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Use these namespaces to simplify code
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+using namespace std;
+
+int main(int argc, const char **argv) {
+  // Parse the command line. The options are the same as with
+  // CommonOptionsParser, plus those of misra-check (see rules/Options.h).
+  misra::CommandLineOptions Options;
+  if (!misra::parseCommandLine(argc, argv, misra::getASTRules(),
+                               misra::getTokenRules(), Options, errs()))
+    return 1;
+
+  // With --connect, misra-checkd runs the command line in its warm process
+  if (Options.Connect) {
+    string Socket = Options.Connect->empty() ? misra::getDefaultSocketPath()
+                                             : *Options.Connect;
+    Expected<int> Status =
+        misra::runClient(Socket, vector<string>(argv, argv + argc), errs());
+    if (!Status) {
+      errs() << "misra-check: " << toString(Status.takeError()) << "\n";
+      return 1;
+    }
+    return *Status;
+  }
+
+  unique_ptr<CompilationDatabase> Compilations =
+      misra::loadCompilations(Options, errs());
+  return misra::checkFiles(*Compilations, Options.Files, Options.Rules,
+                           Options.Driver, errs());
+}
+
+                                  //DOCUMENTATION
+/*
+misra-check is a single driver for all the rules of this project. The AST based
+rules are Rule-2.10.3, Rule-4.5.1, Rule-4.5.2, Rule-5.0.5, Rule-5.0.13,
+Rule-5.0.14, Rule-5.0.21, Rule-5.3.1 and Rule-5.3.2. The token based rules,
+which look at the literals in the preprocessed source, are Rule-2.13.2,
+Rule-2.13.3, Rule-2.13.4, Rule-3.9.3 and Rule-7.1.
+
+Every rule source file still builds its own executable, but when it is compiled
+into misra-check (with MISRA_CHECK_DRIVER defined) its main function is left
+out. Instead, each rule exposes a factory function declared in MisraRule.h. An
+AST rule creates an ASTRule object, which owns the match callbacks of the rule
+and adds its matchers to a MatchFinder with registerMatchers(). The rules on
+the built-in operators, Rule-4.5.1, Rule-4.5.2, Rule-5.0.21, Rule-5.3.1 and the
+operator part of Rule-5.0.13, add OperatorChecks to an OperatorVisitor with
+registerOperatorChecks() instead (see OperatorVisitor.h). A rule that walks the
+AST itself, like the condition check of Rule-5.0.13, returns an ASTConsumer
+from newASTConsumer(). A token rule creates a TokenRule object, whose
+handleToken() method is called for every token of the translation unit. The
+literal rules add token patterns to a TokenPatternSet with registerPatterns()
+instead (see TokenPattern.h): regular expressions over the tokens, such as an
+unsigned keyword followed by an octal literal without a U suffix, built in the
+style of the AST matchers. The patterns of all the rules run in one automaton,
+built lazily as the tokens come, so a token costs the tests of the properties
+the patterns use, each done once, and one table lookup, whatever the number of
+patterns. checkFiles() keeps the automaton of each selection of token rules (see
+TokenAutomatonCache), so the states built for a file serve the next ones.
+
+The main function parses the command line with parseCommandLine() in
+rules/Options.cpp, which takes the same options as CommonOptionsParser. It
+looks up the rules selected with --rules= (all of them by default), and main
+hands them to checkFiles() in Driver.cpp. For each translation unit checkFiles()
+creates new instances of the selected rules and registers the AST rules on one
+MatchFinder. A ClangTool then runs a MisraCheckAction on the file: it parses the
+file once, runs all the matchers in a single traversal of the AST, visits every
+operator once for all the operator checks, calling those of its opcode from a
+table with the operand types worked out once, and attaches a token watcher to
+the preprocessor of that same parse which gives every token to all the token
+rules. When only token rules are selected, a TokenRuleAction is used instead,
+which preprocesses the file without building an AST.
+
+The rules do not report their violations as they find them. Each rule keeps
+them in a ViolationRecorder (see ViolationRecorder.h), as 8 byte records of a
+message index and a SourceLocation, and reports them all at the end of the
+translation unit: the AST rules from onEndOfTranslationUnit(), from
+endTranslationUnit() for the operator checks or from their own consumer, the
+token rules from endTranslationUnit(). The diagnostic IDs are then registered
+once per rule and the line numbers looked up in one pass. The violations of a
+file are therefore grouped by rule: token rules first, then operator checks,
+then the rules with their own consumer, then the matchers.
+
+With -j N the translation units are checked by N threads (-j 0 uses one thread
+per core). Since every translation unit has its own rules, MatchFinder, file
+system and diagnostic printer, nothing is shared between the threads. The
+diagnostics of a file are collected in a buffer and printed once all the files
+before it are done, so the output is the same as with -j 1.
+
+In parallel the files are started longest first, so that a large generated
+file does not start last and run alone while the other threads are idle (see
+CostHistory.h). With --cost-history=FILE the time each file took is kept in
+FILE for the next run, and the run prints how long the checks took and how
+long the history predicted; a file not in the history, or every file without
+one, is estimated from the size of its main file. The files replayed from
+the cache count for no time in the prediction.
+
+With --isolate the files are checked by -j worker processes instead (see
+WorkerPool.h), forked before any thread is started, which run one file at a
+time and send back its output, status and dependencies through a pipe. A
+worker that crashes, e.g. on a stack overflow in a deep template
+instantiation, is replaced and its file is reported with an error without a
+location, so one bad file does not stop a nightly run. With
+--worker-memory-limit=MB the address space of each worker is limited with
+setrlimit(RLIMIT_AS), which Linux enforces where it does not enforce
+RLIMIT_RSS: a file that needs more makes its worker abort. The workers share
+the cache and the precompiled headers through their directories, but each
+one builds a missing precompiled header itself. --profile cannot be used
+with --isolate.
+
+With --tu-jobs=N the AST checks of each file are split over N worker
+processes once it is parsed (see ParallelChecks.h), for the large
+amalgamated files that -j cannot spread over the cores. Each worker forks a
+copy-on-write copy of the AST and checks a run of top level declarations of
+about the same size, and the rules that compare declarations across the
+translation unit, marked WholeTranslationUnit in RuleRegistry.cpp, run on the
+whole of it in one more worker. The diagnostics of the workers are then
+reported in the order of their locations rather than rule by rule. Threads
+could not share the ASTContext, whose caches are filled as the rules run.
+--tu-jobs needs -j 1 or --isolate, since the workers are forked.
+
+With --tu-timeout=SECONDS the check of a file is stopped once it has taken
+that long, and with --deadline=SECONDS every file is stopped that long after
+the start of the run (see Deadline.h). Clang cannot be interrupted anywhere,
+so the time is checked at each top level declaration, template instantiation,
+included file and macro expansion, and a file that runs out of it ends with a
+fatal error and no violation. Once the deadline has passed, the files left
+are reported as not checked, but for those the cache still has; the output,
+the cache and the include graph are written as usual. A timed out file is not
+cached. With --isolate a worker that is still on a file after twice the
+--tu-timeout, e.g. stuck in a rule, is killed.
+
+With --cache-dir the result of every translation unit is stored in a cache
+(see ResultCache.h). Its key hashes the rules, the compile command and the main
+file, and the entry lists the hash of every header that was read. When nothing
+has changed, the diagnostics are printed again from the cache without parsing
+the file. Old entries are removed after each run as given by --cache-policy,
+which uses the same syntax as the ThinLTO cache policy of the linkers.
+
+With --include-graph=FILE every run records, for each translation unit it
+checks, the absolute paths of all the files the compiler read for it (see
+IncludeGraph.h). Adding --changed-since=REV asks git for the files changed
+since REV, including uncommitted changes, and only checks the translation units
+that read one of them, plus those the graph does not know yet. A full run, e.g.
+a nightly one, keeps the graph up to date for the pre-merge checks.
+
+--line-filter and --diff go further and only check some lines (see
+LineFilter.h). The AST traversals of the matchers and of the operator checks are
+restricted with ASTContext::setTraversalScope to the top level declarations that
+overlap those lines, looking inside namespaces, so the matching work depends on
+the size of the change rather than of the file. The diagnostics of the rules,
+including the token rules, are dropped when they are outside the lines. The
+rules whose violations may depend on more than one top level declaration, like
+Rule-2.10.3, which compares the names of all the declarations, still traverse
+the whole translation unit; only their diagnostics are filtered. Before any of
+this, the text of the translation unit is scanned for its includes as by
+--prefilter (see Prefilter.h). A file is not even preprocessed when none of the
+files it may read has a selected line, so it does not report its compile
+errors either. When the scan gives up, the file is parsed.
+
+--pch-header=H is for projects where every file starts by including the same
+heavy header, e.g. the one of a vendor SDK or an RTOS (see PrecompiledHeader.h).
+For each set of compile flags, H is precompiled once into --pch-dir and every
+file whose first directive is #include of H is parsed with -include-pch. The
+precompiled header is built again when one of the files it was built from
+changes. H needs an include guard, since the file still includes it. The token
+rules do not see the tokens of a precompiled header, so they do not report
+violations inside H.
+
+--format=jsonl and --format=sarif replace the text diagnostics with JSON, for
+tools that read the results (see StructuredOutput.h). Each diagnostic is one
+line of JSON with its file, line, column, level, rule and message; with sarif
+these lines are the results of one SARIF 2.1.0 log. Like the text, they are
+written to a buffer of the translation unit by the thread that checks it, with
+no lock, and then appended to --output (stdout by default) in the order of the
+files, so the output is the same whatever the number of jobs. Messages of
+misra-check itself still go to stderr.
+
+Before a translation unit is checked, the prefilter (see Prefilter.h) scans
+the raw text of the file and of every header it includes for the few
+features that the rules need: a file without the enum keyword cannot violate
+Rule-4.5.2, one without a floating type or literal cannot violate Rule-5.0.5,
+and one without a number starting with 0 cannot violate Rule-2.13.2 or
+Rule-7.1. The features each rule requires are in the rule table
+(rules/RuleRegistry.cpp). Only the rules whose features were all found are
+created and registered; when only token rules are left the file is
+preprocessed but not parsed, and when none is left it is not even
+preprocessed. The scan does not preprocess: comments, strings, skipped blocks
+and macro definitions count as code, and token pasting and trigraphs count as
+every feature, so it can only find more than the compiler sees. It gives up,
+and every rule runs, when a header is not found in the directory of its
+includer or the -iquote, -I and -isystem directories, e.g. a header of the
+standard library, or when an #include names a macro. A file that is not parsed
+does not report the compile errors the parser would find. --prefilter=false
+turns the prefilter off.
+
+The frontend work also follows from the rules. A C file, by its -x option or
+else its extension unless the compiler is clang++ or g++, is only checked
+against the rules for C, Rule-7.1, since the MISRA C++ rules do not apply to
+it; the options that only apply to C++, such as a -std=c++14 given after --
+for every file, are dropped from its command line. If none of its rules is
+selected, it is not read at all.
+
+--raw-lex is a mode for literal-only gates. It only runs the token rules, all
+of them unless --rules says otherwise, and neither preprocesses the file nor
+reads its compile command, except to tell C from C++: each file is read
+through the FileManager, which maps it into memory, and lexed by the raw
+lexer (see RawTokenLexer.h). So the rules only see the main file, and they
+see the tokens of the directives, of the macro definitions and of the blocks
+skipped by #if, but not the expansions of the macros. The prefilter then only
+scans the numbers of the main file, and a cached result only depends on it.
+Most bytes cannot start a number, so the scan looks for the digits that do
+not follow an identifier character with SSE2 or AVX2, and only looks at the
+text of the numbers it finds. A file without a number is not lexed, and the
+rules whose kind of number it lacks, e.g. hexadecimal for Rule-3.9.3, are
+not run.
+
+--profile[=FILE] shows where the time of a run goes. After the diagnostics, a
+table gives the seconds spent in each phase (preprocessing, parsing and sema,
+the AST traversals, the precompiled header) and in each rule, split into its
+token, operator, traversal and matcher parts, added up over the translation
+units that were parsed, longest first. The matcher times come from the
+profiling of the MatchFinder, keyed by the getID() of the callbacks; the
+other rules are timed by wrappers around them (see Profile.h). A Chrome trace
+of the run, with one track per thread, is written to FILE
+(misra-check.trace.json by default); it can be opened in chrome://tracing or
+Perfetto and includes the events of clang itself, like -ftime-trace. Files
+replayed from the cache are not profiled. The time of the token patterns is
+not told apart by rule and counts as preprocessing.
+
+With --connect, the command line is not run by misra-check itself but sent,
+with the current directory, to the misra-checkd daemon (see
+daemon/MisraCheckd.cpp), which prints the same output and returns the same
+exit status while keeping its process, compilation database, precompiled
+headers and cache warm between runs. --connect alone uses the default socket
+of the daemon.
+
+Example:
+  misra-check --rules=4.5.1,2.13.2 test/rule-4.5.1.cpp test/rule-2.13.2.cpp --
+  misra-check --raw-lex --rules=2.13.3 test/rule-2.13.3.cpp --
+  misra-check -j 8 -p build $(find src -name '*.cpp')
+  misra-check -j 8 -p build --cache-dir=.misra-cache $(find src -name '*.cpp')
+  misra-check -p build --include-graph=build/misra-graph.json \
+    --changed-since=origin/main $(find src -name '*.cpp')
+  misra-check -p build --include-graph=build/misra-graph.json \
+    --changed-since=origin/main --diff=origin/main $(find src -name '*.cpp')
+  misra-check -j 8 -p build --pch-header=sdk/include/sdk.h \
+    --pch-dir=build/misra-pch $(find src -name '*.cpp')
+  misra-check -j 8 -p build --format=sarif --output=misra.sarif \
+    $(find src -name '*.cpp')
+  misra-check -j 8 -p build --profile=misra.trace.json $(find src -name '*.cpp')
+  misra-check -j 64 -p build --cost-history=build/misra-costs.json \
+    $(find src -name '*.cpp')
+  misra-check -j 8 -p build --isolate --worker-memory-limit=4096 \
+    $(find src -name '*.cpp')
+  misra-check -j 8 -p build --tu-timeout=120 --deadline=3600 \
+    $(find src -name '*.cpp')
+  misra-check -p build --tu-jobs=0 src/amalgamation.cpp
+  misra-check --connect -p build src/a.cpp
+*/
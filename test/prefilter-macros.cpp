@@ -0,0 +1,12 @@
+// Input for the prefilter of misra-check. The text has no keyword of an
+// integer type without a sign, so the scan must find the one Rule-2.13.3
+// requires in the predefined macros. Both runs report the same violations:
+//   misra-check --rules=2.13.3 test/prefilter-macros.cpp --
+//   misra-check --rules=2.13.3 --prefilter=false test/prefilter-macros.cpp --
+int main() {
+  __SIZE_TYPE__ s = 017; // non compliant
+  __UINT32_TYPE__ u = 017; // non compliant
+  __UINT32_TYPE__ v = 017U; // compliant
+
+  return 0;
+}
@@ -0,0 +1,11 @@
+// Input for the prefilter of misra-check. The text has none of the operators
+// Rule-5.0.21 requires but in a trigraph, which the scan must not miss. Both
+// runs report the same violations:
+//   misra-check --rules=5.0.21 test/prefilter-trigraphs.cpp -- -trigraphs
+//   misra-check --rules=5.0.21 --prefilter=false test/prefilter-trigraphs.cpp -- -trigraphs
+int main() {
+  int a = 20;
+  int e = a ??! 1; // non compliant
+
+  return 0;
+}
@@ -14,6 +14,12 @@ int main(){
    if(k){    //non compliant
    pass=1;
    }
+   do{
+    sum+=k;
+   }while(k);   //non compliant
+   do{
+    sum+=k;
+   }while(k!=0);   //compliant
    if(k>=0)   //compliant
 
     if(k=9){  //non compliant